@@ -0,0 +1,195 @@
+#include "TreeGenerator.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief SplitMix64: tiny, fast, and the same sequence on every platform.
+ */
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// A number in [0, bound).
+    size_t below(size_t bound) { return static_cast<size_t>(next() % bound); }
+
+    /// True with probability `p`.
+    bool chance(double p) { return static_cast<double>(next() >> 11) * 0x1.0p-53 < p; }
+
+private:
+    uint64_t state;
+};
+
+struct WeightedExtension {
+    const char* extension;
+    unsigned weight;
+};
+
+// Roughly what a downloads folder holds
+constexpr std::array<WeightedExtension, 16> kExtensions = {{
+    {".jpg", 22}, {".png", 10}, {".pdf", 14}, {".docx", 6}, {".txt", 8}, {".zip", 5},
+    {".mp4", 7}, {".mov", 2}, {".mp3", 6}, {".wav", 1}, {".cpp", 4}, {".py", 3},
+    {".html", 3}, {".gz", 2}, {".xlsx", 4}, {".JPG", 3},
+}};
+
+constexpr std::array<const char*, 12> kWords = {{
+    "report", "invoice", "notes", "holiday", "draft", "budget",
+    "scan", "family", "project", "backup", "meeting", "receipt",
+}};
+
+constexpr std::array<const char*, 3> kKeywords = {{"wallpaper", "screenshot", "snap"}};
+
+const char* pickExtension(Random& random) {
+    static const unsigned total = [] {
+        unsigned sum = 0;
+        for (const auto& e : kExtensions) {
+            sum += e.weight;
+        }
+        return sum;
+    }();
+    size_t roll = random.below(total);
+    for (const auto& e : kExtensions) {
+        if (roll < e.weight) {
+            return e.extension;
+        }
+        roll -= e.weight;
+    }
+    return kExtensions[0].extension;
+}
+
+std::string randomExtension(Random& random) {
+    std::string extension = ".";
+    for (int i = 0; i < 3; ++i) {
+        extension += static_cast<char>('a' + random.below(26));
+    }
+    extension += 'q';  // No built-in extension ends in "q", so it stays unknown
+    return extension;
+}
+
+std::string twoDigits(int value) {
+    return (value < 10 ? "0" : "") + std::to_string(value);
+}
+
+std::string date(Random& random) {
+    const std::string year = std::to_string(2000 + random.below(25));
+    const std::string month = twoDigits(1 + static_cast<int>(random.below(12)));
+    const std::string day = twoDigits(1 + static_cast<int>(random.below(28)));
+    switch (random.below(3)) {
+    case 0:
+        return year + "-" + month + "-" + day;
+    case 1:
+        return day + "-" + month + "-" + year;
+    default:
+        return year + month + day;
+    }
+}
+
+/**
+ * @brief A stem that is unique in the tree thanks to `serial`.
+ */
+std::string stem(Random& random, const TreeSpec& spec, size_t serial) {
+    std::string name;
+    if (random.chance(spec.keywordRatio)) {
+        name = std::string(kKeywords[random.below(kKeywords.size())]) + "_";
+    }
+    if (random.chance(0.4)) {
+        name += "IMG_";
+    } else {
+        name += std::string(kWords[random.below(kWords.size())]) + "_" + kWords[random.below(kWords.size())] + "_";
+    }
+    if (random.chance(spec.datedRatio)) {
+        name += date(random) + "_";
+    }
+    return name + std::to_string(serial);
+}
+
+} // namespace
+
+TreeGenerator::TreeGenerator(const TreeSpec& spec) : spec(spec) {
+    Random random(spec.seed);
+
+    // Directories, breadth first
+    dirs.emplace_back();
+    size_t levelStart = 0;
+    for (unsigned level = 0; level < spec.depth; ++level) {
+        const size_t levelEnd = dirs.size();
+        for (size_t parent = levelStart; parent < levelEnd; ++parent) {
+            for (unsigned child = 0; child < spec.fanout; ++child) {
+                dirs.push_back(dirs[parent] / ("dir" + std::to_string(level) + "_" + std::to_string(child)));
+            }
+        }
+        levelStart = levelEnd;
+    }
+
+    // Files, each in a random directory
+    std::unordered_set<std::string> taken;  ///< Conflicts may not repeat a path
+    paths.reserve(spec.files);
+    for (size_t i = 0; i < spec.files; ++i) {
+        const size_t directory = random.below(dirs.size());
+        if (i > 0 && random.chance(spec.conflictRatio)) {
+            fs::path repeated = dirs[directory] / paths[random.below(i)].filename();
+            if (taken.insert(repeated.string()).second) {
+                paths.push_back(std::move(repeated));
+                continue;
+            }
+        }
+        const std::string extension = random.chance(spec.unknownRatio) ? randomExtension(random)
+                                                                        : pickExtension(random);
+        paths.push_back(dirs[directory] / (stem(random, spec, i) + extension));
+        taken.insert(paths.back().string());
+    }
+}
+
+std::vector<FileInfo> TreeGenerator::describe(const fs::path& root) const {
+    std::vector<FileInfo> files;
+    files.reserve(paths.size());
+    for (const auto& path : paths) {
+        FileInfo info;
+        info.path = root / path;
+        info.name = path.stem().string();
+        info.ext = path.extension().string();
+        files.push_back(std::move(info));
+    }
+    return files;
+}
+
+void TreeGenerator::write(const fs::path& root) const {
+    if (fs::exists(root) && !fs::is_empty(root)) {
+        throw fs::filesystem_error("cannot write a tree over existing files", root,
+                                   std::make_error_code(std::errc::directory_not_empty));
+    }
+    for (const auto& directory : dirs) {
+        fs::create_directories(root / directory);
+    }
+
+    std::string content;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const fs::path file = root / paths[i];
+        // Unique content: the serial number, padded to the requested size
+        content = std::to_string(i) + "\n";
+        content.resize(std::max(content.size(), spec.fileSize), '.');
+        std::FILE* out = std::fopen(file.c_str(), "wb");
+        if (out == nullptr) {
+            throw fs::filesystem_error("cannot create file", file, std::error_code(errno, std::generic_category()));
+        }
+        const bool written = std::fwrite(content.data(), 1, content.size(), out) == content.size();
+        if (std::fclose(out) != 0 || !written) {
+            throw fs::filesystem_error("cannot write file", file, std::error_code(errno, std::generic_category()));
+        }
+    }
+}
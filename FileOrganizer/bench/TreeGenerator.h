@@ -0,0 +1,78 @@
+#pragma once
+
+#include "core/FileScanner.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @struct TreeSpec
+ * @brief Describes a synthetic tree of files for the benchmarks.
+ *
+ * The ratios are probabilities per file and are independent of each other; a name
+ * can be both dated and carry a keyword.
+ */
+struct TreeSpec {
+    size_t files = 100000;        ///< The number of files.
+    unsigned depth = 2;           ///< Levels of subdirectories below the root (0 = a flat tree).
+    unsigned fanout = 8;          ///< Subdirectories in each directory above the last level.
+    double datedRatio = 0.3;      ///< Names with a date (YYYY-MM-DD, DD-MM-YYYY or YYYYMMDD).
+    double keywordRatio = 0.1;    ///< Names with a built-in keyword ("wallpaper", "screenshot", "snap").
+    double unknownRatio = 0.05;   ///< Files with a random extension that no rule knows.
+    double conflictRatio = 0.1;   ///< Files named like an earlier file of another directory.
+    size_t fileSize = 16;         ///< Bytes written to each file.
+    uint64_t seed = 1;            ///< The same seed and settings always give the same tree.
+};
+
+/**
+ * @class TreeGenerator
+ * @brief Builds deterministic file trees, on disk or only as a file list.
+ *
+ * Names mix camera-style ("IMG_4711"), word-based ("quarterly_report_17") and dated
+ * stems, with extensions drawn from a fixed distribution weighted like a typical
+ * downloads folder. A conflict reuses the name and extension of an earlier file in
+ * another directory, so the two compete for the same place once organized. Every
+ * other name is unique in the tree. Each file's content is unique as well, so none
+ * of them are duplicates of each other.
+ *
+ * The generator uses its own pseudo-random sequence (SplitMix64), not the standard
+ * distributions, whose output differs between standard libraries.
+ */
+class TreeGenerator {
+public:
+    explicit TreeGenerator(const TreeSpec& spec);
+
+    /**
+     * @brief The files of the tree, relative to its root, in generation order.
+     */
+    const std::vector<std::filesystem::path>& files() const { return paths; }
+
+    /**
+     * @brief The directories of the tree, relative to its root, parents first.
+     *
+     * The root itself is the first entry (an empty path).
+     */
+    const std::vector<std::filesystem::path>& directories() const { return dirs; }
+
+    /**
+     * @brief Describes the files as a scan of the tree under `root` would.
+     *
+     * Nothing is read from disk, so this works before (or without) write().
+     */
+    std::vector<FileInfo> describe(const std::filesystem::path& root) const;
+
+    /**
+     * @brief Writes the tree under `root`, which must be missing or empty.
+     *
+     * @throws std::filesystem::filesystem_error If `root` holds anything, or the tree
+     *         cannot be written.
+     */
+    void write(const std::filesystem::path& root) const;
+
+private:
+    TreeSpec spec;
+    std::vector<std::filesystem::path> dirs;
+    std::vector<std::filesystem::path> paths;
+};
@@ -0,0 +1,656 @@
+#include "TreeGenerator.h"
+#include "core/FileOperator.h"
+#include "core/FileOrganizer.h"
+#include "core/NamespaceIndex.h"
+#include "core/PatternMatcher.h"
+#include "core/Plan.h"
+#include "core/RenamePattern.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @struct BenchOptions
+ * @brief The settings of one run of the suite.
+ */
+struct BenchOptions {
+    TreeSpec spec;
+    fs::path workspace;           ///< Where the trees are written; owned by the suite.
+    unsigned repeat = 3;          ///< Timed repetitions of each benchmark.
+    unsigned jobs = 1;            ///< Executor threads for the execute and e2e benchmarks.
+    size_t planActions = 10000000; ///< Actions built by the plan.memory benchmarks.
+    std::string filter;           ///< Run only the benchmarks whose name contains this.
+    bool json = true;             ///< JSON report (default) or a table.
+    bool keep = false;            ///< Leave the workspace behind.
+    std::string generate;         ///< Only write a tree to this directory.
+};
+
+/**
+ * @brief One timed repetition: how long it took and how many items it processed.
+ */
+struct Sample {
+    double seconds = 0;
+    size_t items = 0;
+    size_t bytes = 0;             ///< Memory held by what was built, for the benchmarks that measure it.
+    bool ok = true;
+};
+
+/**
+ * @brief The state shared by the benchmarks of a run.
+ */
+struct Context {
+    const BenchOptions& options;
+    TreeGenerator tree;
+    fs::path root;                  ///< The tree's location in the workspace.
+    std::vector<FileInfo> files;    ///< The tree's files, described without scanning.
+    bool written = false;
+
+    explicit Context(const BenchOptions& options)
+        : options(options), tree(options.spec), root(options.workspace / "tree"), files(tree.describe(root)) {}
+
+    /**
+     * @brief Writes a fresh copy of the tree, for benchmarks that change it.
+     */
+    void rewrite() {
+        fs::remove_all(root);
+        tree.write(root);
+        written = true;
+    }
+
+    /**
+     * @brief Makes sure the tree is on disk, for benchmarks that only read it.
+     */
+    void ensureWritten() {
+        if (!written) {
+            rewrite();
+        }
+    }
+};
+
+struct Benchmark {
+    const char* name;
+    std::function<Sample(Context&)> run;
+};
+
+struct Result {
+    std::string name;
+    std::vector<double> seconds;    ///< Sorted.
+    size_t items = 0;
+    size_t bytes = 0;
+    bool ok = true;
+
+    double median() const { return seconds[seconds.size() / 2]; }
+};
+
+/**
+ * @brief Discards what the organizer prints while it is being timed.
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+class SilencedOutput {
+public:
+    SilencedOutput() : saved(std::cout.rdbuf(&sink)) {}
+    ~SilencedOutput() { std::cout.rdbuf(saved); }
+
+private:
+    NullBuffer sink;
+    std::streambuf* saved;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Keeps the results of the pure functions alive, so the loops are not optimized away
+volatile size_t blackHole = 0;
+
+/**
+ * @brief The std::regex date detection that DateScanner replaced, as it was, so the
+ *        two can be timed on the same names.
+ */
+std::string detectDatePatternRegex(const std::string& filename) {
+    std::regex datePattern1(R"((\d{4})[-_](\d{1,2})[-_](\d{1,2}))");
+    std::regex datePattern2(R"((\d{1,2})[-_](\d{1,2})[-_](\d{4}))");
+    std::regex datePattern3(R"((\d{4})(\d{2})(\d{2}))");
+
+    auto formatDate = [](const std::string& year, const std::string& month) {
+        std::ostringstream oss;
+        oss << year << "/" << std::setw(2) << std::setfill('0') << month;
+        return oss.str();
+    };
+
+    std::smatch match;
+    if (std::regex_search(filename, match, datePattern1)) {
+        return formatDate(match[1].str(), match[2].str());
+    }
+    if (std::regex_search(filename, match, datePattern2)) {
+        return formatDate(match[3].str(), match[2].str());
+    }
+    if (std::regex_search(filename, match, datePattern3)) {
+        return formatDate(match[1].str(), match[2].str());
+    }
+    return "";
+}
+
+/**
+ * @brief The bytes in use on the heap, as the C library counts them (allocator
+ *        overhead included); 0 where it does not tell.
+ */
+size_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;  // Small blocks, and large ones mapped on their own
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief The i-th action of the plan.memory benchmarks: a MOVE of a file of the tree
+ *        into its type folder, numbered by the pass over the tree so that every
+ *        action has its own paths.
+ */
+Action memoryAction(const Context& context, size_t i) {
+    const FileInfo& file = context.files[i % context.files.size()];
+    const std::string name = file.name + "-" + std::to_string(i / context.files.size()) + file.ext;
+    return Action(Action::MOVE, file.path.parent_path() / name,
+                  context.root / "organized" / PatternMatcher::getFileType(file.ext) / name);
+}
+
+/**
+ * @brief Plans a MOVE of every file into its type folder, as organizeFiles does.
+ */
+Plan planByType(const Context& context) {
+    Plan plan;
+    NamespaceIndex names;
+    std::set<fs::path> plannedDirs;
+    for (const auto& file : context.files) {
+        const fs::path directory = context.root / PatternMatcher::getFileType(file.ext);
+        if (plannedDirs.insert(directory).second) {
+            plan.addAction(Action(Action::CREATE_DIR, "", directory));
+        }
+        plan.addAction(Action(Action::MOVE, file.path, names.claim(directory / file.path.filename())));
+    }
+    return plan;
+}
+
+Sample executeBenchmark(Context& context, ExecutionEngine engine) {
+    context.rewrite();
+    const Plan plan = planByType(context);
+    Sample sample;
+    const auto start = Clock::now();
+    {
+        SilencedOutput silenced;
+        sample.ok = FileOperator::executePlan(plan, context.options.jobs, nullptr, engine);
+    }
+    sample.seconds = secondsSince(start);
+    sample.items = plan.size();
+    context.written = false;  // The files have moved
+    return sample;
+}
+
+Sample organizeBenchmark(Context& context, bool stream) {
+    context.rewrite();
+    CommandLineArgs args;
+    args.organize = true;
+    args.recursive = true;
+    args.stream = stream;
+    args.jobs = context.options.jobs;
+
+    Sample sample;
+    const auto start = Clock::now();
+    {
+        SilencedOutput silenced;
+        FileOrganizer organizer(args, context.root);
+        sample.ok = stream ? organizer.organizeStreaming() : organizer.organizeFiles();
+    }
+    sample.seconds = secondsSince(start);
+    sample.items = context.files.size();
+    context.written = false;
+    return sample;
+}
+
+/**
+ * @brief The suite. Names are "phase.function" so that --filter can pick a phase.
+ *
+ * resolveConflict and generateNewName are private to FileOrganizer and only forward
+ * to NamespaceIndex::claim and RenamePattern::render, so those are what is timed.
+ */
+std::vector<Benchmark> benchmarks() {
+    return {
+        {"pattern.detectDatePattern", [](Context& context) {
+            Sample sample;
+            const auto start = Clock::now();
+            size_t found = 0;
+            for (const auto& file : context.files) {
+                found += PatternMatcher::detectDatePattern(file.name).size();
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += found;
+            sample.items = context.files.size();
+            return sample;
+        }},
+        {"pattern.detectDatePattern.regex", [](Context& context) {
+            // Hundreds of times slower than the scanner: the first names are enough
+            const size_t count = std::min<size_t>(context.files.size(), 10000);
+            Sample sample;
+            const auto start = Clock::now();
+            size_t found = 0;
+            for (size_t i = 0; i < count; ++i) {
+                found += detectDatePatternRegex(context.files[i].name).size();
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += found;
+            sample.items = count;
+            return sample;
+        }},
+        {"pattern.detectKeyword", [](Context& context) {
+            Sample sample;
+            const auto start = Clock::now();
+            size_t found = 0;
+            for (const auto& file : context.files) {
+                found += PatternMatcher::detectKeyword(file.name).size();
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += found;
+            sample.items = context.files.size();
+            return sample;
+        }},
+        {"pattern.getFileType", [](Context& context) {
+            Sample sample;
+            const auto start = Clock::now();
+            size_t found = 0;
+            for (const auto& file : context.files) {
+                found += PatternMatcher::getFileType(file.ext).size();
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += found;
+            sample.items = context.files.size();
+            return sample;
+        }},
+        {"plan.resolveConflict", [](Context& context) {
+            // The type folders do not exist, so every clash comes from the plan itself
+            const fs::path target = context.root / "organized";
+            Sample sample;
+            const auto start = Clock::now();
+            NamespaceIndex names;
+            size_t renamed = 0;
+            for (const auto& file : context.files) {
+                const fs::path desired = target / PatternMatcher::getFileType(file.ext) / file.path.filename();
+                renamed += names.claim(desired) != desired;
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += renamed;
+            sample.items = context.files.size();
+            return sample;
+        }},
+        {"plan.generateNewName", [](Context& context) {
+            const RenamePattern pattern = RenamePattern::compile("{date}_{name}_{counter:05}{ext}");
+            Sample sample;
+            const auto start = Clock::now();
+            std::string name;
+            size_t length = 0;
+            int counter = 1;
+            for (const auto& file : context.files) {
+                pattern.render(file, counter++, name);
+                length += name.size();
+            }
+            sample.seconds = secondsSince(start);
+            blackHole += length;
+            sample.items = context.files.size();
+            return sample;
+        }},
+        {"plan.memory", [](Context& context) {
+            // The same actions as plan.memory.actions, in a Plan; the time is that of addAction
+            const size_t count = context.options.planActions;
+            Sample sample;
+            const size_t heapBefore = heapInUse();
+            const auto start = Clock::now();
+            Plan plan;
+            for (size_t i = 0; i < count; ++i) {
+                plan.addAction(memoryAction(context, i));
+            }
+            sample.seconds = secondsSince(start);
+            sample.items = plan.size();
+            const size_t heapAfter = heapInUse();
+            sample.bytes = heapAfter > heapBefore ? heapAfter - heapBefore : plan.memoryUsage();
+            return sample;
+        }},
+        {"plan.memory.actions", [](Context& context) {
+            // The layout Plan replaced, a std::vector<Action>. Millions of them take gigabytes,
+            // so each action is built, measured and dropped, and the bytes are those the
+            // vector would hold: its array plus the heap blocks of every action's paths.
+            const size_t count = context.options.planActions;
+            Sample sample;
+            sample.bytes = count * sizeof(Action);
+            const auto start = Clock::now();
+            for (size_t i = 0; i < count; ++i) {
+                const size_t heapBefore = heapInUse();
+                const Action action = memoryAction(context, i);
+                const size_t heapAfter = heapInUse();
+                sample.bytes += heapAfter > heapBefore
+                    ? heapAfter - heapBefore
+                    : action.source.native().capacity() + action.destination.native().capacity() + 2;
+            }
+            sample.seconds = secondsSince(start);
+            sample.items = count;
+            return sample;
+        }},
+        {"scan.scanDirectory", [](Context& context) {
+            context.ensureWritten();
+            Sample sample;
+            const auto start = Clock::now();
+            for (const auto& directory : context.tree.directories()) {
+                sample.items += FileScanner::scanDirectory(context.root / directory).size();
+            }
+            sample.seconds = secondsSince(start);
+            sample.ok = sample.items == context.files.size();
+            return sample;
+        }},
+        {"scan.scanRecursive", [](Context& context) {
+            context.ensureWritten();
+            Sample sample;
+            const auto start = Clock::now();
+            sample.items = FileScanner::scanRecursive(context.root).size();
+            sample.seconds = secondsSince(start);
+            sample.ok = sample.items == context.files.size();
+            return sample;
+        }},
+        {"execute.executePlan", [](Context& context) {
+            return executeBenchmark(context, ExecutionEngine::THREADS);
+        }},
+        {"execute.executePlan.io_uring", [](Context& context) {
+            return executeBenchmark(context, ExecutionEngine::IO_URING);
+        }},
+        {"e2e.organize", [](Context& context) {
+            return organizeBenchmark(context, false);
+        }},
+        {"e2e.organize.stream", [](Context& context) {
+            return organizeBenchmark(context, true);
+        }},
+    };
+}
+
+std::string jsonString(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            static const char* kHex = "0123456789abcdef";
+            quoted += "\\u00";
+            quoted += kHex[(c >> 4) & 0xF];
+            quoted += kHex[c & 0xF];
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+void printJson(const BenchOptions& options, const std::vector<Result>& results) {
+    const TreeSpec& spec = options.spec;
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "{\n"
+        << "  \"suite\": \"fileorganizer_bench\",\n"
+        << "  \"tree\": {\"files\": " << spec.files << ", \"depth\": " << spec.depth
+        << ", \"fanout\": " << spec.fanout << ", \"dated_ratio\": " << spec.datedRatio
+        << ", \"keyword_ratio\": " << spec.keywordRatio << ", \"unknown_ratio\": " << spec.unknownRatio
+        << ", \"conflict_ratio\": " << spec.conflictRatio << ", \"file_size\": " << spec.fileSize
+        << ", \"seed\": " << spec.seed << "},\n"
+        << "  \"workspace\": " << jsonString(options.workspace.string()) << ",\n"
+        << "  \"repeat\": " << options.repeat << ",\n"
+        << "  \"jobs\": " << options.jobs << ",\n"
+        << "  \"plan_actions\": " << options.planActions << ",\n"
+        << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        const double median = r.median();
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": " << jsonString(r.name) << ", \"ok\": " << (r.ok ? "true" : "false")
+            << ", \"items\": " << r.items << ", \"min_s\": " << r.seconds.front()
+            << ", \"median_s\": " << median << ", \"max_s\": " << r.seconds.back()
+            << ", \"items_per_s\": " << (median > 0 ? r.items / median : 0)
+            << ", \"ns_per_item\": " << (r.items > 0 ? median * 1e9 / r.items : 0);
+        if (r.bytes > 0) {
+            out << ", \"bytes\": " << r.bytes
+                << ", \"bytes_per_item\": " << (r.items > 0 ? static_cast<double>(r.bytes) / r.items : 0);
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    std::cout << out.str();
+}
+
+void printTable(const std::vector<Result>& results) {
+    std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(10) << "items"
+              << std::setw(12) << "median s" << std::setw(14) << "items/s" << std::setw(12) << "ns/item" << "\n";
+    for (const Result& r : results) {
+        const double median = r.median();
+        std::cout << std::left << std::setw(32) << r.name << std::right << std::setw(10) << r.items
+                  << std::fixed << std::setprecision(4) << std::setw(12) << median
+                  << std::setprecision(0) << std::setw(14) << (median > 0 ? r.items / median : 0)
+                  << std::setprecision(1) << std::setw(12) << (r.items > 0 ? median * 1e9 / r.items : 0);
+        if (r.bytes > 0 && r.items > 0) {
+            std::cout << "  " << static_cast<double>(r.bytes) / r.items << " B/item";
+        }
+        std::cout << std::defaultfloat << (r.ok ? "" : "  FAILED") << "\n";
+    }
+}
+
+void printUsage(const char* programName) {
+    std::cout << "fileorganizer_bench - Benchmarks for FileOrganizer on a synthetic tree\n\n"
+              << "Usage: " << programName << " [options]\n\n"
+              << "Tree:\n"
+              << "  --files N             Files in the tree (default 100000)\n"
+              << "  --depth N             Levels of subdirectories (default 2)\n"
+              << "  --fanout N            Subdirectories per directory (default 8)\n"
+              << "  --dated R             Share of names with a date (default 0.3)\n"
+              << "  --keywords R          Share of names with a keyword (default 0.1)\n"
+              << "  --unknown R           Share of files with an unknown extension (default 0.05)\n"
+              << "  --conflicts R         Share of files named like another one (default 0.1)\n"
+              << "  --file-size N         Bytes per file (default 16)\n"
+              << "  --seed N              Seed of the generator (default 1)\n\n"
+              << "Run:\n"
+              << "  --dir PATH            Workspace for the trees; its \"tree\" subdirectory is replaced\n"
+              << "                        (default /dev/shm/fileorganizer_bench, a tmpfs)\n"
+              << "  --repeat N            Timed repetitions of each benchmark (default 3)\n"
+              << "  --jobs, -j N          Executor threads (default 1)\n"
+              << "  --plan-actions N      Actions built by the plan.memory benchmarks (default 10000000)\n"
+              << "  --filter TEXT         Only run benchmarks whose name contains TEXT\n"
+              << "  --format json|text    Report format (default json)\n"
+              << "  --keep                Leave the workspace in place afterwards\n"
+              << "  --generate DIR        Only write the tree into DIR (missing or empty) and exit\n"
+              << "  --list                List the benchmarks and exit\n"
+              << "  --help, -h            Show this help message\n";
+}
+
+[[noreturn]] void fail(const char* programName, const std::string& message) {
+    std::cerr << "Error: " << message << "\n";
+    printUsage(programName);
+    std::exit(1);
+}
+
+BenchOptions parseOptions(int argc, char* argv[]) {
+    BenchOptions options;
+    options.workspace = fs::is_directory("/dev/shm") ? fs::path("/dev/shm") : fs::temp_directory_path();
+    options.workspace /= "fileorganizer_bench";
+
+    auto value = [&](int& i) -> std::string {
+        if (i + 1 >= argc) {
+            fail(argv[0], std::string(argv[i]) + " requires a value.");
+        }
+        return argv[++i];
+    };
+    auto number = [&](int& i) -> unsigned long long {
+        const std::string option = argv[i];
+        const std::string text = value(i);
+        try {
+            size_t used = 0;
+            const unsigned long long n = std::stoull(text, &used);
+            if (used == text.size() && text[0] != '-') {
+                return n;
+            }
+        } catch (const std::exception&) {
+        }
+        fail(argv[0], option + " expects a non-negative integer, not \"" + text + "\".");
+    };
+    auto ratio = [&](int& i) -> double {
+        const std::string option = argv[i];
+        const std::string text = value(i);
+        try {
+            size_t used = 0;
+            const double r = std::stod(text, &used);
+            if (used == text.size() && r >= 0 && r <= 1) {
+                return r;
+            }
+        } catch (const std::exception&) {
+        }
+        fail(argv[0], option + " expects a ratio between 0 and 1, not \"" + text + "\".");
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else if (arg == "--files") {
+            options.spec.files = number(i);
+        } else if (arg == "--depth") {
+            options.spec.depth = static_cast<unsigned>(number(i));
+        } else if (arg == "--fanout") {
+            options.spec.fanout = static_cast<unsigned>(number(i));
+        } else if (arg == "--dated") {
+            options.spec.datedRatio = ratio(i);
+        } else if (arg == "--keywords") {
+            options.spec.keywordRatio = ratio(i);
+        } else if (arg == "--unknown") {
+            options.spec.unknownRatio = ratio(i);
+        } else if (arg == "--conflicts") {
+            options.spec.conflictRatio = ratio(i);
+        } else if (arg == "--file-size") {
+            options.spec.fileSize = number(i);
+        } else if (arg == "--seed") {
+            options.spec.seed = number(i);
+        } else if (arg == "--dir") {
+            options.workspace = value(i);
+        } else if (arg == "--repeat") {
+            options.repeat = static_cast<unsigned>(number(i));
+        } else if (arg == "--jobs" || arg == "-j") {
+            options.jobs = static_cast<unsigned>(number(i));
+        } else if (arg == "--plan-actions") {
+            options.planActions = static_cast<size_t>(number(i));
+        } else if (arg == "--filter") {
+            options.filter = value(i);
+        } else if (arg == "--format") {
+            const std::string format = value(i);
+            if (format != "json" && format != "text") {
+                fail(argv[0], "--format must be \"json\" or \"text\".");
+            }
+            options.json = format == "json";
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else if (arg == "--generate") {
+            options.generate = value(i);
+        } else if (arg == "--list") {
+            for (const auto& benchmark : benchmarks()) {
+                std::cout << benchmark.name << "\n";
+            }
+            std::exit(0);
+        } else {
+            fail(argv[0], "unknown option \"" + arg + "\".");
+        }
+    }
+    if (options.repeat == 0) {
+        fail(argv[0], "--repeat must be at least 1.");
+    }
+    if (options.spec.depth > 0 && options.spec.fanout == 0) {
+        fail(argv[0], "--fanout must be at least 1 when --depth is not 0.");
+    }
+    return options;
+}
+
+} // namespace
+
+/**
+ * @brief Runs the benchmark suite and prints the report to standard output.
+ *
+ * Progress goes to standard error, so the report can be redirected as it is.
+ *
+ * @return 0 if every benchmark ran and succeeded, 1 otherwise.
+ */
+int main(int argc, char* argv[]) {
+    const BenchOptions options = parseOptions(argc, argv);
+
+    try {
+        if (!options.generate.empty()) {
+            TreeGenerator(options.spec).write(options.generate);
+            std::cerr << "Wrote " << options.spec.files << " files to " << options.generate << "\n";
+            return 0;
+        }
+
+        Context context(options);
+        std::vector<Result> results;
+        bool ok = true;
+        for (const auto& benchmark : benchmarks()) {
+            if (!options.filter.empty() && std::string(benchmark.name).find(options.filter) == std::string::npos) {
+                continue;
+            }
+            std::cerr << "Running " << benchmark.name << "...\n";
+            Result result;
+            result.name = benchmark.name;
+            for (unsigned i = 0; i < options.repeat; ++i) {
+                const Sample sample = benchmark.run(context);
+                result.seconds.push_back(sample.seconds);
+                result.items = sample.items;
+                result.bytes = sample.bytes;
+                result.ok = result.ok && sample.ok;
+            }
+            std::sort(result.seconds.begin(), result.seconds.end());
+            ok = ok && result.ok;
+            results.push_back(std::move(result));
+        }
+
+        if (!options.keep) {
+            std::error_code ec;
+            fs::remove_all(context.root, ec);
+            fs::remove(options.workspace, ec);  // Only if nothing else is in it
+        }
+        if (options.json) {
+            printJson(options, results);
+        } else {
+            printTable(results);
+        }
+        return ok ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
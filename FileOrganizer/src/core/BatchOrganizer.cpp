@@ -0,0 +1,225 @@
+#include "BatchOrganizer.h"
+#include "ExecutionBackend.h"
+#include "FileOperator.h"
+#include "utils/Log.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief A root under way: its plan and how far it has run.
+ */
+struct RootJob {
+    size_t index = 0;               ///< Into the list of roots.
+    RootSummary summary;
+    Plan plan;
+    size_t next = 0;                ///< The next action to run.
+    std::unique_ptr<ExecutionBackend> backend;
+    ExecutionCallbacks callbacks;
+    Clock::time_point started;
+};
+
+// Resolves symlinks where the path exists, so two spellings of one directory compare equal
+fs::path normalizedRoot(const fs::path& root) {
+    std::error_code ec;
+    fs::path normalized = fs::weakly_canonical(fs::absolute(root), ec);
+    if (ec) {
+        normalized = fs::absolute(root).lexically_normal();
+    }
+    if (normalized.filename().empty() && normalized.has_relative_path()) {
+        normalized = normalized.parent_path();  // Drop a trailing separator
+    }
+    return normalized;
+}
+
+bool isInside(const fs::path& path, const fs::path& directory) {
+    return std::mismatch(directory.begin(), directory.end(), path.begin(), path.end()).first == directory.end();
+}
+
+} // namespace
+
+BatchOrganizer::BatchOrganizer(const OrganizerOptions& options, unsigned threads, bool dryRun)
+    : organizer([&options] {
+          // Every step runs on one thread; the batch's own workers are the parallelism
+          OrganizerOptions single = options;
+          single.jobs = 1;
+          single.scanThreads = 1;
+          single.engine = ExecutionEngine::THREADS;
+          return single;
+      }()),
+      threads(WorkStealingPool::resolveThreadCount(threads)), dryRun(dryRun), recursive(options.recursive) {}
+
+std::vector<fs::path> BatchOrganizer::readRoots(std::istream& in) {
+    std::vector<fs::path> roots;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        roots.emplace_back(line);
+    }
+    return roots;
+}
+
+void BatchOrganizer::checkOverlap(const std::vector<fs::path>& roots) const {
+    std::vector<fs::path> sorted;
+    sorted.reserve(roots.size());
+    for (const fs::path& root : roots) {
+        sorted.push_back(normalizedRoot(root));
+    }
+    // Paths compare by component, so a directory's descendants sort right after it
+    std::sort(sorted.begin(), sorted.end());
+    const fs::path* outer = nullptr;
+    for (const fs::path& root : sorted) {
+        if (outer && *outer == root) {
+            throw std::invalid_argument("the root " + root.string() + " is listed twice");
+        }
+        if (recursive && outer && isInside(root, *outer)) {
+            throw std::invalid_argument("the root " + root.string() + " lies inside the root " +
+                                        outer->string() + ", which is organized recursively");
+        }
+        outer = &root;
+    }
+}
+
+std::vector<RootSummary> BatchOrganizer::run(const std::vector<fs::path>& roots) const {
+    checkOverlap(roots);
+    std::vector<RootSummary> summaries(roots.size());
+    const size_t window = static_cast<size_t>(threads) * kRootsPerThread;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::unique_ptr<RootJob>> ready;   // Roots waiting for their next step
+    size_t nextRoot = 0;
+    size_t active = 0;
+    size_t finished = 0;
+
+    auto finish = [this](RootJob& job) {
+        job.summary.seconds = std::chrono::duration<double>(Clock::now() - job.started).count();
+        Log::write(Log::INFO, "root", describe(job.summary, dryRun), job.summary.root.string());
+        return true;
+    };
+
+    // Runs the next step of a root; true once the root is done
+    auto step = [&](RootJob& job) {
+        RootSummary& summary = job.summary;
+        if (!summary.planned) {
+            job.started = Clock::now();
+            try {
+                job.plan = organizer.plan(summary.root, job.callbacks);
+            } catch (const std::exception& e) {
+                job.callbacks.error(nullptr, e.what());
+                return finish(job);
+            }
+            summary.planned = true;
+            summary.moves = job.plan.count(Action::MOVE);
+            summary.directories = job.plan.count(Action::CREATE_DIR);
+            summary.duplicates = job.plan.count(Action::HARDLINK) + job.plan.count(Action::DELETE_DUPLICATE);
+            if (dryRun || job.plan.empty()) {
+                return finish(job);
+            }
+            job.backend = ExecutionBackend::create();
+            return false;
+        }
+
+        const size_t end = std::min(job.next + kSliceActions, job.plan.size());
+        const size_t succeeded = FileOperator::executeSlice(job.plan, job.next, end, *job.backend, job.callbacks);
+        summary.failed += (end - job.next) - succeeded;
+        job.next = end;
+        return job.next == job.plan.size() ? finish(job) : false;
+    };
+
+    auto start = [&roots](size_t index) {
+        auto job = std::make_unique<RootJob>();
+        job->index = index;
+        job->summary.root = roots[index];
+        RootJob* raw = job.get();
+        // A root runs on one worker at a time, so its callbacks never race
+        job->callbacks.error = [raw](const Action* action, const std::string& message) {
+            raw->summary.errors++;
+            Log::write(Log::ERROR, "error", "Error: " + raw->summary.root.string() + ": " + message,
+                       action ? action->source.string() : raw->summary.root.string(),
+                       action ? action->destination.string() : std::string());
+        };
+        return job;
+    };
+
+    auto work = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            std::unique_ptr<RootJob> job;
+            if (nextRoot < roots.size() && active < window) {
+                job = start(nextRoot++);
+                ++active;
+            } else if (!ready.empty()) {
+                job = std::move(ready.front());
+                ready.pop_front();
+            } else if (active == 0) {
+                break;
+            } else {
+                changed.wait(lock);
+                continue;
+            }
+
+            lock.unlock();
+            const bool done = step(*job);
+            lock.lock();
+
+            if (done) {
+                summaries[job->index] = std::move(job->summary);
+                --active;
+                Log::progress(static_cast<int>(++finished), static_cast<int>(roots.size()));
+                changed.notify_all();
+            } else {
+                ready.push_back(std::move(job));
+                changed.notify_one();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return summaries;
+}
+
+std::string BatchOrganizer::describe(const RootSummary& summary, bool dryRun) {
+    std::ostringstream oss;
+    oss << summary.root.string() << ": ";
+    if (!summary.planned) {
+        oss << "not organized";
+        return oss.str();
+    }
+    oss << (dryRun ? "would make " : "") << summary.moves << " moves, " << summary.directories
+        << " directories";
+    if (summary.duplicates > 0) {
+        oss << ", " << summary.duplicates << " duplicates";
+    }
+    if (!dryRun) {
+        oss << ", " << summary.failed << " failed";
+    }
+    oss << std::fixed << std::setprecision(2) << " (" << summary.seconds << " s)";
+    return oss.str();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Organizer.h"
+#include <cstddef>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief What happened to one root of a batch.
+ */
+struct RootSummary {
+    std::filesystem::path root;
+    size_t moves = 0;             ///< MOVE actions planned.
+    size_t directories = 0;       ///< CREATE_DIR actions planned.
+    size_t duplicates = 0;        ///< HARDLINK and DELETE_DUPLICATE actions planned.
+    size_t failed = 0;            ///< Actions that failed.
+    size_t errors = 0;            ///< Errors reported, unreadable directories included.
+    bool planned = false;         ///< False if the root could not be planned at all.
+    double seconds = 0;           ///< From the start of its scan to its last action.
+};
+
+/**
+ * @class BatchOrganizer
+ * @brief Organizes many roots on one shared set of worker threads (--batch).
+ *
+ * Each root goes through the same steps as the CLI would take for it alone (scan,
+ * plan, execute) but as a sequence of steps on a shared run queue. A scan and its
+ * plan make one step; the plan then runs in slices of kSliceActions actions, and
+ * after each slice the root goes to the back of the queue. A large root therefore
+ * holds at most one worker at a time and only for one slice, so the small roots
+ * queued behind it keep moving.
+ *
+ * At most `threads` steps run at once, each on a single thread (scans included),
+ * so the threads are the global cap. Roots are started in list order, and only
+ * while fewer than kRootsPerThread per thread are under way, which bounds the
+ * plans held in memory.
+ */
+class BatchOrganizer {
+public:
+    /// Actions a root runs before it yields its worker.
+    static constexpr size_t kSliceActions = 1024;
+
+    /// Roots under way at once, per thread.
+    static constexpr size_t kRootsPerThread = 2;
+
+    /**
+     * @param options How to organize each root; `jobs` and `scanThreads` are ignored.
+     * @param threads The worker threads; 0 means one per hardware thread.
+     * @param dryRun If true, the roots are only planned.
+     * @throws std::runtime_error If a rules file cannot be loaded.
+     */
+    BatchOrganizer(const OrganizerOptions& options, unsigned threads, bool dryRun);
+
+    /**
+     * @brief Reads a list of roots: one path per line, skipping empty lines and
+     *        lines that start with '#'.
+     */
+    static std::vector<std::filesystem::path> readRoots(std::istream& in);
+
+    /**
+     * @brief Organizes the roots, logging a summary for each one as it finishes.
+     *
+     * @return One summary per root, in list order.
+     * @throws std::invalid_argument If two roots are the same directory, or, for
+     *         recursive runs, if one root lies inside another.
+     */
+    std::vector<RootSummary> run(const std::vector<std::filesystem::path>& roots) const;
+
+    /**
+     * @brief Formats the summary of a root, as logged.
+     */
+    static std::string describe(const RootSummary& summary, bool dryRun);
+
+private:
+    Organizer organizer;
+    unsigned threads;
+    bool dryRun;
+    bool recursive;
+
+    /**
+     * @brief Rejects lists whose roots would organize the same files.
+     */
+    void checkOverlap(const std::vector<std::filesystem::path>& roots) const;
+};
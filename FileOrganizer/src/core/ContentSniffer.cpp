@@ -0,0 +1,203 @@
+#include "ContentSniffer.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
+#include <fstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Files handed to one pool task; large enough to amortize the task, small enough to balance.
+constexpr size_t kBatchSize = 32;
+
+bool startsWith(std::string_view header, std::string_view magic, size_t offset = 0) {
+    return header.size() >= offset + magic.size() && header.compare(offset, magic.size(), magic) == 0;
+}
+
+unsigned byteAt(std::string_view header, size_t offset) {
+    return static_cast<unsigned char>(header[offset]);
+}
+
+bool startsWithIgnoreCase(std::string_view text, std::string_view prefix) {
+    if (text.size() < prefix.size()) return false;
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        char c = text[i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != prefix[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Tells apart the formats that are ZIP archives underneath.
+ */
+std::string_view detectZip(std::string_view header) {
+    // OpenDocument stores an uncompressed "mimetype" entry first
+    if (startsWith(header, "mimetype", 30)) {
+        const std::string_view mimeType = header.substr(std::min<size_t>(38, header.size()));
+        if (startsWith(mimeType, "application/vnd.oasis.opendocument.text")) return ".odt";
+        if (startsWith(mimeType, "application/vnd.oasis.opendocument.spreadsheet")) return ".ods";
+        if (startsWith(mimeType, "application/vnd.oasis.opendocument.presentation")) return ".odp";
+        if (startsWith(mimeType, "application/epub+zip")) return ".epub";
+    }
+    // Office Open XML names its parts after the application
+    if (header.find("[Content_Types].xml") != std::string_view::npos ||
+        header.find("_rels/.rels") != std::string_view::npos) {
+        if (header.find("word/") != std::string_view::npos) return ".docx";
+        if (header.find("xl/") != std::string_view::npos) return ".xlsx";
+        if (header.find("ppt/") != std::string_view::npos) return ".pptx";
+    }
+    return ".zip";
+}
+
+/**
+ * @brief Maps the major brand of an ISO base media file to its usual extension.
+ */
+std::string_view detectIsoMedia(std::string_view header) {
+    const std::string_view brand = header.substr(8, 4);
+    if (brand == "qt  ") return ".mov";
+    if (brand == "M4A " || brand == "M4B ") return ".m4a";
+    if (brand == "heic" || brand == "heix" || brand == "mif1" || brand == "msf1") return ".heic";
+    if (brand == "avif") return ".avif";
+    return ".mp4";
+}
+
+bool isMp3Frame(std::string_view header) {
+    if (header.size() < 2 || byteAt(header, 0) != 0xFF) return false;
+    const unsigned flags = byteAt(header, 1);
+    const unsigned sync = flags >> 5;
+    const unsigned version = (flags >> 3) & 3;
+    const unsigned layer = (flags >> 1) & 3;
+    return sync == 7 && version != 1 && layer == 1;
+}
+
+bool isAdtsFrame(std::string_view header) {
+    return header.size() >= 2 && byteAt(header, 0) == 0xFF && (byteAt(header, 1) & 0xF6) == 0xF0;
+}
+
+bool isHtml(std::string_view header) {
+    if (startsWith(header, "\xEF\xBB\xBF")) header.remove_prefix(3);
+    const size_t start = header.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return false;
+    header.remove_prefix(start);
+    return startsWithIgnoreCase(header, "<!doctype html") || startsWithIgnoreCase(header, "<html");
+}
+
+/**
+ * @brief Reads up to kHeaderBytes from the start of a file.
+ *
+ * @return The number of bytes read; 0 if the file cannot be opened or is empty.
+ */
+size_t readHeader(const fs::path& file, char* buffer) {
+#ifdef __linux__
+    // O_NOATIME keeps the scan from dirtying inodes, but is only allowed on our own files
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return 0;
+    }
+    size_t total = 0;
+    while (total < ContentSniffer::kHeaderBytes) {
+        const ssize_t n = ::pread(fd, buffer + total, ContentSniffer::kHeaderBytes - total,
+                                  static_cast<off_t>(total));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        total += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    return total;
+#else
+    std::ifstream in(file, std::ios::binary);
+    in.read(buffer, ContentSniffer::kHeaderBytes);
+    return static_cast<size_t>(in.gcount());
+#endif
+}
+
+} // namespace
+
+std::string_view ContentSniffer::detect(std::string_view header) {
+    header = header.substr(0, std::min(header.size(), kHeaderBytes));
+
+    // Documents
+    if (startsWith(header, "%PDF-")) return ".pdf";
+    if (startsWith(header, "{\\rtf")) return ".rtf";
+    if (startsWith(header, "\xD0\xCF\x11\xE0\xA1\xB1\x1A\xE1")) return ".doc";
+
+    // Images
+    if (startsWith(header, "\x89PNG\r\n\x1A\n")) return ".png";
+    if (startsWith(header, "\xFF\xD8\xFF")) return ".jpg";
+    if (startsWith(header, "GIF87a") || startsWith(header, "GIF89a")) return ".gif";
+    if (startsWith(header, std::string_view("II*\0", 4)) ||
+        startsWith(header, std::string_view("MM\0*", 4))) return ".tiff";
+    if (startsWith(header, "RIFF") && startsWith(header, "WEBP", 8)) return ".webp";
+    // "BM" alone is too common in text; also require the reserved header words to be zero
+    if (startsWith(header, "BM") && header.size() >= 26 &&
+        startsWith(header, std::string_view("\0\0\0\0", 4), 6)) return ".bmp";
+
+    // Video
+    if (startsWith(header, "ftyp", 4) && header.size() >= 12) return detectIsoMedia(header);
+    if (startsWith(header, "\x1A\x45\xDF\xA3")) {
+        return header.find("webm") != std::string_view::npos ? ".webm" : ".mkv";
+    }
+    if (startsWith(header, "RIFF") && startsWith(header, "AVI ", 8)) return ".avi";
+    if (startsWith(header, "FLV\x01")) return ".flv";
+    if (startsWith(header, "\x30\x26\xB2\x75\x8E\x66\xCF\x11")) return ".wmv";
+
+    // Audio
+    if (startsWith(header, "RIFF") && startsWith(header, "WAVE", 8)) return ".wav";
+    if (startsWith(header, "fLaC")) return ".flac";
+    if (startsWith(header, "OggS")) return ".ogg";
+    if (startsWith(header, "ID3") || isMp3Frame(header)) return ".mp3";
+    if (isAdtsFrame(header)) return ".aac";
+
+    // Archives
+    if (startsWith(header, "PK\x03\x04")) return detectZip(header);
+    if (startsWith(header, "Rar!\x1A\x07")) return ".rar";
+    if (startsWith(header, "7z\xBC\xAF\x27\x1C")) return ".7z";
+    if (startsWith(header, "\x1F\x8B")) return ".gz";
+    if (startsWith(header, "ustar", 257)) return ".tar";
+
+    // Markup
+    if (isHtml(header)) return ".html";
+
+    return {};
+}
+
+std::string ContentSniffer::sniff(const fs::path& file) {
+    char buffer[kHeaderBytes];
+    const size_t length = readHeader(file, buffer);
+    return std::string(detect(std::string_view(buffer, length)));
+}
+
+std::vector<std::string> ContentSniffer::sniffAll(const std::vector<fs::path>& files, unsigned threadCount) {
+    std::vector<std::string> results(files.size());
+    if (files.empty()) {
+        return results;
+    }
+
+    const size_t batches = (files.size() + kBatchSize - 1) / kBatchSize;
+    const unsigned requested = threadCount > 0 ? threadCount : kDefaultReadThreads;
+    WorkStealingPool pool(static_cast<unsigned>(std::min<size_t>(requested, batches)));
+
+    // Each batch writes only its own slice of `results`, so no locking is needed
+    for (size_t begin = 0; begin < files.size(); begin += kBatchSize) {
+        const size_t end = std::min(begin + kBatchSize, files.size());
+        pool.submit([&files, &results, begin, end] {
+            char buffer[kHeaderBytes];
+            for (size_t i = begin; i < end; ++i) {
+                const size_t length = readHeader(files[i], buffer);
+                results[i] = std::string(detect(std::string_view(buffer, length)));
+            }
+        });
+    }
+    pool.wait();
+    return results;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class ContentSniffer
+ * @brief Detects the type of a file from the magic bytes at its start.
+ *
+ * Only the first kHeaderBytes of a file are ever read. The result is expressed as
+ * the canonical extension of the detected format (e.g. ".png"), so it can be fed to
+ * the same FileTypeClassifier as real extensions and honors any --types rules.
+ *
+ * sniffAll() reads many files at once: the files are split into batches that run on
+ * a thread pool, each reading its headers with pread. With several reads in flight,
+ * the latency of spinning disks and network-backed storage overlaps instead of adding up.
+ */
+class ContentSniffer {
+public:
+    /// The number of bytes read from the start of each file.
+    static constexpr size_t kHeaderBytes = 4096;
+
+    /// The default number of concurrent reads used by sniffAll().
+    static constexpr unsigned kDefaultReadThreads = 16;
+
+    /**
+     * @brief Detects the format of a file header.
+     *
+     * @param header The first bytes of the file (at most kHeaderBytes are looked at).
+     * @return The canonical extension including the dot, or an empty view if the
+     *         format is not recognized.
+     */
+    static std::string_view detect(std::string_view header);
+
+    /**
+     * @brief Reads the header of a file and detects its format.
+     *
+     * @return The canonical extension, or an empty string if the file cannot be read
+     *         or its format is not recognized.
+     */
+    static std::string sniff(const std::filesystem::path& file);
+
+    /**
+     * @brief Detects the formats of many files with batched, concurrent header reads.
+     *
+     * @param files The files to examine.
+     * @param threadCount The number of concurrent readers; 0 means kDefaultReadThreads.
+     * @return One canonical extension per file, in the order of `files`; empty where
+     *         the file could not be read or was not recognized.
+     */
+    static std::vector<std::string> sniffAll(const std::vector<std::filesystem::path>& files,
+                                             unsigned threadCount = 0);
+};
@@ -0,0 +1,190 @@
+#include "DateScanner.h"
+#include <array>
+#include <cstdint>
+
+namespace {
+
+// Byte classes used by the scanner. The table is built at compile time, so there
+// is nothing to construct at runtime (unlike the three std::regex objects it replaces).
+enum ByteClass : uint8_t {
+    OTHER = 0,
+    DIGIT = 1,
+    SEPARATOR = 2  // '-' or '_'
+};
+
+constexpr std::array<uint8_t, 256> makeByteClassTable() {
+    std::array<uint8_t, 256> table{};
+    for (int c = '0'; c <= '9'; ++c) {
+        table[c] = DIGIT;
+    }
+    table['-'] = SEPARATOR;
+    table['_'] = SEPARATOR;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> kByteClass = makeByteClassTable();
+
+// The shortest string any of the three formats can match ("YYYY-M-D", "D-M-YYYY", "YYYYMMDD").
+constexpr size_t kMinMatchLength = 8;
+
+/**
+ * @brief A view over the filename with bounds-checked byte class queries.
+ */
+struct Cursor {
+    const unsigned char* data;
+    size_t size;
+
+    bool isDigit(size_t i) const { return i < size && kByteClass[data[i]] == DIGIT; }
+    bool isSeparator(size_t i) const { return i < size && kByteClass[data[i]] == SEPARATOR; }
+    int digit(size_t i) const { return data[i] - '0'; }
+
+    /// Parses `len` digits starting at `i`. The caller must have checked they are digits.
+    int number(size_t i, size_t len) const {
+        int value = 0;
+        for (size_t k = 0; k < len; ++k) {
+            value = value * 10 + digit(i + k);
+        }
+        return value;
+    }
+
+    bool digits(size_t i, size_t len) const {
+        for (size_t k = 0; k < len; ++k) {
+            if (!isDigit(i + k)) return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief A matched date: the position of the four year digits and the month number.
+ *
+ * The year is copied verbatim from the filename, which is what the regex version did.
+ */
+struct DateMatch {
+    size_t yearPos = 0;
+    int month = 0;
+    bool found = false;
+};
+
+// Tries the "(\d{4})[-_](\d{1,2})[-_](\d{1,2})" pattern anchored at position i.
+// Greedy order: month of two digits before one. The day is the whole run of one or
+// two digits: an invalid "30" is rejected, not read as day 3.
+DateMatch matchYearFirst(const Cursor& c, size_t i) {
+    DateMatch m;
+    if (!c.digits(i, 4) || !c.isSeparator(i + 4)) return m;
+
+    const int year = c.number(i, 4);
+    const size_t monthPos = i + 5;
+    for (size_t monthLen = 2; monthLen >= 1; --monthLen) {
+        if (!c.digits(monthPos, monthLen) || !c.isSeparator(monthPos + monthLen)) continue;
+        const int month = c.number(monthPos, monthLen);
+        const size_t dayPos = monthPos + monthLen + 1;
+        if (!c.isDigit(dayPos)) continue;
+        const size_t dayLen = c.isDigit(dayPos + 1) ? 2 : 1;
+        if (DateScanner::isValidDate(year, month, c.number(dayPos, dayLen))) {
+            m.yearPos = i;
+            m.month = month;
+            m.found = true;
+            return m;
+        }
+    }
+    return m;
+}
+
+// Tries the "(\d{1,2})[-_](\d{1,2})[-_](\d{4})" pattern anchored at position i.
+// Greedy order: day of two digits before one, then month of two digits before one.
+// The day must start a number, so "29-02-2023" is not read as day 9.
+DateMatch matchDayFirst(const Cursor& c, size_t i) {
+    DateMatch m;
+    if (i > 0 && c.isDigit(i - 1)) return m;
+    for (size_t dayLen = 2; dayLen >= 1; --dayLen) {
+        if (!c.digits(i, dayLen) || !c.isSeparator(i + dayLen)) continue;
+        const int day = c.number(i, dayLen);
+        const size_t monthPos = i + dayLen + 1;
+        for (size_t monthLen = 2; monthLen >= 1; --monthLen) {
+            if (!c.digits(monthPos, monthLen) || !c.isSeparator(monthPos + monthLen)) continue;
+            const size_t yearPos = monthPos + monthLen + 1;
+            if (!c.digits(yearPos, 4)) continue;
+            const int month = c.number(monthPos, monthLen);
+            if (DateScanner::isValidDate(c.number(yearPos, 4), month, day)) {
+                m.yearPos = yearPos;
+                m.month = month;
+                m.found = true;
+                return m;
+            }
+        }
+    }
+    return m;
+}
+
+// Tries the "(\d{4})(\d{2})(\d{2})" pattern anchored at position i.
+DateMatch matchCompact(const Cursor& c, size_t i) {
+    DateMatch m;
+    if (!c.digits(i, 8)) return m;
+    const int month = c.number(i + 4, 2);
+    if (DateScanner::isValidDate(c.number(i, 4), month, c.number(i + 6, 2))) {
+        m.yearPos = i;
+        m.month = month;
+        m.found = true;
+    }
+    return m;
+}
+
+std::string format(const Cursor& c, const DateMatch& m) {
+    // Only YYYY/MM is needed for the directory structure
+    std::string result(7, '/');
+    for (size_t k = 0; k < 4; ++k) {
+        result[k] = static_cast<char>(c.data[m.yearPos + k]);
+    }
+    result[5] = static_cast<char>('0' + m.month / 10);
+    result[6] = static_cast<char>('0' + m.month % 10);
+    return result;
+}
+
+} // namespace
+
+std::string DateScanner::scan(std::string_view filename) {
+    if (filename.size() < kMinMatchLength) {
+        return "";
+    }
+
+    const Cursor c{reinterpret_cast<const unsigned char*>(filename.data()), filename.size()};
+    DateMatch dayFirst;
+    DateMatch compact;
+
+    // One left-to-right pass. A year-first match has the highest precedence, so the
+    // first one found is returned immediately; the leftmost matches of the two
+    // lower-precedence formats are remembered until the end of the pass.
+    const size_t lastStart = filename.size() - kMinMatchLength;
+    for (size_t i = 0; i <= lastStart; ++i) {
+        if (!c.isDigit(i)) continue;
+
+        DateMatch yearFirst = matchYearFirst(c, i);
+        if (yearFirst.found) {
+            return format(c, yearFirst);
+        }
+        if (!dayFirst.found) {
+            dayFirst = matchDayFirst(c, i);
+        }
+        if (!compact.found) {
+            compact = matchCompact(c, i);
+        }
+    }
+
+    if (dayFirst.found) return format(c, dayFirst);
+    if (compact.found) return format(c, compact);
+    return "";
+}
+
+bool DateScanner::isValidDate(int year, int month, int day) {
+    static constexpr int kDaysInMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    if (month < 1 || month > 12 || day < 1) {
+        return false;
+    }
+    int days = kDaysInMonth[month - 1];
+    if (month == 2 && (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))) {
+        days = 29;
+    }
+    return day <= days;
+}
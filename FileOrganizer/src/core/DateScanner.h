@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/**
+ * @class DateScanner
+ * @brief A hand-written, single-pass recognizer for dates embedded in filenames.
+ *
+ * Recognizes the same formats as the original regular expressions, with the same
+ * precedence: YYYY-MM-DD (or YYYY_MM_DD) wins over DD-MM-YYYY (or DD_MM_YYYY), which
+ * wins over YYYYMMDD. Within a format the leftmost match wins, and the digit groups
+ * are tried greedily (two digits before one), like the regex engine did.
+ *
+ * Unlike the regex version, a candidate is only accepted if its month is in 1-12 and
+ * its day exists in that month (leap years included). The day is read as a whole
+ * number: "2023-02-30" and "29-02-2023" are rejected rather than read as day 3 or
+ * day 9. A rejected candidate does not stop the search, so "v2023-13-01_2023-01-05"
+ * still yields "2023/01".
+ *
+ * The scanner walks the bytes once, left to right, using a byte classification
+ * table computed at compile time. It allocates nothing except the returned string.
+ */
+class DateScanner {
+public:
+    /**
+     * @brief Scans a filename for the first valid date.
+     *
+     * @param filename The name of the file (without path or extension).
+     * @return A string in "YYYY/MM" format, or an empty string if no valid date is found.
+     */
+    static std::string scan(std::string_view filename);
+
+    /**
+     * @brief Checks whether the given year/month/day form a real calendar date.
+     *
+     * @param year The year (any four-digit value).
+     * @param month The month, expected in 1-12.
+     * @param day The day, expected in 1 to the length of the month.
+     * @return True if the date exists in the proleptic Gregorian calendar.
+     */
+    static bool isValidDate(int year, int month, int day);
+};
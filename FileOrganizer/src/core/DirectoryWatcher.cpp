@@ -0,0 +1,96 @@
+#include "DirectoryWatcher.h"
+#include <stdexcept>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+
+namespace {
+
+/// Enough for several hundred events per read(), so bursts drain in few calls.
+constexpr size_t kEventBufferBytes = 64 * 1024;
+
+std::runtime_error systemError(const std::string& what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(const fs::path& directory) {
+    fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        throw systemError("cannot start inotify");
+    }
+    watch = ::inotify_add_watch(fd, directory.c_str(), IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (watch < 0) {
+        const std::runtime_error error = systemError("cannot watch " + directory.string());
+        ::close(fd);
+        throw error;
+    }
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    ::close(fd);
+}
+
+bool DirectoryWatcher::wait(std::chrono::milliseconds timeout, std::vector<WatchEvent>& events) {
+    pollfd descriptor{fd, POLLIN, 0};
+    const int ready = ::poll(&descriptor, 1, static_cast<int>(timeout.count()));
+    if (ready < 0) {
+        if (errno == EINTR) return false;
+        throw systemError("cannot wait for file events");
+    }
+
+    alignas(inotify_event) char buffer[kEventBufferBytes];
+    while (true) {
+        const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EAGAIN) return true;   // Drained
+            if (errno == EINTR) return false;
+            throw systemError("cannot read file events");
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            if ((event->mask & IN_ISDIR) || event->len == 0) {
+                continue;
+            }
+            const WatchEvent::Kind kind = (event->mask & IN_CREATE) ? WatchEvent::CREATED : WatchEvent::COMPLETED;
+            events.push_back(WatchEvent{kind, std::string(event->name)});
+        }
+    }
+}
+
+#else
+
+DirectoryWatcher::DirectoryWatcher(const fs::path&) {
+    throw std::runtime_error("watching a directory requires inotify, which this platform lacks");
+}
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+
+bool DirectoryWatcher::wait(std::chrono::milliseconds, std::vector<WatchEvent>&) {
+    return true;
+}
+
+#endif
+
+bool DirectoryWatcher::overflowed() {
+    const bool result = overflow;
+    overflow = false;
+    return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * @struct WatchEvent
+ * @brief Something happened to a file in the watched directory.
+ */
+struct WatchEvent {
+    enum Kind {
+        CREATED,    ///< The file appeared; it may still be being written.
+        COMPLETED   ///< The file was closed after writing, or moved in whole.
+    };
+
+    Kind kind;
+    std::string name;   ///< The filename, relative to the watched directory.
+};
+
+/**
+ * @class DirectoryWatcher
+ * @brief Reports files that are created in, written to, or moved into one directory.
+ *
+ * On Linux this is a thin wrapper around inotify, subscribed to IN_CREATE,
+ * IN_CLOSE_WRITE and IN_MOVED_TO on the directory itself (not its subdirectories,
+ * where the organizer puts files). Events for directories are dropped.
+ *
+ * The kernel queue is bounded. If it overflows during a large burst, overflowed()
+ * is set and the caller must rescan the directory to catch what was lost.
+ */
+class DirectoryWatcher {
+public:
+    /**
+     * @brief Starts watching a directory.
+     *
+     * @throws std::runtime_error If the directory cannot be watched, or if the platform
+     *         has no inotify.
+     */
+    explicit DirectoryWatcher(const std::filesystem::path& directory);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /**
+     * @brief Waits for events and drains everything that is queued.
+     *
+     * @param timeout How long to wait if no event is queued yet.
+     * @param events Receives the events, appended in the order they happened.
+     * @return False if the wait was interrupted by a signal, true otherwise.
+     * @throws std::runtime_error If reading the events fails.
+     */
+    bool wait(std::chrono::milliseconds timeout, std::vector<WatchEvent>& events);
+
+    /**
+     * @brief Checks and clears the queue-overflow flag.
+     */
+    bool overflowed();
+
+private:
+    int fd = -1;
+    int watch = -1;
+    bool overflow = false;
+};
@@ -0,0 +1,417 @@
+#include "DuplicateFinder.h"
+#include "utils/WorkStealingPool.h"
+#include "utils/XxHash64.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Files per pool task in the stat and edge stages.
+constexpr size_t kBatchSize = 64;
+
+/// The outcome of comparing a file with the copy to keep.
+enum class Comparison { SAME, DIFFERENT, FIRST_UNREADABLE, SECOND_UNREADABLE };
+
+struct Candidate {
+    size_t index;
+    uintmax_t size = 0;
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t digest = 0;
+    bool complete = false;   ///< The digest covers the whole file.
+    bool valid = false;      ///< Stat'ed (and, later, hashed) successfully.
+    Comparison comparison = Comparison::SAME;  ///< Against the copy to keep, in stage 4.
+};
+
+/**
+ * @brief A read-only file for positioned reads.
+ */
+class InputFile {
+public:
+    explicit InputFile(const fs::path& path) {
+#ifdef __linux__
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0 && errno == EPERM) {
+            fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+#else
+        in.open(path, std::ios::binary);
+#endif
+    }
+
+#ifdef __linux__
+    ~InputFile() {
+        if (fd >= 0) ::close(fd);
+    }
+#endif
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    bool isOpen() const {
+#ifdef __linux__
+        return fd >= 0;
+#else
+        return in.is_open();
+#endif
+    }
+
+    void adviseSequential() {
+#ifdef __linux__
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    /**
+     * @brief Reads exactly `length` bytes at `offset`.
+     *
+     * @return False on a read error or if the file is shorter than expected.
+     */
+    bool readAt(char* buffer, size_t length, uintmax_t offset) {
+#ifdef __linux__
+        size_t done = 0;
+        while (done < length) {
+            const ssize_t n = ::pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        return true;
+#else
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(buffer, static_cast<std::streamsize>(length));
+        return static_cast<size_t>(in.gcount()) == length;
+#endif
+    }
+
+private:
+#ifdef __linux__
+    int fd = -1;
+#else
+    std::ifstream in;
+#endif
+};
+
+/**
+ * @brief Fills in the size and identity of a file; leaves it invalid unless it is
+ *        a non-empty regular file (symlinks are not followed).
+ */
+void statCandidate(const fs::path& path, Candidate& candidate) {
+#ifdef __linux__
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return;
+    }
+    candidate.size = static_cast<uintmax_t>(st.st_size);
+    candidate.device = static_cast<uint64_t>(st.st_dev);
+    candidate.inode = static_cast<uint64_t>(st.st_ino);
+#else
+    std::error_code ec;
+    if (!fs::is_regular_file(fs::symlink_status(path, ec))) {
+        return;
+    }
+    candidate.size = fs::file_size(path, ec);
+    if (ec || candidate.size == 0) {
+        return;
+    }
+#endif
+    candidate.valid = true;
+}
+
+void hashEdges(const fs::path& path, Candidate& candidate, std::atomic<uintmax_t>& bytesRead) {
+    candidate.valid = false;
+    InputFile file(path);
+    if (!file.isOpen()) {
+        return;
+    }
+
+    char buffer[2 * DuplicateFinder::kEdgeBytes];
+    XxHash64 hash(candidate.size);
+    if (candidate.size <= sizeof(buffer)) {
+        const size_t length = static_cast<size_t>(candidate.size);
+        if (!file.readAt(buffer, length, 0)) return;
+        hash.update(buffer, length);
+        bytesRead += length;
+        candidate.complete = true;
+    } else {
+        const size_t edge = DuplicateFinder::kEdgeBytes;
+        if (!file.readAt(buffer, edge, 0) ||
+            !file.readAt(buffer + edge, edge, candidate.size - edge)) return;
+        hash.update(buffer, sizeof(buffer));
+        bytesRead += sizeof(buffer);
+    }
+    candidate.digest = hash.digest();
+    candidate.valid = true;
+}
+
+void hashContent(const fs::path& path, Candidate& candidate, std::vector<char>& buffer,
+                 std::atomic<uintmax_t>& bytesRead) {
+    candidate.valid = false;
+    InputFile file(path);
+    if (!file.isOpen()) {
+        return;
+    }
+    file.adviseSequential();
+
+    XxHash64 hash(candidate.size);
+    for (uintmax_t offset = 0; offset < candidate.size;) {
+        const size_t length = static_cast<size_t>(std::min<uintmax_t>(buffer.size(), candidate.size - offset));
+        if (!file.readAt(buffer.data(), length, offset)) return;
+        hash.update(buffer.data(), length);
+        bytesRead += length;
+        offset += length;
+    }
+    candidate.digest = hash.digest();
+    candidate.complete = true;
+    candidate.valid = true;
+}
+
+/**
+ * @brief Compares the first `size` bytes of two files, reading both into halves of `buffer`.
+ */
+Comparison compareContent(const fs::path& first, const fs::path& second, uintmax_t size,
+                          std::vector<char>& buffer, std::atomic<uintmax_t>& bytesRead) {
+    InputFile firstFile(first);
+    if (!firstFile.isOpen()) {
+        return Comparison::FIRST_UNREADABLE;
+    }
+    InputFile secondFile(second);
+    if (!secondFile.isOpen()) {
+        return Comparison::SECOND_UNREADABLE;
+    }
+    firstFile.adviseSequential();
+    secondFile.adviseSequential();
+
+    const size_t half = buffer.size() / 2;
+    char* firstBuffer = buffer.data();
+    char* secondBuffer = buffer.data() + half;
+    for (uintmax_t offset = 0; offset < size;) {
+        const size_t length = static_cast<size_t>(std::min<uintmax_t>(half, size - offset));
+        if (!firstFile.readAt(firstBuffer, length, offset)) return Comparison::FIRST_UNREADABLE;
+        if (!secondFile.readAt(secondBuffer, length, offset)) return Comparison::SECOND_UNREADABLE;
+        bytesRead += 2 * length;
+        if (std::memcmp(firstBuffer, secondBuffer, length) != 0) {
+            return Comparison::DIFFERENT;
+        }
+        offset += length;
+    }
+    return Comparison::SAME;
+}
+
+/**
+ * @brief Runs `function(i)` for every i in [0, count) in batches on the pool, and waits.
+ */
+template <typename Function>
+void forEachBatched(WorkStealingPool& pool, size_t count, const Function& function) {
+    for (size_t begin = 0; begin < count; begin += kBatchSize) {
+        const size_t end = std::min(begin + kBatchSize, count);
+        pool.submit([&function, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                function(i);
+            }
+        });
+    }
+    pool.wait();
+}
+
+/**
+ * @brief Calls `onGroup(first, last)` for every run of at least two valid candidates
+ *        that agree on size and digest.
+ */
+template <typename Function>
+void forEachMatchingRun(std::vector<Candidate*>& candidates, const Function& onGroup) {
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate* a, const Candidate* b) {
+        if (a->valid != b->valid) return a->valid;
+        if (a->size != b->size) return a->size < b->size;
+        if (a->digest != b->digest) return a->digest < b->digest;
+        return a->index < b->index;
+    });
+    for (size_t begin = 0; begin < candidates.size() && candidates[begin]->valid;) {
+        size_t end = begin + 1;
+        while (end < candidates.size() && candidates[end]->valid &&
+               candidates[end]->size == candidates[begin]->size &&
+               candidates[end]->digest == candidates[begin]->digest) {
+            ++end;
+        }
+        if (end - begin >= 2) {
+            onGroup(candidates.begin() + begin, candidates.begin() + end);
+        }
+        begin = end;
+    }
+}
+
+} // namespace
+
+DuplicateReport DuplicateFinder::find(const std::vector<FileInfo>& files, unsigned threadCount) {
+    DuplicateReport report;
+    if (files.size() < 2) {
+        return report;
+    }
+    WorkStealingPool pool(threadCount);
+    std::atomic<uintmax_t> bytesRead{0};
+
+    // Stage 1: sizes and identities
+    std::vector<Candidate> all(files.size());
+    forEachBatched(pool, files.size(), [&](size_t i) {
+        all[i].index = i;
+        statCandidate(files[i].path, all[i]);
+    });
+
+    // Hard links to one inode are the same file: only the first name is compared,
+    // the others follow it as aliases
+    std::vector<Candidate*> bySize;
+    bySize.reserve(all.size());
+    for (auto& candidate : all) {
+        if (candidate.valid) bySize.push_back(&candidate);
+    }
+    std::sort(bySize.begin(), bySize.end(), [](const Candidate* a, const Candidate* b) {
+        if (a->size != b->size) return a->size < b->size;
+        if (a->device != b->device) return a->device < b->device;
+        if (a->inode != b->inode) return a->inode < b->inode;
+        return a->index < b->index;
+    });
+    std::vector<std::pair<const Candidate*, size_t>> aliases;  // (first name, other name)
+    std::vector<Candidate*> edgeCandidates;
+    for (size_t begin = 0; begin < bySize.size();) {
+        size_t end = begin + 1;
+        while (end < bySize.size() && bySize[end]->size == bySize[begin]->size) ++end;
+
+        const size_t groupStart = edgeCandidates.size();
+        const size_t aliasStart = aliases.size();
+        for (size_t i = begin; i < end; ++i) {
+            Candidate* representative = edgeCandidates.size() > groupStart ? edgeCandidates.back() : nullptr;
+            if (representative && representative->inode != 0 &&
+                representative->device == bySize[i]->device && representative->inode == bySize[i]->inode) {
+                aliases.emplace_back(representative, bySize[i]->index);
+            } else {
+                edgeCandidates.push_back(bySize[i]);
+            }
+        }
+        // A size shared with no other file rules out any duplicate without reading it
+        if (edgeCandidates.size() - groupStart < 2) {
+            edgeCandidates.resize(groupStart);
+            aliases.resize(aliasStart);
+        }
+        begin = end;
+    }
+
+    // Stage 2: the first and last blocks
+    forEachBatched(pool, edgeCandidates.size(), [&](size_t i) {
+        hashEdges(files[edgeCandidates[i]->index].path, *edgeCandidates[i], bytesRead);
+    });
+
+    std::vector<std::vector<Candidate*>> matches;
+    std::vector<Candidate*> contentCandidates;
+    forEachMatchingRun(edgeCandidates, [&](auto first, auto last) {
+        if ((*first)->complete) {
+            matches.emplace_back(first, last);
+        } else {
+            contentCandidates.insert(contentCandidates.end(), first, last);
+        }
+    });
+
+    // Stage 3: full content, one file per task and largest first so the tail stays short
+    std::stable_sort(contentCandidates.begin(), contentCandidates.end(),
+                     [](const Candidate* a, const Candidate* b) { return a->size > b->size; });
+    std::vector<std::vector<char>> buffers(pool.size());
+    for (Candidate* candidate : contentCandidates) {
+        pool.submit([&, candidate] {
+            std::vector<char>& buffer = buffers[pool.workerIndex()];
+            if (buffer.empty()) buffer.resize(kReadBytes);
+            hashContent(files[candidate->index].path, *candidate, buffer, bytesRead);
+        });
+    }
+    pool.wait();
+    report.fullyHashed = contentCandidates.size();
+
+    forEachMatchingRun(contentCandidates, [&](auto first, auto last) {
+        matches.emplace_back(first, last);
+    });
+
+    // Stage 4: every file against the first one scanned, which is the one kept. Files
+    // that differ (or whose kept copy became unreadable) form the next round's groups.
+    std::vector<std::vector<Candidate*>> verified;
+    while (!matches.empty()) {
+        for (auto& match : matches) {
+            std::sort(match.begin(), match.end(),
+                      [](const Candidate* a, const Candidate* b) { return a->index < b->index; });
+            const Candidate* kept = match.front();
+            for (size_t i = 1; i < match.size(); ++i) {
+                Candidate* other = match[i];
+                pool.submit([&, kept, other] {
+                    std::vector<char>& buffer = buffers[pool.workerIndex()];
+                    if (buffer.empty()) buffer.resize(kReadBytes);
+                    other->comparison = compareContent(files[kept->index].path, files[other->index].path,
+                                                       kept->size, buffer, bytesRead);
+                });
+            }
+        }
+        pool.wait();
+
+        std::vector<std::vector<Candidate*>> remaining;
+        for (const auto& match : matches) {
+            std::vector<Candidate*> same{match.front()};
+            std::vector<Candidate*> different;
+            bool keptReadable = true;
+            for (size_t i = 1; i < match.size(); ++i) {
+                switch (match[i]->comparison) {
+                    case Comparison::SAME: same.push_back(match[i]); break;
+                    case Comparison::DIFFERENT: different.push_back(match[i]); break;
+                    case Comparison::FIRST_UNREADABLE: keptReadable = false; different.push_back(match[i]); break;
+                    case Comparison::SECOND_UNREADABLE: break;  // Left out, like any unreadable file
+                }
+            }
+            if (!keptReadable) {
+                different.insert(different.end(), same.begin() + 1, same.end());
+                same.resize(1);
+            }
+            if (same.size() >= 2) verified.push_back(std::move(same));
+            if (different.size() >= 2) remaining.push_back(std::move(different));
+        }
+        matches.swap(remaining);
+    }
+
+    std::unordered_multimap<const Candidate*, size_t> aliasesOf(aliases.begin(), aliases.end());
+
+    // The first file scanned is kept. Its copies follow in scan order, including the
+    // other names of copies; other names of the kept file itself are left alone.
+    for (auto& match : verified) {
+        std::sort(match.begin(), match.end(),
+                  [](const Candidate* a, const Candidate* b) { return a->index < b->index; });
+        DuplicateGroup group;
+        group.canonical = match.front()->index;
+        group.size = match.front()->size;
+        for (size_t i = 1; i < match.size(); ++i) {
+            group.duplicates.push_back(match[i]->index);
+            auto [first, last] = aliasesOf.equal_range(match[i]);
+            for (auto it = first; it != last; ++it) {
+                group.duplicates.push_back(it->second);
+            }
+        }
+        std::sort(group.duplicates.begin(), group.duplicates.end());
+        report.groups.push_back(std::move(group));
+    }
+    std::sort(report.groups.begin(), report.groups.end(),
+              [](const DuplicateGroup& a, const DuplicateGroup& b) { return a.canonical < b.canonical; });
+
+    report.bytesRead = bytesRead.load();
+    return report;
+}
+
+bool DuplicateFinder::identical(const fs::path& first, const fs::path& second, uintmax_t size) {
+    std::vector<char> buffer(static_cast<size_t>(std::min<uintmax_t>(2 * size, kReadBytes)));
+    std::atomic<uintmax_t> bytesRead{0};
+    return compareContent(first, second, size, buffer, bytesRead) == Comparison::SAME;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FileScanner.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @struct DuplicateGroup
+ * @brief A set of files with identical content.
+ */
+struct DuplicateGroup {
+    size_t canonical;                 ///< Index of the copy to keep (the first one scanned).
+    std::vector<size_t> duplicates;   ///< Indices of the other copies, in scan order.
+    uintmax_t size = 0;               ///< The size of each copy in bytes.
+};
+
+/**
+ * @struct DuplicateReport
+ * @brief The result of a duplicate search, with the I/O it took.
+ */
+struct DuplicateReport {
+    std::vector<DuplicateGroup> groups;  ///< Ordered by the index of their canonical file.
+    uintmax_t bytesRead = 0;             ///< Total bytes read to compare content.
+    size_t fullyHashed = 0;              ///< Files whose whole content had to be hashed.
+};
+
+/**
+ * @class DuplicateFinder
+ * @brief Finds byte-identical regular files while reading as little as possible.
+ *
+ * Candidates are narrowed down in stages, each cheaper than the next:
+ *
+ *   1. Size. Files are stat'ed (in parallel) and grouped by size; a file with a
+ *      unique size has no duplicate and is never opened. Hard links to the same
+ *      inode are read once; if that inode turns out to be a copy, all of its names
+ *      are reported as duplicates. Empty files and symlinks are ignored.
+ *   2. Edges. Within each size group, the first and last kEdgeBytes of every file
+ *      are hashed. Files up to 2 * kEdgeBytes are thereby hashed completely.
+ *   3. Content. Only files that still match on size and edges are hashed in full,
+ *      with large sequential reads.
+ *   4. Bytes. The digests (64-bit XXH64, seeded with the file size) only narrow
+ *      the candidates down: every file of a group is compared byte for byte with
+ *      the copy to keep, so a hash collision never groups different files. Files
+ *      that differ from it are compared among themselves in another round.
+ *
+ * The reads of stages 2 to 4 are spread over a thread pool, one file per task in
+ * stages 3 and 4, largest first in stage 3. Memory use is a few dozen bytes per
+ * scanned file plus one read buffer per thread, so multi-terabyte trees are fine.
+ */
+class DuplicateFinder {
+public:
+    /// Bytes hashed at each end of a file in the edge stage.
+    static constexpr size_t kEdgeBytes = 4096;
+
+    /// Read size of the full-content stage.
+    static constexpr size_t kReadBytes = 1u << 20;
+
+    /**
+     * @brief Finds the groups of identical files.
+     *
+     * Files that cannot be read are left out rather than reported as an error.
+     *
+     * @param files The scanned files.
+     * @param threadCount The number of reader threads; 0 means one per hardware thread.
+     * @return The duplicate groups, with indices into `files`.
+     */
+    static DuplicateReport find(const std::vector<FileInfo>& files, unsigned threadCount = 0);
+
+    /**
+     * @brief Compares the first `size` bytes of two files.
+     *
+     * @return True if both files could be read and these bytes are identical.
+     */
+    static bool identical(const std::filesystem::path& first, const std::filesystem::path& second,
+                          uintmax_t size);
+};
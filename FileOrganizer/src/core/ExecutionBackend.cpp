@@ -0,0 +1,339 @@
+#include "ExecutionBackend.h"
+#include "utils/Stats.h"
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <list>
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_map>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+[[noreturn]] void throwTaken(const fs::path& source, const fs::path& destination) {
+    throw fs::filesystem_error("destination is taken", source, destination,
+                               std::make_error_code(std::errc::file_exists));
+}
+
+/**
+ * @class PathBackend
+ * @brief The portable backend: std::filesystem calls on full paths.
+ *
+ * Without an atomic no-clobber rename, a taken destination is detected by a check
+ * just before the rename; a file created in between would still be replaced.
+ */
+class PathBackend : public ExecutionBackend {
+public:
+    const char* name() const override { return "path"; }
+
+    void createDirectories(const fs::path& directory) override {
+        if (fs::create_directories(directory)) {
+            Stats::add(Stats::DIRECTORIES_CREATED);
+        }
+    }
+
+    MoveResult move(const fs::path& source, const fs::path& destination,
+                    bool createParent, bool findFreeName) override {
+        if (createParent) {
+            createDirectories(destination.parent_path());
+        }
+        for (int n = 0; n <= kMaxSuffix; ++n) {
+            const fs::path candidate = n == 0 ? destination : suffixedName(destination, n);
+            std::error_code ec;
+            Stats::add(Stats::EXISTS_PROBES);
+            if (fs::exists(fs::symlink_status(candidate, ec))) {
+                if (!findFreeName) {
+                    throwTaken(source, candidate);
+                }
+                continue;
+            }
+            fs::rename(source, candidate, ec);
+            if (!ec) {
+                Stats::add(Stats::RENAMES);
+                return MoveResult{candidate, std::nullopt};
+            }
+            if (ec == std::errc::cross_device_link) {
+                Stats::add(Stats::EXDEV_FALLBACKS);
+                if (std::optional<TransferResult> transfer = transferUnlessTaken(source, candidate)) {
+                    return MoveResult{candidate, transfer};
+                }
+                if (!findFreeName) {
+                    throwTaken(source, candidate);
+                }
+                continue;
+            }
+            throw fs::filesystem_error("cannot rename", source, candidate, ec);
+        }
+        throwTaken(source, destination);
+    }
+};
+
+#ifdef __linux__
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+/**
+ * @brief An open directory descriptor, closed when the last user lets go of it.
+ */
+struct DirectoryHandle {
+    int fd;
+    explicit DirectoryHandle(int fd) : fd(fd) {}
+    ~DirectoryHandle() { ::close(fd); }
+    DirectoryHandle(const DirectoryHandle&) = delete;
+    DirectoryHandle& operator=(const DirectoryHandle&) = delete;
+};
+
+/**
+ * @class DirectoryFdBackend
+ * @brief The Linux backend: *at() calls relative to cached directory descriptors.
+ *
+ * Descriptors are opened with O_PATH, which needs no read permission and is enough
+ * for mkdirat and renameat2. A descriptor evicted from the cache while another
+ * thread still uses it stays open until that thread is done with it.
+ *
+ * The cache trusts that a directory it has opened is not moved away during the run;
+ * an action into a directory replaced behind its back lands in the original one.
+ */
+class DirectoryFdBackend : public ExecutionBackend {
+public:
+    /// Well below the usual 1024-descriptor limit, and plenty for a run's working set.
+    static constexpr size_t kCacheCapacity = 128;
+
+    const char* name() const override { return "dirfd"; }
+
+    void createDirectories(const fs::path& directory) override {
+        openDirectory(directory, true);
+    }
+
+    MoveResult move(const fs::path& source, const fs::path& destination,
+                    bool createParent, bool findFreeName) override {
+        const Handle from = openDirectory(source.parent_path(), false);
+        const Handle to = openDirectory(destination.parent_path(), createParent);
+        const std::string sourceName = source.filename().string();
+
+        for (int n = 0; n <= kMaxSuffix; ++n) {
+            const fs::path candidate = n == 0 ? destination : suffixedName(destination, n);
+            const std::string candidateName = candidate.filename().string();
+            int error = renameNoReplace(from->fd, sourceName.c_str(), to->fd, candidateName.c_str());
+            if (error == EXDEV) {
+                // FileTransfer replaces its destination, so check for a clash first
+                struct stat st;
+                Stats::add(Stats::EXISTS_PROBES);
+                error = ::fstatat(to->fd, candidateName.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0 ? EEXIST : 0;
+                if (error == 0) {
+                    Stats::add(Stats::EXDEV_FALLBACKS);
+                    if (std::optional<TransferResult> transfer = transferUnlessTaken(source, candidate)) {
+                        return MoveResult{candidate, transfer};
+                    }
+                    error = EEXIST;
+                }
+            }
+            if (error == 0) {
+                Stats::add(Stats::RENAMES);
+                return MoveResult{candidate, std::nullopt};
+            }
+            if (error != EEXIST) {
+                throw fs::filesystem_error("cannot rename", source, candidate,
+                                           std::error_code(error, std::generic_category()));
+            }
+            if (!findFreeName) {
+                throwTaken(source, candidate);
+            }
+        }
+        throwTaken(source, destination);
+    }
+
+private:
+    using Handle = std::shared_ptr<const DirectoryHandle>;
+    using Entry = std::pair<std::string, Handle>;
+
+    std::mutex mutex;
+    std::list<Entry> recent;                                          ///< Most recently used first.
+    std::unordered_map<std::string, std::list<Entry>::iterator> cache;
+    std::atomic<bool> noReplaceUnsupported{false};                ///< The kernel has no renameat2.
+    std::mutex probeMutex;
+    std::unordered_map<dev_t, bool> noReplaceByDevice;            ///< Probed filesystems: RENAME_NOREPLACE works.
+
+    Handle lookup(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+            return nullptr;
+        }
+        recent.splice(recent.begin(), recent, it->second);
+        return it->second->second;
+    }
+
+    Handle insert(const std::string& key, int fd) {
+        Handle handle = std::make_shared<const DirectoryHandle>(fd);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second->second;  // Another thread opened it first; ours is closed
+        }
+        recent.emplace_front(key, handle);
+        cache.emplace(key, recent.begin());
+        if (recent.size() > kCacheCapacity) {
+            cache.erase(recent.back().first);
+            recent.pop_back();
+        }
+        return handle;
+    }
+
+    /**
+     * @brief Gets a descriptor for a directory, creating it (and its parents) if asked.
+     *
+     * A missing directory is created with mkdirat relative to its parent's
+     * descriptor, which comes from the cache in the common case.
+     */
+    Handle openDirectory(fs::path directory, bool create) {
+        if (directory.empty()) {
+            directory = ".";
+        } else if (!directory.has_filename() && directory.has_relative_path()) {
+            directory = directory.parent_path();  // Trailing separator
+        }
+        const std::string key = directory.string();
+        if (Handle handle = lookup(key)) {
+            return handle;
+        }
+
+        constexpr int kFlags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+        int fd = ::open(key.c_str(), kFlags);
+        if (fd < 0 && errno == ENOENT && create && directory.has_relative_path()) {
+            const Handle parent = openDirectory(directory.parent_path(), true);
+            const std::string name = directory.filename().string();
+            if (::mkdirat(parent->fd, name.c_str(), 0777) == 0) {
+                Stats::add(Stats::DIRECTORIES_CREATED);
+            } else if (errno != EEXIST) {
+                throw fs::filesystem_error("cannot create directory", directory,
+                                           std::error_code(errno, std::generic_category()));
+            }
+            fd = ::openat(parent->fd, name.c_str(), kFlags);
+        }
+        if (fd < 0) {
+            throw fs::filesystem_error("cannot open directory", directory,
+                                       std::error_code(errno, std::generic_category()));
+        }
+        return insert(key, fd);
+    }
+
+    /**
+     * @brief renameat2 with RENAME_NOREPLACE, or a check and a renameat where the
+     *        filesystem or kernel lacks it.
+     *
+     * EINVAL is also what an ordinary bad rename returns (a directory into its own
+     * subtree, say), so it only leads to the fallback once a probe has shown that
+     * the destination's filesystem rejects the flag.
+     *
+     * @return 0 or the errno of the failure.
+     */
+    int renameNoReplace(int fromFd, const char* fromName, int toFd, const char* toName) {
+#ifdef SYS_renameat2
+        if (!noReplaceUnsupported.load(std::memory_order_relaxed)) {
+            if (::syscall(SYS_renameat2, fromFd, fromName, toFd, toName, RENAME_NOREPLACE) == 0) {
+                return 0;
+            }
+            const int error = errno;
+            if (error == ENOSYS) {
+                noReplaceUnsupported.store(true, std::memory_order_relaxed);
+            } else if (error != EINVAL || supportsNoReplace(toFd)) {
+                return error;
+            }
+        }
+#endif
+        struct stat st;
+        Stats::add(Stats::EXISTS_PROBES);
+        if (::fstatat(toFd, toName, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            return EEXIST;
+        }
+        return ::renameat(fromFd, fromName, toFd, toName) == 0 ? 0 : errno;
+    }
+
+#ifdef SYS_renameat2
+    /**
+     * @brief Whether the filesystem of a directory honors RENAME_NOREPLACE; probed
+     *        once per filesystem.
+     */
+    bool supportsNoReplace(int directoryFd) {
+        struct stat st;
+        if (::fstat(directoryFd, &st) != 0) {
+            return true;  // Cannot tell: report the error rather than give up the atomic rename
+        }
+        std::lock_guard<std::mutex> lock(probeMutex);
+        auto it = noReplaceByDevice.find(st.st_dev);
+        if (it == noReplaceByDevice.end()) {
+            it = noReplaceByDevice.emplace(st.st_dev, probeNoReplace(directoryFd)).first;
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief Renames a scratch file inside a directory with RENAME_NOREPLACE.
+     *
+     * @return False only if the filesystem rejected the flag with EINVAL.
+     */
+    static bool probeNoReplace(int directoryFd) {
+        static std::atomic<unsigned> probes{0};
+        const std::string from = ".fileorganizer-probe-" + std::to_string(::getpid()) + "-" +
+                                 std::to_string(probes.fetch_add(1));
+        const std::string to = from + "-renamed";
+        const int fd = ::openat(directoryFd, from.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return true;
+        }
+        ::close(fd);
+        const bool supported =
+            ::syscall(SYS_renameat2, directoryFd, from.c_str(), directoryFd, to.c_str(), RENAME_NOREPLACE) == 0 ||
+            errno != EINVAL;
+        ::unlinkat(directoryFd, from.c_str(), 0);
+        ::unlinkat(directoryFd, to.c_str(), 0);
+        return supported;
+    }
+#endif
+};
+
+#endif
+
+} // namespace
+
+std::optional<TransferResult> ExecutionBackend::transferUnlessTaken(const fs::path& source,
+                                                                    const fs::path& destination) {
+    try {
+        return FileTransfer::moveAcrossDevices(source, destination);
+    } catch (const fs::filesystem_error& e) {
+        // Taken while the data was copied: the copy is discarded, the source kept
+        if (e.code() == std::errc::file_exists) {
+            return std::nullopt;
+        }
+        throw;
+    }
+}
+
+std::unique_ptr<ExecutionBackend> ExecutionBackend::create() {
+#ifdef __linux__
+    return std::make_unique<DirectoryFdBackend>();
+#else
+    return createPortable();
+#endif
+}
+
+std::unique_ptr<ExecutionBackend> ExecutionBackend::createPortable() {
+    return std::make_unique<PathBackend>();
+}
+
+fs::path ExecutionBackend::suffixedName(const fs::path& destination, int n) {
+    return destination.parent_path() /
+        (destination.stem().string() + " (" + std::to_string(n) + ")" + destination.extension().string());
+}
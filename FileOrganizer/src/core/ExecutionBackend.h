@@ -0,0 +1,90 @@
+#pragma once
+
+#include "FileTransfer.h"
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+/**
+ * @struct MoveResult
+ * @brief Where a moved file ended up, and how it got there.
+ */
+struct MoveResult {
+    std::filesystem::path destination;          ///< The final path; differs from the planned one after a clash.
+    std::optional<TransferResult> transfer;     ///< Set for a cross-device move.
+};
+
+/**
+ * @class ExecutionBackend
+ * @brief Performs the filesystem side of the MOVE, RENAME and CREATE_DIR actions.
+ *
+ * Two implementations exist. The portable one works on full paths with
+ * std::filesystem. On Linux, the default one keeps an LRU cache of open directory
+ * descriptors and issues mkdirat/renameat2 relative to them, so the kernel does not
+ * walk every path from the root again, and a directory already known to exist is
+ * never created twice. Its renames use RENAME_NOREPLACE, so a destination taken
+ * after planning is never overwritten; the check and the rename are one atomic step.
+ *
+ * One backend lives for one execution. All methods are thread-safe.
+ */
+class ExecutionBackend {
+public:
+    virtual ~ExecutionBackend() = default;
+
+    /**
+     * @brief Creates the best backend for this platform.
+     */
+    static std::unique_ptr<ExecutionBackend> create();
+
+    /**
+     * @brief Creates the portable, path-based backend.
+     */
+    static std::unique_ptr<ExecutionBackend> createPortable();
+
+    /**
+     * @brief The name of the backend, for diagnostics.
+     */
+    virtual const char* name() const = 0;
+
+    /**
+     * @brief Creates a directory and its missing parents.
+     *
+     * @throws std::filesystem::filesystem_error If it cannot be created.
+     */
+    virtual void createDirectories(const std::filesystem::path& directory) = 0;
+
+    /**
+     * @brief Moves a file without ever overwriting an existing one.
+     *
+     * A cross-device move falls back to FileTransfer.
+     *
+     * @param source The file to move.
+     * @param destination The planned destination.
+     * @param createParent Create the destination's directory if it is missing.
+     * @param findFreeName If the destination is taken, try "stem (N).ext" with
+     *        N = 1, 2, ... instead of failing.
+     * @throws std::filesystem::filesystem_error If the file could not be moved,
+     *         with errc::file_exists if the destination is taken and
+     *         `findFreeName` is false.
+     */
+    virtual MoveResult move(const std::filesystem::path& source, const std::filesystem::path& destination,
+                            bool createParent, bool findFreeName) = 0;
+
+protected:
+    /// The number of suffixes tried before a move gives up.
+    static constexpr int kMaxSuffix = 10000;
+
+    /**
+     * @brief Moves a file across filesystems with FileTransfer.
+     *
+     * @return How it was transferred, or nothing if the destination was taken by
+     *         the time the copy was renamed into place.
+     */
+    static std::optional<TransferResult> transferUnlessTaken(const std::filesystem::path& source,
+                                                             const std::filesystem::path& destination);
+
+    /**
+     * @brief The Nth alternative to a taken name: "stem (N).ext".
+     */
+    static std::filesystem::path suffixedName(const std::filesystem::path& destination, int n);
+};
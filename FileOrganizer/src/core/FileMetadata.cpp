@@ -0,0 +1,124 @@
+#include "FileMetadata.h"
+#include "utils/Stats.h"
+#include "utils/XxHash64.h"
+#include <chrono>
+#include <ctime>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace fs = std::filesystem;
+
+bool FileMetadata::fetch(const fs::path& file, unsigned wanted) {
+    const unsigned missing = wanted & ~(fields | unavailable);
+    if (missing == 0 || failed) {
+        return has(wanted);
+    }
+    Stats::add(Stats::METADATA_STATS);
+
+#ifdef __linux__
+#ifdef STATX_BASIC_STATS
+    unsigned mask = 0;
+    if (missing & SIZE) mask |= STATX_SIZE;
+    if (missing & MTIME) mask |= STATX_MTIME;
+    if (missing & IDENTITY) mask |= STATX_INO;
+
+    struct statx status;
+    if (::statx(AT_FDCWD, file.c_str(), 0, mask, &status) == 0) {
+        // A filesystem may leave out what it cannot provide cheaply; only keep what it returned
+        if ((missing & SIZE) && (status.stx_mask & STATX_SIZE)) {
+            size = status.stx_size;
+            fields |= SIZE;
+        }
+        if ((missing & MTIME) && (status.stx_mask & STATX_MTIME)) {
+            mtime = static_cast<int64_t>(status.stx_mtime.tv_sec) * 1000000000 + status.stx_mtime.tv_nsec;
+            fields |= MTIME;
+        }
+        if ((missing & IDENTITY) && (status.stx_mask & STATX_INO)) {
+            device = static_cast<uint64_t>(makedev(status.stx_dev_major, status.stx_dev_minor));
+            inode = status.stx_ino;
+            fields |= IDENTITY;
+        }
+        unavailable |= missing & ~fields;
+        return has(wanted);
+    }
+    if (errno != ENOSYS) {
+        failed = true;
+        return false;
+    }
+#endif
+    // Kernels before 4.11 have no statx
+    struct stat st;
+    if (::stat(file.c_str(), &st) != 0) {
+        failed = true;
+        return false;
+    }
+    fill(st);
+#else
+    std::error_code ec;
+    if (missing & SIZE) {
+        const auto fileSize = fs::file_size(file, ec);
+        if (!ec) {
+            size = static_cast<uint64_t>(fileSize);
+            fields |= SIZE;
+        }
+    }
+    if (missing & MTIME) {
+        const auto time = fs::last_write_time(file, ec);
+        if (!ec) {
+            // file_time_type has no portable epoch in C++17; convert through the current time
+            const auto system = std::chrono::system_clock::now() +
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(time - fs::file_time_type::clock::now());
+            mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(system.time_since_epoch()).count();
+            fields |= MTIME;
+        }
+    }
+    if (missing & IDENTITY) {
+        // Without inode numbers, the absolute path stands in for the file identity
+        const std::string identity = fs::absolute(file, ec).string();
+        if (!ec) {
+            inode = XxHash64::hash(identity.data(), identity.size());
+            fields |= IDENTITY;
+        }
+    }
+    unavailable |= missing & ~fields;
+#endif
+    return has(wanted);
+}
+
+#ifdef __linux__
+void FileMetadata::fill(const struct stat& st) {
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    device = static_cast<uint64_t>(st.st_dev);
+    inode = static_cast<uint64_t>(st.st_ino);
+    fields = ALL;
+}
+#endif
+
+std::string FileMetadata::mtimeYearMonth() const {
+    if (!has(MTIME)) {
+        return "";
+    }
+    // Floor the division, so times before the epoch land in the right second
+    int64_t seconds = mtime / 1000000000;
+    if (mtime % 1000000000 < 0) --seconds;
+    const std::time_t time = static_cast<std::time_t>(seconds);
+    std::tm local{};
+#ifdef _WIN32
+    if (localtime_s(&local, &time) != 0) return "";
+#else
+    if (!localtime_r(&time, &local)) return "";
+#endif
+    const int year = local.tm_year + 1900;
+    if (year < 1000 || year > 9999) {
+        return "";
+    }
+    char buffer[8];
+    std::strftime(buffer, sizeof(buffer), "%Y/%m", &local);
+    return buffer;
+}
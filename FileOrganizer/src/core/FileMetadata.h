@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#ifdef __linux__
+struct stat;
+#endif
+
+/**
+ * @struct FileMetadata
+ * @brief What a stat tells about a file, filled in lazily and only as far as needed.
+ *
+ * A scan learns the type of each entry from d_type and stats nothing, so a fresh
+ * FileInfo carries no metadata. The consumers that need some ask for the fields
+ * they need (see FileScanner::fetchMetadata), and only those are requested from
+ * the kernel: on Linux a statx with the matching mask, which spares filesystems
+ * where some attributes are costly (network and FUSE mounts) from computing the
+ * rest. Fields already known, and fields the filesystem did not return, are
+ * never fetched again, so each file is stat'ed at most once per field.
+ *
+ * Symlinks are followed, as the scanner includes symlinks to regular files.
+ */
+struct FileMetadata {
+    enum Field : unsigned {
+        SIZE = 1u << 0,       ///< `size`.
+        MTIME = 1u << 1,      ///< `mtime`.
+        IDENTITY = 1u << 2,   ///< `device` and `inode`.
+        ALL = SIZE | MTIME | IDENTITY
+    };
+
+    unsigned fields = 0;      ///< The fields filled in, as a set of Field bits.
+    unsigned unavailable = 0; ///< Fields requested from a stat that did not provide them.
+    bool failed = false;      ///< True if a stat failed (the file is gone or unreadable).
+    uint64_t size = 0;
+    int64_t mtime = 0;        ///< Nanoseconds since the Unix epoch.
+    uint64_t device = 0;
+    uint64_t inode = 0;       ///< Without inode numbers, a hash of the absolute path.
+
+    /**
+     * @brief Whether every field in `wanted` is filled in.
+     */
+    bool has(unsigned wanted) const { return (fields & wanted) == wanted; }
+
+    /**
+     * @brief Whether fetch() has nothing left to try for `wanted`: every field is
+     *        filled in or known to be unavailable, or the stat failed.
+     */
+    bool attempted(unsigned wanted) const { return failed || ((fields | unavailable) & wanted) == wanted; }
+
+    /**
+     * @brief Fills in the fields of `wanted` that are still missing, with one stat.
+     *
+     * @param file The file the metadata belongs to.
+     * @param wanted The fields needed, as a set of Field bits.
+     * @return True if every field in `wanted` is now filled in. Fields the stat
+     *         does not provide are recorded in `unavailable` and not asked again.
+     */
+    bool fetch(const std::filesystem::path& file, unsigned wanted);
+
+#ifdef __linux__
+    /**
+     * @brief Takes every field from a stat the caller already made.
+     */
+    void fill(const struct stat& st);
+#endif
+
+    /**
+     * @brief Formats `mtime` as "YYYY/MM" in local time, as for dates found in file names.
+     *
+     * @return An empty string if MTIME is not filled in.
+     */
+    std::string mtimeYearMonth() const;
+};
@@ -1,69 +1,1075 @@
 #include "FileOperator.h"
+#include "DuplicateFinder.h"
+#include "utils/Log.h"
+#include "utils/Stats.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <deque>
 #include <filesystem>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+#endif
 
 namespace fs = std::filesystem;
 
-bool FileOperator::executePlan(const Plan& plan) {
-    const auto& actions = plan.getActions();
-    if (actions.empty()) {
+namespace {
+
+static_assert(Action::DELETE_DUPLICATE + 1 == Stats::kActionTypes, "one latency histogram per action type");
+
+struct PathHash {
+    size_t operator()(const fs::path& path) const noexcept { return fs::hash_value(path); }
+};
+
+/**
+ * @brief One node of the execution graph: everything that targets one directory.
+ */
+struct DirectoryNode {
+    fs::path directory;
+    std::vector<size_t> creates;   ///< CREATE_DIR actions for this directory.
+    std::vector<size_t> entries;   ///< MOVE/RENAME actions into it, in plan order.
+    bool hasMoves = false;
+};
+
+/**
+ * @brief Whether an action belongs to the duplicate stage, which runs after all others.
+ */
+bool isDuplicateAction(Action::Type type) {
+    return type == Action::HARDLINK || type == Action::DELETE_DUPLICATE;
+}
+
+/**
+ * @brief Whether an action still has to run: it is not journaled as done.
+ */
+bool isPending(const Journal* journal, size_t index) {
+    return !journal || !journal->isDone(index);
+}
+
+int pendingCount(size_t planSize, const Journal* journal) {
+    return static_cast<int>(planSize - (journal ? journal->doneCount() : 0));
+}
+
+/**
+ * @brief Journals how many levels of each pending CREATE_DIR action's directory are
+ *        missing, and syncs that before anything is created.
+ */
+template <typename PlanType>
+void recordMissingDirectories(const PlanType& plan, Journal& journal) {
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (plan.type(i) != Action::CREATE_DIR || journal.isDone(i)) {
+            continue;
+        }
+        unsigned levels = 0;
+        std::error_code ec;
+        for (fs::path directory = plan.action(i).destination;
+             directory.has_relative_path() && !fs::exists(fs::symlink_status(directory, ec));
+             directory = directory.parent_path()) {
+            ++levels;
+        }
+        if (levels > 0) {
+            journal.recordMissingLevels(i, levels);
+        }
+    }
+    journal.flush();
+}
+
+// An io_uring request's tag: an id, and the kind of request in the low two bits
+enum RequestKind : uint64_t {
+    RENAME_REQUEST = 0,       ///< id: a rename slot.
+    DIRECTORY_REQUEST = 1,    ///< id: a directory chain; the chain's last mkdirat.
+    PARENT_REQUEST = 2,       ///< id: a parent directory; a mkdirat inside a chain.
+    STATX_REQUEST = 3         ///< id: a duplicate slot * 2 + which path.
+};
+constexpr unsigned kKindBits = 2;
+
+uint64_t requestTag(RequestKind kind, size_t id) {
+    return (static_cast<uint64_t>(id) << kKindBits) | kind;
+}
+
+template <typename PlanType>
+std::vector<DirectoryNode> buildDirectoryGraph(const PlanType& plan, const Journal* journal) {
+    std::vector<DirectoryNode> nodes;
+    std::unordered_map<fs::path, size_t, PathHash> nodeIndex;
+
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (isDuplicateAction(plan.type(i)) || !isPending(journal, i)) {
+            continue;
+        }
+        const Action action = plan.action(i);
+        const fs::path& directory = action.type == Action::CREATE_DIR
+            ? action.destination
+            : action.destination.parent_path();
+
+        auto [it, inserted] = nodeIndex.emplace(directory, nodes.size());
+        if (inserted) {
+            nodes.push_back(DirectoryNode{directory, {}, {}, false});
+        }
+        DirectoryNode& node = nodes[it->second];
+        if (action.type == Action::CREATE_DIR) {
+            node.creates.push_back(i);
+        } else {
+            node.entries.push_back(i);
+            node.hasMoves |= action.type == Action::MOVE;
+        }
+    }
+    return nodes;
+}
+
+} // namespace
+
+/**
+ * @class FileOperator::Reporter
+ * @brief Sends the progress and outcomes of one execution to its callbacks, or to the log.
+ *
+ * Each execution has its own, so concurrent executions never wait on each other.
+ */
+class FileOperator::Reporter {
+public:
+    explicit Reporter(const ExecutionCallbacks* callbacks = nullptr) : callbacks(callbacks) {}
+
+    /**
+     * @brief Whether the execution prints anything, its summary included.
+     */
+    bool printing() const { return callbacks == nullptr; }
+
+    /**
+     * @brief Whether the outcome of each action is logged, and so worth formatting.
+     */
+    bool logsActions() const { return printing() && Log::enabled(Log::INFO); }
+
+    void progress(int current, int total) {
+        // Under the lock, so the last progress published is the final one
+        std::lock_guard<std::mutex> lock(mutex);
+        if (printing()) {
+            Log::progress(current, total);
+        } else if (callbacks->progress) {
+            callbacks->progress(static_cast<size_t>(current), static_cast<size_t>(total));
+        }
+    }
+
+    void progressCount(int succeeded, int failed) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Log::progressCount(succeeded, failed);
+    }
+
+    /**
+     * @brief Reports an error; `action` is null if it is not about one action.
+     */
+    void failed(const Action* action, const std::string& message) {
+        if (printing()) {
+            Log::write(Log::ERROR, "error", "Error: " + message,
+                       action ? action->source.string() : std::string(),
+                       action ? action->destination.string() : std::string());
+        } else if (callbacks->error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            callbacks->error(action, message);
+        }
+    }
+
+    /**
+     * @brief Ends the progress line before the summary.
+     */
+    void finish() {
+        if (printing()) {
+            Log::finishProgress();
+        }
+    }
+
+private:
+    const ExecutionCallbacks* callbacks;
+    std::mutex mutex;
+};
+
+template <typename PlanType>
+bool FileOperator::executePlan(const PlanType& plan, unsigned jobs, Journal* journal, ExecutionEngine engine,
+                               const ExecutionCallbacks* callbacks) {
+    Reporter reporter(callbacks);
+    const int totalCount = pendingCount(plan.size(), journal);
+    if (totalCount == 0) {
+        if (reporter.printing()) {
+            std::cout << "Nothing to do.\n";
+        }
+        return true;
+    }
+
+    Stats::PhaseTimer timer(Stats::EXECUTE);
+    jobs = WorkStealingPool::resolveThreadCount(jobs);
+
+    IoUring ring;
+    if (engine == ExecutionEngine::IO_URING && !ring.open(kRingEntries)) {
+        if (reporter.printing()) {
+            Log::flush();
+            std::cout << "io_uring is not available (" << ring.error() << "); using "
+                      << jobs << (jobs > 1 ? " threads" : " thread") << " instead.\n";
+        }
+        engine = ExecutionEngine::THREADS;
+    }
+
+    if (reporter.printing()) {
+        std::cout << "Executing plan...\n";
+    }
+
+    if (journal) {
+        recordMissingDirectories(plan, *journal);
+    }
+    const auto start = std::chrono::steady_clock::now();
+    auto backend = ExecutionBackend::create();
+    int successCount;
+    if (engine == ExecutionEngine::IO_URING) {
+        successCount = executeUring(plan, ring, *backend, journal, reporter);
+    } else if (jobs > 1) {
+        successCount = executeParallel(plan, jobs, *backend, journal, reporter);
+    } else {
+        successCount = executeSequential(plan, *backend, journal, reporter);
+    }
+    if (journal) {
+        journal->flush();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!reporter.printing()) {
+        return successCount == totalCount;
+    }
+    reporter.finish();
+    std::cout << std::fixed << std::setprecision(2) << "Executed " << totalCount << " actions in "
+              << seconds << " s (" << std::setprecision(0) << (seconds > 0 ? totalCount / seconds : 0.0)
+              << " actions/s, ";
+    if (engine == ExecutionEngine::IO_URING) {
+        std::cout << "io_uring";
+    } else {
+        std::cout << jobs << (jobs > 1 ? " threads" : " thread");
+    }
+    std::cout << ").\n" << std::defaultfloat;
+
+    if (successCount == totalCount) {
+        std::cout << "All actions completed successfully.\n";
+    } else {
+        std::cerr << "Some actions failed. (" << (totalCount - successCount) << " errors)\n";
+    }
+
+    return successCount == totalCount;
+}
+
+size_t FileOperator::executeSlice(const Plan& plan, size_t begin, size_t end, ExecutionBackend& backend,
+                                  const ExecutionCallbacks& callbacks) {
+    Stats::PhaseTimer timer(Stats::EXECUTE);
+    Reporter reporter(&callbacks);
+    size_t successCount = 0;
+    for (size_t i = begin; i < end && i < plan.size(); ++i) {
+        if (runAction(plan, i, true, backend, nullptr, reporter)) {
+            successCount++;
+        }
+    }
+    return successCount;
+}
+
+bool FileOperator::executeStream(BoundedQueue<Action>& actions, unsigned jobs) {
+    Stats::PhaseTimer timer(Stats::EXECUTE);
+    jobs = WorkStealingPool::resolveThreadCount(jobs);
+    auto backend = ExecutionBackend::create();
+    Reporter reporter;
+    std::atomic<int> successCount{0};
+    std::atomic<int> failureCount{0};
+
+    auto work = [&] {
+        Action action(Action::MOVE, fs::path(), fs::path());
+        while (actions.pop(action)) {
+            const bool ok = executeAction(action, true, *backend, true, reporter);
+            const int succeeded = ok ? successCount.fetch_add(1) + 1 : successCount.load();
+            const int failed = ok ? failureCount.load() : failureCount.fetch_add(1) + 1;
+            reporter.progressCount(succeeded, failed);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < jobs; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    const int failed = failureCount.load();
+    reporter.finish();
+    if (successCount.load() + failed == 0) {
         std::cout << "Nothing to do.\n";
         return true;
     }
 
+    if (failed == 0) {
+        std::cout << "All actions completed successfully.\n";
+    } else {
+        std::cerr << "Some actions failed. (" << failed << " errors)\n";
+    }
+    return failed == 0;
+}
+
+bool FileOperator::undoJournal(Journal& journal) {
+    const PlanFile& plan = journal.plan();
+    const std::vector<size_t> done = journal.doneInOrder();
+    if (done.empty()) {
+        std::cout << "Nothing to undo.\n";
+        return true;
+    }
+
+    Stats::PhaseTimer timer(Stats::UNDO);
+    const int totalCount = static_cast<int>(done.size());
     int successCount = 0;
-    const int totalCount = static_cast<int>(actions.size());
-
-    std::cout << "Executing plan...\n";
-
-    for (const auto& action : actions) {
-        try {
-            switch (action.type) {
-                case Action::MOVE:
-                    // Ensure the parent directory exists before moving the file
-                    fs::create_directories(action.destination.parent_path());
-                    fs::rename(action.source, action.destination);
-                    std::cout << "Moved:   \"" << action.source.filename().string()
-                              << "\" -> \"" << action.destination.parent_path().string() << "/\"\n";
-                    break;
-                case Action::RENAME:
-                    fs::rename(action.source, action.destination);
-                    std::cout << "Renamed: \"" << action.source.filename().string()
-                              << "\" -> \"" << action.destination.filename().string() << "\"\n";
+    auto backend = ExecutionBackend::create();
+    Reporter reporter;
+    std::cout << "Undoing " << totalCount << " actions...\n";
+
+    // Only the levels of a directory that were missing before the run were made by it
+    auto removeCreatedParents = [&journal](size_t index, fs::path directory) {
+        std::error_code ec;
+        for (unsigned level = 1; level < journal.missingLevels(index); ++level) {
+            directory = directory.parent_path();
+            if (!fs::remove(directory, ec)) {
+                break;
+            }
+        }
+    };
+
+    // The stages of the run in reverse: duplicates were handled last, directories created first
+    auto stage = [](Action::Type type) {
+        return isDuplicateAction(type) ? 0 : type == Action::CREATE_DIR ? 2 : 1;
+    };
+    for (int current = 0; current < 3; ++current) {
+        for (auto it = done.rbegin(); it != done.rend(); ++it) {
+            if (stage(plan.type(*it)) != current) {
+                continue;
+            }
+            const Action action = plan.action(*it);
+            if (undoAction(action, *backend)) {
+                journal.record(*it, Journal::UNDONE);
+                successCount++;
+                if (action.type == Action::CREATE_DIR && !fs::exists(action.destination)) {
+                    removeCreatedParents(*it, action.destination);
+                }
+            }
+            reporter.progress(successCount, totalCount);
+        }
+    }
+    journal.flush();
+
+    reporter.finish();
+
+    if (successCount == totalCount) {
+        std::cout << "All actions undone successfully.\n";
+    } else {
+        std::cerr << "Some actions could not be undone. (" << (totalCount - successCount) << " errors)\n";
+    }
+    return successCount == totalCount;
+}
+
+size_t FileOperator::reconcileJournal(Journal& journal) {
+    const PlanFile& plan = journal.plan();
+    size_t found = 0;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const Action::Type type = plan.type(i);
+        if (journal.isDone(i) || (type != Action::MOVE && type != Action::RENAME &&
+                                  type != Action::DELETE_DUPLICATE)) {
+            continue;
+        }
+        const Action action = plan.action(i);
+        std::error_code ec;
+        if (!fs::exists(fs::symlink_status(action.source, ec)) &&
+            fs::exists(fs::symlink_status(action.destination, ec))) {
+            journal.record(i, Journal::DONE);
+            ++found;
+        }
+    }
+    journal.flush();
+    return found;
+}
+
+template <typename PlanType>
+int FileOperator::executeSequential(const PlanType& plan, ExecutionBackend& backend, Journal* journal,
+                                    Reporter& reporter) {
+    const int totalCount = pendingCount(plan.size(), journal);
+    int successCount = 0;
+
+    // Two stages: duplicates are only touched once every kept copy is in place
+    for (bool duplicateStage : {false, true}) {
+        for (size_t i = 0; i < plan.size(); ++i) {
+            if (isDuplicateAction(plan.type(i)) != duplicateStage || !isPending(journal, i)) {
+                continue;
+            }
+            if (runAction(plan, i, true, backend, journal, reporter)) {
+                successCount++;
+            }
+
+            // Update progress after each action attempt
+            reporter.progress(successCount, totalCount);
+        }
+    }
+    return successCount;
+}
+
+template <typename PlanType>
+int FileOperator::executeParallel(const PlanType& plan, unsigned jobs, ExecutionBackend& backend,
+                                  Journal* journal, Reporter& reporter) {
+    const int totalCount = pendingCount(plan.size(), journal);
+    std::vector<DirectoryNode> nodes = buildDirectoryGraph(plan, journal);
+
+    // Large directories are split so that one popular category cannot serialize the run
+    const size_t chunkSize = std::max<size_t>(64, plan.size() / (jobs * 8));
+    std::atomic<int> successCount{0};
+
+    auto runEntries = [&](const DirectoryNode& node, size_t begin, size_t end, bool createParent) {
+        for (size_t i = begin; i < end; ++i) {
+            const bool ok = runAction(plan, node.entries[i], createParent, backend, journal, reporter);
+            const int succeeded = ok ? successCount.fetch_add(1) + 1 : successCount.load();
+            reporter.progress(succeeded, totalCount);
+        }
+    };
+
+    WorkStealingPool pool(jobs);
+
+    auto runNode = [&](const DirectoryNode& node) {
+        // The directory must exist before anything is moved into it
+        bool directoryReady = true;
+        for (size_t index : node.creates) {
+            if (runAction(plan, index, false, backend, journal, reporter)) {
+                successCount.fetch_add(1);
+            } else {
+                directoryReady = false;
+            }
+        }
+        if (node.creates.empty() && node.hasMoves) {
+            try {
+                backend.createDirectories(node.directory);
+            } catch (const fs::filesystem_error&) {
+                directoryReady = false;
+            }
+        }
+
+        // If the directory could not be created, each MOVE retries (and reports) it,
+        // exactly as the sequential executor would
+        const bool createParent = !directoryReady;
+        for (size_t begin = chunkSize; begin < node.entries.size(); begin += chunkSize) {
+            const size_t end = std::min(begin + chunkSize, node.entries.size());
+            pool.submit([&, begin, end, createParent] { runEntries(node, begin, end, createParent); });
+        }
+        runEntries(node, 0, std::min(chunkSize, node.entries.size()), createParent);
+    };
+
+    // Start the biggest directories first so the tail of the run stays balanced
+    std::vector<const DirectoryNode*> order;
+    order.reserve(nodes.size());
+    for (const auto& node : nodes) {
+        order.push_back(&node);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const DirectoryNode* a, const DirectoryNode* b) {
+        return a->entries.size() > b->entries.size();
+    });
+    for (const DirectoryNode* node : order) {
+        pool.submit([&, node] { runNode(*node); });
+    }
+    pool.wait();
+
+    // The duplicate stage starts only after every move has finished
+    std::vector<size_t> duplicates;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (isDuplicateAction(plan.type(i)) && isPending(journal, i)) {
+            duplicates.push_back(i);
+        }
+    }
+    for (size_t begin = 0; begin < duplicates.size(); begin += chunkSize) {
+        const size_t end = std::min(begin + chunkSize, duplicates.size());
+        pool.submit([&, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                const bool ok = runAction(plan, duplicates[i], false, backend, journal, reporter);
+                const int succeeded = ok ? successCount.fetch_add(1) + 1 : successCount.load();
+                reporter.progress(succeeded, totalCount);
+            }
+        });
+    }
+    pool.wait();
+
+    return successCount.load();
+}
+
+template <typename PlanType>
+int FileOperator::executeUring(const PlanType& plan, IoUring& ring, ExecutionBackend& backend, Journal* journal,
+                               Reporter& reporter) {
+#ifdef __linux__
+    const int totalCount = pendingCount(plan.size(), journal);
+    int successCount = 0;
+    bool ringFailed = false;
+    constexpr unsigned kSubmitBatch = 256;
+
+    // The actions that succeeded or were reported, so a failed ring knows what is left
+    std::vector<bool> finished(plan.size(), false);
+    auto progress = [&] { reporter.progress(successCount, totalCount); };
+    auto succeeded = [&](size_t index) {
+        if (journal) {
+            journal->record(index, Journal::DONE);
+        }
+        finished[index] = true;
+        successCount++;
+        progress();
+    };
+    // What the ring could not do is retried with blocking calls, which report errors
+    auto runBlocking = [&](size_t index) {
+        finished[index] = true;
+        if (runAction(plan, index, true, backend, journal, reporter)) {
+            successCount++;
+        }
+        progress();
+    };
+
+    // Requests keep their paths in fixed slots until they complete; there are as many
+    // slots as the ring has entries, so a free one exists whenever the ring has room
+    struct RenameSlot {
+        size_t index = 0;
+        Action action{Action::MOVE, fs::path(), fs::path()};
+        std::chrono::steady_clock::time_point queuedAt;   ///< For the latency stats, which run to the reaping.
+    };
+    std::vector<RenameSlot> renameSlots(ring.entries());
+    std::vector<size_t> freeRenameSlots;
+    for (size_t slot = renameSlots.size(); slot-- > 0;) {
+        freeRenameSlots.push_back(slot);
+    }
+
+    struct StatSlot {
+        size_t index = 0;
+        Action action{Action::MOVE, fs::path(), fs::path()};
+        struct statx status[2];
+        int result[2] = {0, 0};
+        int remaining = 0;
+    };
+    std::vector<StatSlot> statSlots(ring.entries() / 2);
+    std::vector<size_t> freeStatSlots;
+    for (size_t slot = statSlots.size(); slot-- > 0;) {
+        freeStatSlots.push_back(slot);
+    }
+
+    // What is known about each destination directory (and the sources' directories)
+    struct DirectoryState {
+        bool ready = false;                 ///< Known to exist.
+        bool failed = false;                ///< Its mkdirat failed; moves into it run blocking.
+        std::vector<std::string> chain;     ///< The mkdirat paths in flight, outermost first.
+        std::vector<size_t> creates;        ///< CREATE_DIR actions waiting for the chain.
+        std::vector<size_t> moves;          ///< MOVE actions waiting for the chain.
+    };
+    std::unordered_map<std::string, DirectoryState> directories;
+    std::vector<DirectoryState*> chains;    ///< Indexed by the id of a DIRECTORY_REQUEST.
+    std::vector<std::string> parents;       ///< Indexed by the id of a PARENT_REQUEST.
+    std::deque<size_t> released;            ///< Moves whose directory was just confirmed.
+
+    auto markReady = [&](fs::path directory) {
+        for (; !directory.empty(); directory = directory.parent_path()) {
+            DirectoryState& state = directories[directory.string()];
+            if (state.ready) {
+                break;
+            }
+            state.ready = true;
+            if (!directory.has_relative_path()) {
+                break;
+            }
+        }
+    };
+    auto isReady = [&](const fs::path& directory) {
+        auto it = directories.find(directory.string());
+        return it != directories.end() && it->second.ready;
+    };
+
+    auto handle = [&](uint64_t tag, int result) {
+        const size_t id = static_cast<size_t>(tag >> kKindBits);
+        switch (static_cast<RequestKind>(tag & ((1u << kKindBits) - 1))) {
+            case RENAME_REQUEST: {
+                RenameSlot& slot = renameSlots[id];
+                if (result == 0) {
+                    if (Stats::enabled()) {
+                        Stats::add(Stats::RENAMES);
+                        Stats::recordLatency(slot.action.type, std::chrono::steady_clock::now() - slot.queuedAt);
+                    }
+                    printMove(slot.action, MoveResult{slot.action.destination, std::nullopt}, reporter);
+                    succeeded(slot.index);
+                } else {
+                    runBlocking(slot.index);
+                }
+                freeRenameSlots.push_back(id);
+                break;
+            }
+            case DIRECTORY_REQUEST: {
+                if (result == 0) {
+                    Stats::add(Stats::DIRECTORIES_CREATED);
+                }
+                DirectoryState& state = *chains[id];
+                const std::string directory = state.chain.back();
+                // EEXIST may also mean a file of that name; the blocking path reports it
+                const bool created = result == 0 || (result == -EEXIST && fs::is_directory(directory));
+                std::vector<size_t> creates, moves;
+                creates.swap(state.creates);
+                moves.swap(state.moves);
+                state.chain.clear();
+                if (created) {
+                    markReady(directory);
+                    for (size_t index : creates) {
+                        succeeded(index);
+                    }
+                    released.insert(released.end(), moves.begin(), moves.end());
+                } else {
+                    state.failed = true;
+                    for (size_t index : creates) {
+                        runBlocking(index);
+                    }
+                    for (size_t index : moves) {
+                        runBlocking(index);
+                    }
+                }
+                break;
+            }
+            case PARENT_REQUEST: {
+                if (result == 0) {
+                    Stats::add(Stats::DIRECTORIES_CREATED);
+                }
+                // A parent that already existed is as good as created: the links of a
+                // chain are hard links, so its EEXIST does not cancel what follows
+                const std::string& parent = parents[id];
+                if (result == 0 || (result == -EEXIST && fs::is_directory(parent))) {
+                    markReady(parent);
+                }
+                break;
+            }
+            case STATX_REQUEST: {
+                StatSlot& slot = statSlots[id / 2];
+                slot.result[id % 2] = result;
+                if (--slot.remaining > 0) {
                     break;
-                case Action::CREATE_DIR:
-                    fs::create_directories(action.destination);
-                    // We don't print every directory creation to avoid clutter,
-                    // as they are created implicitly during moves. This is for explicit creates.
-                    // std::cout << "Created: \"" << action.destination.string() << "\"\n";
+                }
+                FileIdentity identities[2];
+                for (int which = 0; which < 2; ++which) {
+                    const struct statx& status = slot.status[which];
+                    if (slot.result[which] == 0 && S_ISREG(status.stx_mode)) {
+                        identities[which].regular = true;
+                        identities[which].device = makedev(status.stx_dev_major, status.stx_dev_minor);
+                        identities[which].inode = status.stx_ino;
+                        identities[which].size = status.stx_size;
+                    }
+                }
+                if (executeAction(slot.action, false, backend, journal == nullptr, reporter, identities)) {
+                    succeeded(slot.index);
+                } else {
+                    finished[slot.index] = true;
+                    progress();
+                }
+                freeStatSlots.push_back(id / 2);
+                break;
+            }
+        }
+    };
+
+    // Submits what is queued and waits for one completion until `needed` more fit
+    auto makeRoom = [&](unsigned needed) {
+        while (!ringFailed && ring.queued() + ring.inFlight() + needed > ring.entries()) {
+            if (!ring.submit(1)) {
+                ringFailed = true;
+                break;
+            }
+            ring.reap(handle);
+        }
+        return !ringFailed;
+    };
+    auto submitBatch = [&] {
+        if (ring.queued() >= kSubmitBatch) {
+            ringFailed = !ring.submit(0);
+            ring.reap(handle);
+        }
+    };
+    auto queueRename = [&](size_t index, Action action) {
+        const size_t slot = freeRenameSlots.back();
+        freeRenameSlots.pop_back();
+        renameSlots[slot].index = index;
+        renameSlots[slot].action = std::move(action);
+        if (Stats::enabled()) {
+            renameSlots[slot].queuedAt = std::chrono::steady_clock::now();
+        }
+        // Full paths: the backend's directory descriptors are private to its blocking calls
+        const Action& queued = renameSlots[slot].action;
+        ring.renameat(AT_FDCWD, queued.source.c_str(), AT_FDCWD, queued.destination.c_str(),
+                      RENAME_NOREPLACE, requestTag(RENAME_REQUEST, slot));
+    };
+    auto releaseMoves = [&] {
+        while (!released.empty() && makeRoom(1)) {
+            queueRename(released.front(), plan.action(released.front()));
+            released.pop_front();
+        }
+    };
+
+    // Stage 1: directories, moves and renames, in plan order
+    std::string lastSourceDirectory;
+    for (size_t i = 0; i < plan.size() && !ringFailed; ++i) {
+        const Action::Type type = plan.type(i);
+        if (isDuplicateAction(type) || !isPending(journal, i)) {
+            continue;
+        }
+        releaseMoves();
+        Action action = plan.action(i);
+        if (type == Action::RENAME) {
+            if (makeRoom(1)) {
+                queueRename(i, std::move(action));
+            }
+            submitBatch();
+            continue;
+        }
+
+        fs::path directory = action.destination;
+        if (type == Action::MOVE) {
+            directory = directory.parent_path();
+            // A file is moved out of its directory, so that directory exists
+            fs::path sourceDirectory = action.source.parent_path();
+            if (sourceDirectory.native() != lastSourceDirectory) {
+                lastSourceDirectory = sourceDirectory.native();
+                markReady(std::move(sourceDirectory));
+            }
+        }
+
+        DirectoryState& state = directories[directory.string()];
+        if (!state.ready && !state.failed && state.chain.empty()) {
+            // Create the directory and its missing parents, outermost first; the first
+            // move into it runs right after, linked to the chain
+            std::vector<std::string> missing;
+            for (fs::path parent = directory; parent.has_relative_path() && !isReady(parent);
+                 parent = parent.parent_path()) {
+                missing.push_back(parent.string());
+            }
+            if (missing.empty()) {
+                state.ready = true;  // The root or the current directory
+            } else {
+                if (!makeRoom(static_cast<unsigned>(missing.size()) + 1)) {
                     break;
+                }
+                state.chain.assign(missing.rbegin(), missing.rend());
+                const size_t chainId = chains.size();
+                chains.push_back(&state);
+                for (size_t k = 0; k < state.chain.size(); ++k) {
+                    const bool last = k + 1 == state.chain.size();
+                    uint64_t tag = requestTag(DIRECTORY_REQUEST, chainId);
+                    if (!last) {
+                        tag = requestTag(PARENT_REQUEST, parents.size());
+                        parents.push_back(state.chain[k]);
+                    }
+                    ring.mkdirat(AT_FDCWD, state.chain[k].c_str(), 0777, tag, !last || type == Action::MOVE);
+                }
+                if (type == Action::MOVE) {
+                    queueRename(i, std::move(action));
+                } else {
+                    state.creates.push_back(i);
+                }
+                submitBatch();
+                continue;
             }
-            successCount++;
-        } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error: " << e.what() << "\n";
         }
 
-        // Update progress after each action attempt
-        reportProgress(successCount, totalCount);
+        if (state.failed) {
+            runBlocking(i);
+        } else if (!state.ready) {
+            (type == Action::CREATE_DIR ? state.creates : state.moves).push_back(i);
+        } else if (type == Action::CREATE_DIR) {
+            succeeded(i);
+        } else if (makeRoom(1)) {
+            queueRename(i, std::move(action));
+        }
+        submitBatch();
     }
 
-    std::cout << "\n"; // Newline after the progress bar
+    // Stage 2 starts only when every move has completed
+    while (!ringFailed && (ring.queued() + ring.inFlight() > 0 || !released.empty())) {
+        releaseMoves();
+        if (ring.queued() + ring.inFlight() > 0) {
+            ringFailed = !ring.submit(1);
+            ring.reap(handle);
+        }
+    }
 
-    if (successCount == totalCount) {
-        std::cout << "All actions completed successfully.\n";
+    for (size_t i = 0; i < plan.size() && !ringFailed; ++i) {
+        if (!isDuplicateAction(plan.type(i)) || !isPending(journal, i) || !makeRoom(2)) {
+            continue;
+        }
+        const size_t slot = freeStatSlots.back();
+        freeStatSlots.pop_back();
+        StatSlot& statSlot = statSlots[slot];
+        statSlot.index = i;
+        statSlot.action = plan.action(i);
+        statSlot.remaining = 2;
+        const unsigned mask = STATX_TYPE | STATX_INO | STATX_SIZE;
+        ring.statx(AT_FDCWD, statSlot.action.source.c_str(), AT_SYMLINK_NOFOLLOW, mask,
+                   &statSlot.status[0], requestTag(STATX_REQUEST, slot * 2));
+        ring.statx(AT_FDCWD, statSlot.action.destination.c_str(), AT_SYMLINK_NOFOLLOW, mask,
+                   &statSlot.status[1], requestTag(STATX_REQUEST, slot * 2 + 1));
+        submitBatch();
+    }
+    while (!ringFailed && ring.queued() + ring.inFlight() > 0) {
+        ringFailed = !ring.submit(1);
+        ring.reap(handle);
+    }
+
+    if (ringFailed) {
+        reporter.failed(nullptr, ring.error() + "; running the remaining actions with blocking calls.");
+        // The requests the kernel accepted still complete. io_uring_enter is what failed,
+        // so wait for them by polling the completion queue.
+        while (ring.inFlight() > 0) {
+            if (ring.reap(handle) == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        // Then everything else, in the order of the blocking path: moves before duplicates
+        for (const bool duplicates : {false, true}) {
+            for (size_t i = 0; i < plan.size(); ++i) {
+                if (!finished[i] && isDuplicateAction(plan.type(i)) == duplicates && isPending(journal, i)) {
+                    runBlocking(i);
+                }
+            }
+        }
+    }
+    return successCount;
+#else
+    (void)ring;
+    return executeSequential(plan, backend, journal, reporter);
+#endif
+}
+
+template <typename PlanType>
+bool FileOperator::runAction(const PlanType& plan, size_t index, bool createParent,
+                             ExecutionBackend& backend, Journal* journal, Reporter& reporter) {
+    // A journaled file must end up exactly where the journal's plan says
+    const bool ok = executeAction(plan.action(index), createParent, backend, journal == nullptr, reporter);
+    if (ok && journal) {
+        journal->record(index, Journal::DONE);
+    }
+    return ok;
+}
+
+// The plan representations the executor is built for
+template bool FileOperator::executePlan<Plan>(const Plan& plan, unsigned jobs, Journal* journal,
+                                              ExecutionEngine engine, const ExecutionCallbacks* callbacks);
+template bool FileOperator::executePlan<PlanFile>(const PlanFile& plan, unsigned jobs, Journal* journal,
+                                                  ExecutionEngine engine, const ExecutionCallbacks* callbacks);
+
+bool FileOperator::executeAction(const Action& action, bool createParent, ExecutionBackend& backend,
+                                 bool findFreeName, Reporter& reporter, const FileIdentity* identities) {
+    Stats::ActionTimer timer(action.type);
+    try {
+        switch (action.type) {
+            case Action::MOVE:
+                // The backend creates the parent directory if it is missing
+                printMove(action, backend.move(action.source, action.destination, createParent, findFreeName),
+                          reporter);
+                break;
+            case Action::RENAME:
+                printMove(action, backend.move(action.source, action.destination, false, findFreeName), reporter);
+                break;
+            case Action::CREATE_DIR:
+                backend.createDirectories(action.destination);
+                // We don't print every directory creation to avoid clutter,
+                // as they are created implicitly during moves. This is for explicit creates.
+                // std::cout << "Created: \"" << action.destination.string() << "\"\n";
+                break;
+            case Action::HARDLINK: {
+                const FileIdentity kept = identities ? identities[0] : FileIdentity::of(action.source);
+                const FileIdentity duplicate = identities ? identities[1] : FileIdentity::of(action.destination);
+                if (!verifyDuplicate(action.destination, duplicate, action.source, kept)) {
+                    break;  // Already linked
+                }
+                // Link under a temporary name first, so the copy is never missing
+                const fs::path temporary = action.destination.parent_path() /
+                    ("." + action.destination.filename().string() + ".fo-link");
+                fs::create_hard_link(action.source, temporary);
+                std::error_code ec;
+                fs::rename(temporary, action.destination, ec);
+                if (ec) {
+                    fs::remove(temporary);
+                    throw fs::filesystem_error("cannot replace duplicate", temporary, action.destination, ec);
+                }
+                Stats::add(Stats::LINKS_CREATED);
+                if (reporter.logsActions()) {
+                    Log::write(Log::INFO, "linked",
+                               "Linked:  \"" + action.destination.string() + "\" -> \"" + action.source.string() + "\"",
+                               action.destination.string(), action.source.string());
+                }
+                break;
+            }
+            case Action::DELETE_DUPLICATE: {
+                const FileIdentity duplicate = identities ? identities[0] : FileIdentity::of(action.source);
+                const FileIdentity kept = identities ? identities[1] : FileIdentity::of(action.destination);
+                if (!verifyDuplicate(action.source, duplicate, action.destination, kept)) {
+                    break;  // Both names lead to the one remaining copy
+                }
+                fs::remove(action.source);
+                Stats::add(Stats::FILES_DELETED);
+                if (reporter.logsActions()) {
+                    Log::write(Log::INFO, "deleted",
+                               "Deleted: \"" + action.source.string() + "\" (duplicate of \"" +
+                                   action.destination.string() + "\")",
+                               action.source.string(), action.destination.string());
+                }
+                break;
+            }
+        }
+        return true;
+    } catch (const fs::filesystem_error& e) {
+        Stats::add(Stats::ERRORS);
+        reporter.failed(&action, e.what());
+        return false;
+    }
+}
+
+void FileOperator::printMove(const Action& action, const MoveResult& moved, const Reporter& reporter) {
+    if (!reporter.logsActions()) {
+        return;
+    }
+    std::string line;
+    if (action.type == Action::RENAME) {
+        line = "Renamed: \"" + action.source.filename().string() + "\" -> \"" +
+               moved.destination.filename().string() + "\"";
     } else {
-        std::cerr << "Some actions failed. (" << (totalCount - successCount) << " errors)\n";
+        line = "Moved:   \"" + action.source.filename().string() + "\" -> \"" +
+               action.destination.parent_path().string() + "/\"";
+        if (moved.destination != action.destination) {
+            line += " as \"" + moved.destination.filename().string() + "\"";
+        }
     }
+    if (moved.transfer) {
+        line += describeTransfer(*moved.transfer);
+    }
+    Log::write(Log::INFO, action.type == Action::RENAME ? "renamed" : "moved", std::move(line),
+               action.source.string(), moved.destination.string());
+}
 
-    return successCount == totalCount;
+bool FileOperator::undoAction(const Action& action, ExecutionBackend& backend) {
+    try {
+        switch (action.type) {
+            case Action::MOVE:
+            case Action::RENAME: {
+                // Fails rather than overwrite a file that took the original name since
+                const MoveResult moved = backend.move(action.destination, action.source, true, false);
+                Log::write(Log::INFO, "restored",
+                           "Restored: \"" + action.source.string() + "\"" +
+                               (moved.transfer ? describeTransfer(*moved.transfer) : ""),
+                           action.destination.string(), action.source.string());
+                break;
+            }
+            case Action::CREATE_DIR: {
+                // Only an empty directory goes; anything else in it was not ours to move
+                std::error_code ec;
+                fs::remove(action.destination, ec);
+                break;
+            }
+            case Action::HARDLINK: {
+                if (!fs::equivalent(action.destination, action.source)) {
+                    break;  // Already a separate file
+                }
+                // Give the duplicate its own copy again, without a moment where it is missing
+                const fs::path temporary = action.destination.parent_path() /
+                    ("." + action.destination.filename().string() + ".fo-link");
+                fs::copy_file(action.source, temporary, fs::copy_options::overwrite_existing);
+                std::error_code ec;
+                fs::rename(temporary, action.destination, ec);
+                if (ec) {
+                    fs::remove(temporary);
+                    throw fs::filesystem_error("cannot restore duplicate", temporary, action.destination, ec);
+                }
+                Log::write(Log::INFO, "unlinked", "Unlinked: \"" + action.destination.string() + "\"",
+                           action.destination.string());
+                break;
+            }
+            case Action::DELETE_DUPLICATE: {
+                if (fs::exists(fs::symlink_status(action.source))) {
+                    break;  // Never deleted
+                }
+                fs::copy_file(action.destination, action.source);
+                Log::write(Log::INFO, "restored",
+                           "Restored: \"" + action.source.string() + "\" (copy of \"" +
+                               action.destination.string() + "\")",
+                           action.destination.string(), action.source.string());
+                break;
+            }
+        }
+        return true;
+    } catch (const fs::filesystem_error& e) {
+        Stats::add(Stats::ERRORS);
+        Log::write(Log::ERROR, "error", std::string("Error: ") + e.what(),
+                   action.destination.string(), action.source.string());
+        return false;
+    }
+}
+
+FileOperator::FileIdentity FileOperator::FileIdentity::of(const fs::path& file) {
+    FileIdentity identity;
+#ifdef __linux__
+    struct stat st;
+    if (::lstat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        identity.regular = true;
+        identity.device = static_cast<uint64_t>(st.st_dev);
+        identity.inode = static_cast<uint64_t>(st.st_ino);
+        identity.size = static_cast<uint64_t>(st.st_size);
+    }
+#else
+    std::error_code ec;
+    if (fs::is_regular_file(fs::symlink_status(file, ec))) {
+        identity.regular = true;
+        identity.size = static_cast<uint64_t>(fs::file_size(file, ec));
+    }
+#endif
+    return identity;
 }
 
-void FileOperator::reportProgress(int current, int total) {
-    // Calculate percentage
-    int percentage = (total > 0) ? (current * 100 / total) : 100;
+bool FileOperator::verifyDuplicate(const fs::path& duplicate, const FileIdentity& duplicateIdentity,
+                                   const fs::path& kept, const FileIdentity& keptIdentity) {
+    if (!keptIdentity.regular) {
+        throw fs::filesystem_error("kept copy is missing, not touching duplicate", duplicate, kept,
+                                   std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    if (!duplicateIdentity.regular) {
+        throw fs::filesystem_error("duplicate is not a regular file", duplicate,
+                                   std::make_error_code(std::errc::invalid_argument));
+    }
+    const bool sameFile = keptIdentity.inode != 0
+        ? duplicateIdentity.device == keptIdentity.device && duplicateIdentity.inode == keptIdentity.inode
+        : fs::equivalent(duplicate, kept);
+    if (sameFile) {
+        return false;
+    }
+    if (duplicateIdentity.size != keptIdentity.size) {
+        throw fs::filesystem_error("duplicate changed since planning", duplicate, kept,
+                                   std::make_error_code(std::errc::file_exists));
+    }
+    // The size alone misses an edit that keeps it; compare right before anything is destroyed
+    if (!DuplicateFinder::identical(duplicate, kept, keptIdentity.size)) {
+        throw fs::filesystem_error("duplicate differs from the kept copy or cannot be read", duplicate, kept,
+                                   std::make_error_code(std::errc::file_exists));
+    }
+    return true;
+}
 
-    // Print progress on a single line
-    std::cout << "\rProgress: " << current << "/" << total 
-              << " (" << percentage << "%)          " << std::flush;
+std::string FileOperator::describeTransfer(const TransferResult& transfer) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << " (cross-device, " << transfer.methodName();
+    if (transfer.streams > 1) {
+        oss << " x" << transfer.streams;
+    }
+    oss << ", " << static_cast<double>(transfer.bytes) / 1e6 << " MB at "
+        << transfer.megabytesPerSecond() << " MB/s)";
+    return oss.str();
 }
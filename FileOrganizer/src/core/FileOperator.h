@@ -1,14 +1,45 @@
 #pragma once
 
+#include "ExecutionBackend.h"
+#include "FileTransfer.h"
 #include "Plan.h"
+#include "Journal.h"
+#include "PlanFile.h"
+#include "utils/BoundedQueue.h"
+#include "utils/IoUring.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
 #include <string>
 
+/**
+ * @brief How FileOperator::executePlan performs the filesystem calls.
+ */
+enum class ExecutionEngine {
+    THREADS,    ///< Blocking system calls on a pool of --jobs threads.
+    IO_URING    ///< Batches of asynchronous requests on an io_uring, from one thread.
+};
+
+/**
+ * @brief Receives the progress and the errors of an execution instead of the console.
+ *
+ * Called from the executor threads, one call at a time per execution. Either
+ * function may be left empty.
+ */
+struct ExecutionCallbacks {
+    /// The actions attempted so far and the number to run.
+    std::function<void(size_t done, size_t total)> progress;
+    /// A failed action, or nullptr for an error that ends the run, and what went wrong.
+    std::function<void(const Action* action, const std::string& message)> error;
+};
+
 /**
  * @class FileOperator
  * @brief Executes the actions defined in a Plan.
  *
  * This class is responsible for the "Execution Phase". It takes a finalized Plan
- * and performs the file system operations (move, rename, create directory).
+ * and performs the file system operations (move, rename, create directory, and
+ * replacing duplicates by hard links or deleting them).
  * It handles errors gracefully and provides progress feedback to the user.
  * All methods are static as this class is stateless.
  */
@@ -17,21 +48,216 @@ public:
     /**
      * @brief Executes all actions within a given Plan.
      *
-     * This method iterates through the actions in the plan and performs them
-     * sequentially. It will create parent directories as needed before moving
-     * files. It reports progress and handles any filesystem errors that occur.
+     * With a single job, this method iterates through the actions in the plan and
+     * performs them sequentially. It will create parent directories as needed before
+     * moving files. It reports progress and handles any filesystem errors that occur.
+     *
+     * Files are never moved over existing ones (see ExecutionBackend). A destination
+     * taken since planning gets the next free "(N)" name, except with a journal,
+     * which must find every file where the plan put it; the action then fails.
      *
+     * With more than one job, the actions are grouped by destination directory and
+     * run on a thread pool (see executeParallel). The io_uring engine ignores `jobs`
+     * (see executeUring); where io_uring is unavailable it falls back to the threads.
+     *
+     * With a journal, actions it records as done are skipped, and every action that
+     * succeeds is recorded, so an interrupted run can be resumed. The directories
+     * the run is about to create are journaled first, for undo.
+     *
+     * @tparam PlanType Plan, or PlanFile to run a saved plan straight from its mapping.
      * @param plan The Plan object containing all actions to be executed.
+     * @param jobs The number of worker threads; 1 runs sequentially, 0 uses one per hardware thread.
+     * @param journal The journal of `plan`, or nullptr to run without one.
+     * @param engine How to perform the filesystem calls.
+     * @param callbacks If not null, the progress and errors go there and nothing is
+     *        printed; otherwise every action is logged (see Log).
      * @return True if all actions were executed successfully, false otherwise.
      */
-    static bool executePlan(const Plan& plan);
+    template <typename PlanType>
+    static bool executePlan(const PlanType& plan, unsigned jobs = 1, Journal* journal = nullptr,
+                            ExecutionEngine engine = ExecutionEngine::THREADS,
+                            const ExecutionCallbacks* callbacks = nullptr);
+
+    /**
+     * @brief Runs actions [begin, end) of a plan in order, on the calling thread.
+     *
+     * For callers that interleave the execution of several plans (see BatchOrganizer).
+     * Running the slices of a plan one after another does what a sequential
+     * executePlan() would, as long as the duplicate actions come last, as they do in
+     * the plans FileOrganizer builds. Nothing is printed and no progress is reported.
+     *
+     * @param backend The backend of this plan's execution, kept from slice to slice.
+     * @param callbacks Receives the actions that failed.
+     * @return The number of actions that succeeded.
+     */
+    static size_t executeSlice(const Plan& plan, size_t begin, size_t end, ExecutionBackend& backend,
+                               const ExecutionCallbacks& callbacks);
+
+    /**
+     * @brief Executes actions as they arrive on a queue, until it is closed.
+     *
+     * For plans that are built while they run: `jobs` threads take actions off the
+     * queue in arrival order, and every MOVE creates its destination directory as
+     * needed, since the CREATE_DIR action for it may still be running on another
+     * thread. The queue must not carry duplicate actions, which need a finished plan.
+     *
+     * @param actions The queue the planner pushes actions to.
+     * @param jobs The number of worker threads; 0 uses one per hardware thread.
+     * @return True if all actions were executed successfully, false otherwise.
+     */
+    static bool executeStream(BoundedQueue<Action>& actions, unsigned jobs = 1);
+
+    /**
+     * @brief Reverts the actions a journal records as done, newest first.
+     *
+     * Duplicate actions are reverted first (a deleted or linked duplicate is restored
+     * as a copy of the kept file), then moves and renames, then directory creations;
+     * a created directory is only removed if it is empty, and so are the parents
+     * the run created for it (see Journal::missingLevels), never one that existed. Each reverted action is
+     * journaled as undone, so an interrupted undo can simply be run again.
+     *
+     * @param journal The journal of the run to revert.
+     * @return True if every action was reverted, false otherwise.
+     */
+    static bool undoJournal(Journal& journal);
+
+    /**
+     * @brief Journals the pending actions that already took effect as done.
+     *
+     * After a crash, the records of the last group commit may be missing. A move
+     * whose source is gone and whose destination exists, or a deleted duplicate
+     * whose kept copy exists, happened anyway and must not be repeated. Every other
+     * action is safe to run again.
+     *
+     * @return The number of actions found done.
+     */
+    static size_t reconcileJournal(Journal& journal);
 
 private:
+    /// The size of the io_uring submission queue, and so the most requests in flight.
+    static constexpr unsigned kRingEntries = 4096;
+
+    /// Where one execution reports to: its callbacks, or the log (defined in FileOperator.cpp).
+    class Reporter;
+
+    /**
+     * @struct FileIdentity
+     * @brief What the duplicate checks need to know about a path, from one lstat.
+     */
+    struct FileIdentity {
+        bool regular = false;    ///< The path is a regular file (a symlink is not followed).
+        uint64_t device = 0;
+        uint64_t inode = 0;      ///< 0 where the platform has no inode numbers.
+        uint64_t size = 0;
+
+        static FileIdentity of(const std::filesystem::path& file);
+    };
+
+    /**
+     * @brief Runs the actions in plan order on the calling thread.
+     *
+     * @return The number of actions that succeeded.
+     */
+    template <typename PlanType>
+    static int executeSequential(const PlanType& plan, ExecutionBackend& backend, Journal* journal,
+                                 Reporter& reporter);
+
     /**
-     * @brief Reports the progress of the execution to the console.
+     * @brief Runs the actions on a pool of `jobs` threads.
+     *
+     * The plan is turned into a dependency graph with one node per destination
+     * directory. A node first runs the CREATE_DIR actions for its directory (or
+     * creates it implicitly if the plan has none), and only then releases the
+     * MOVE/RENAME actions into that directory, split into chunks that other workers
+     * can steal. Keeping the work for one directory together limits contention on
+     * the kernel's per-directory lock, while different directories proceed in parallel.
      *
-     * @param current The number of actions completed so far.
-     * @param total The total number of actions in the plan.
+     * @return The number of actions that succeeded.
+     */
+    template <typename PlanType>
+    static int executeParallel(const PlanType& plan, unsigned jobs, ExecutionBackend& backend, Journal* journal,
+                               Reporter& reporter);
+
+    /**
+     * @brief Runs the actions as batches of io_uring requests, from the calling thread.
+     *
+     * MOVE and RENAME actions become renameat requests with RENAME_NOREPLACE. Requests
+     * name their files by full path (AT_FDCWD), not relative to the backend's cached
+     * directory descriptors, which the ring cannot share. The first move into a
+     * directory not known to exist is queued behind mkdirat requests for the
+     * directory and its parents not known to exist, hard-linked so that they run in
+     * order whatever their results: a parent that turns out to exist fails with EEXIST,
+     * which counts as created and does not cancel the rest of the chain. Later moves
+     * into the directory wait until it is confirmed. The duplicate stage starts
+     * once every move has completed, with the two lstat-like checks of each duplicate
+     * issued as statx requests. Requests are submitted in batches and completions are
+     * reaped as they arrive, while new requests are still being queued.
+     *
+     * Whatever the ring cannot finish on its own (a taken destination, a cross-device
+     * move, any error) is handed to the blocking path, which also reports errors. If
+     * the ring itself fails, the requests already accepted are left to complete and
+     * every action not done yet runs on the blocking path, in plan order.
+     *
+     * @return The number of actions that succeeded.
+     */
+    template <typename PlanType>
+    static int executeUring(const PlanType& plan, IoUring& ring, ExecutionBackend& backend, Journal* journal,
+                            Reporter& reporter);
+
+    /**
+     * @brief Performs one action of a plan and journals it if it succeeded.
+     *
+     * @return True if the action succeeded.
+     */
+    template <typename PlanType>
+    static bool runAction(const PlanType& plan, size_t index, bool createParent,
+                          ExecutionBackend& backend, Journal* journal, Reporter& reporter);
+
+    /**
+     * @brief Performs a single action and reports its outcome.
+     *
+     * Safe to call from several threads at once.
+     *
+     * @param action The action to perform.
+     * @param createParent If true, a MOVE first creates its destination directory.
+     * @param backend The backend that performs moves and directory creations.
+     * @param findFreeName If true, a move whose destination is taken picks a free name.
+     * @param reporter Where the outcome goes.
+     * @param identities For duplicate actions, the identities of the source and the
+     *        destination if they are already known; otherwise they are looked up.
+     * @return True if the action succeeded.
+     */
+    static bool executeAction(const Action& action, bool createParent, ExecutionBackend& backend,
+                              bool findFreeName, Reporter& reporter, const FileIdentity* identities = nullptr);
+
+    /**
+     * @brief Logs the outcome of a successful MOVE or RENAME, unless the run has callbacks.
+     */
+    static void printMove(const Action& action, const MoveResult& moved, const Reporter& reporter);
+
+    /**
+     * @brief Reverts a single action and logs its outcome.
+     *
+     * @return True if the action was reverted (or needed nothing).
+     */
+    static bool undoAction(const Action& action, ExecutionBackend& backend);
+
+    /**
+     * @brief Checks that a duplicate can safely be removed in favor of the kept copy.
+     *
+     * The kept copy must exist as a regular file at its final place, and both files
+     * must still be byte for byte identical. This guards against deleting the last
+     * copy when the move of the kept file failed, or against a file edited after
+     * planning. The sizes are compared first, so most edits are caught without a read.
+     *
+     * @return False if both paths already are the same file (nothing to do).
+     * @throws std::filesystem::filesystem_error If the duplicate must not be touched.
+     */
+    static bool verifyDuplicate(const std::filesystem::path& duplicate, const FileIdentity& duplicateIdentity,
+                                const std::filesystem::path& kept, const FileIdentity& keptIdentity);
+
+    /**
+     * @brief Formats the method and throughput of a cross-device transfer for the log.
      */
-    static void reportProgress(int current, int total);
+    static std::string describeTransfer(const TransferResult& transfer);
 };
@@ -1,181 +1,817 @@
 #include "FileOrganizer.h"
-#include "PatternMatcher.h"
+#include "BatchOrganizer.h"
+#include "ContentSniffer.h"
+#include "DirectoryWatcher.h"
 #include "FileOperator.h"
+#include "MetadataDate.h"
+#include "PlanFile.h"
+#include "WatchQueue.h"
+#include "utils/AtomicFile.h"
+#include "utils/BoundedQueue.h"
+#include "utils/Log.h"
 #include "utils/ProgressReporter.h"
+#include "utils/Stats.h"
+#include "utils/WorkStealingPool.h"
+#include "utils/XxHash64.h"
+#include <csignal>
+#include <exception>
+#include <fstream>
 #include <iostream>
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
 
 namespace fs = std::filesystem;
 
-FileOrganizer::FileOrganizer(const CommandLineArgs& args) 
-    : args(args), workingDirectory(fs::current_path()) {
+namespace {
+
+// Files or actions in flight between two streaming stages; small enough to stay in cache
+constexpr size_t kStreamQueueCapacity = 1024;
+
+// Set by SIGINT/SIGTERM to end watchFiles() between batches
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+} // namespace
+
+FileOrganizer::FileOrganizer(const CommandLineArgs& args, fs::path root, bool printing)
+    : args(args), workingDirectory(std::move(root)), printing(printing) {
+    if (!args.typesFile.empty()) {
+        fileTypes.loadRules(args.typesFile);
+    }
+    if (!args.keywordsFile.empty()) {
+        keywords.loadRules(args.keywordsFile);
+    }
 }
 
-void FileOrganizer::organizeFiles() {
+bool FileOrganizer::organizeFiles() {
     std::cout << "Phase 1: Planning...\n";
 
-    auto files = FileScanner::scanDirectory(workingDirectory);
+    auto files = scanFiles();
     if (files.empty()) {
         std::cout << "No files found to organize in the current directory.\n";
-        return;
+        return true;
     }
     std::cout << "Found " << files.size() << " files to process.\n";
 
+    return organize(files, true);
+}
+
+FileOrganizer FileOrganizer::rootedAt(fs::path root) const {
+    FileOrganizer organizer(*this);
+    organizer.workingDirectory = std::move(root);
+    return organizer;
+}
+
+Plan FileOrganizer::planOrganization(const FileScanner::ErrorHandler& onError, unsigned scanThreads) {
+    std::error_code ec;
+    if (!fs::is_directory(workingDirectory, ec)) {
+        throw fs::filesystem_error("cannot organize", workingDirectory,
+                                   ec ? ec : std::make_error_code(std::errc::not_a_directory));
+    }
+    auto files = scanFiles(onError, scanThreads);
+    return buildPlan(files, true);
+}
+
+bool FileOrganizer::organize(std::vector<FileInfo>& files, bool completeScan) {
+    const Plan plan = buildPlan(files, completeScan);
+    std::cout << "Plan created with " << plan.count(Action::MOVE) << " moves and " 
+              << plan.count(Action::CREATE_DIR) << " directories to create.\n";
+    if (args.dedupe == DedupeMode::DELETE) {
+        std::cout << "Duplicates to delete: " << plan.count(Action::DELETE_DUPLICATE) << ".\n";
+    } else if (args.dedupe == DedupeMode::LINK) {
+        std::cout << "Duplicates to replace with hard links: " << plan.count(Action::HARDLINK) << ".\n";
+    }
+
+    return finishPlan(plan);
+}
+
+Plan FileOrganizer::buildPlan(std::vector<FileInfo>& files, bool completeScan) {
+    classifyFiles(files, completeScan);
+
+    DuplicateReport duplicates;
+    std::vector<char> isDuplicate(files.size(), 0);
+    if (args.dedupe != DedupeMode::OFF) {
+        duplicates = findDuplicates(files);
+        for (const auto& group : duplicates.groups) {
+            for (size_t index : group.duplicates) {
+                isDuplicate[index] = 1;
+            }
+        }
+    }
+
+    Stats::PhaseTimer planTimer(Stats::PLAN);
     Plan plan;
+    NamespaceIndex names;
     std::set<fs::path> plannedDirs;
+    std::vector<fs::path> finalPaths(files.size());  // Where each file is after the moves
 
-    for (auto& file : files) {
-        std::string targetDirName;
-        if (!file.detectedDate.empty()) {
-            targetDirName = file.detectedDate;
-        } else {
-            std::string keyword = PatternMatcher::detectKeyword(file.name);
-            if (!keyword.empty()) {
-                targetDirName = keyword;
+    for (size_t i = 0; i < files.size(); ++i) {
+        auto& file = files[i];
+        finalPaths[i] = file.path;
+        if (isDuplicate[i] && args.dedupe == DedupeMode::DELETE) {
+            continue;
+        }
+
+        finalPaths[i] = planMove(file, names, plannedDirs,
+                                 [&plan](const Action& action) { plan.addAction(action); });
+    }
+
+    // Duplicates are handled once the kept copies have reached their final places
+    for (const auto& group : duplicates.groups) {
+        const fs::path& kept = finalPaths[group.canonical];
+        for (size_t index : group.duplicates) {
+            if (args.dedupe == DedupeMode::DELETE) {
+                plan.addAction(Action(Action::DELETE_DUPLICATE, files[index].path, kept));
             } else {
-                targetDirName = PatternMatcher::getFileType(file.ext);
+                plan.addAction(Action(Action::HARDLINK, kept, finalPaths[index]));
             }
         }
-        file.targetDir = targetDirName;
+    }
+
+    return plan;
+}
 
-        fs::path targetDirPath = workingDirectory / targetDirName;
-        if (plannedDirs.find(targetDirPath) == plannedDirs.end()) {
-            plan.addAction(Action(Action::CREATE_DIR, "", targetDirPath));
-            plannedDirs.insert(targetDirPath);
+bool FileOrganizer::finishPlan(const Plan& plan) {
+    if (args.dryRun) {
+        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
+        plan.printPlan();
+    }
+    if (!args.savePlanFile.empty()) {
+        try {
+            PlanFile::save(plan, args.savePlanFile);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return false;
         }
+        std::cout << "Plan saved to " << args.savePlanFile << "; run it with --apply-plan "
+                  << args.savePlanFile << ".\n";
+        return true;
+    }
+    if (args.dryRun) {
+        return true;
+    }
+    return executePlan(plan);
+}
 
-        fs::path targetFilePath = targetDirPath / file.path.filename();
+template <typename PlanType>
+bool FileOrganizer::executePlan(const PlanType& plan) {
+    std::cout << "\nPhase 2: Execution...\n";
+    if (args.journalFile.empty()) {
+        return FileOperator::executePlan(plan, args.jobs, nullptr, executionEngine());
+    }
 
-        targetFilePath = resolveConflict(targetFilePath);
+    // The journaled plan runs from the journal's own copy, exactly as a resume would
+    Journal journal;
+    try {
+        journal.create(args.journalFile, plan);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+    std::cout << "Journal: " << args.journalFile << " (revert with --undo " << args.journalFile << ").\n";
+    return FileOperator::executePlan(journal.plan(), args.jobs, &journal, executionEngine());
+}
 
-        plan.addAction(Action(Action::MOVE, file.path, targetFilePath));
+ExecutionEngine FileOrganizer::executionEngine() const {
+    return args.ioUring ? ExecutionEngine::IO_URING : ExecutionEngine::THREADS;
+}
+
+bool FileOrganizer::openJournal(const fs::path& journalFile, Journal& journal) const {
+    try {
+        journal.open(journalFile);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+    std::cout << "Journal " << journalFile << ": " << journal.doneCount() << " of "
+              << journal.plan().size() << " actions done";
+    if (journal.undoneCount() > 0) {
+        std::cout << ", " << journal.undoneCount() << " undone";
     }
+    std::cout << ".\n";
+    return true;
+}
 
-    auto summary = plan.getSummary();
-    std::cout << "Plan created with " << summary["moves"] << " moves and " 
-              << summary["created_dirs"] << " directories to create.\n";
+bool FileOrganizer::resumeJournal(const fs::path& journalFile) {
+    Journal journal;
+    if (!openJournal(journalFile, journal)) {
+        return false;
+    }
+    if (journal.undoneCount() > 0) {
+        std::cerr << "Error: This run was undone; plan it again instead of resuming it.\n";
+        return false;
+    }
 
+    const size_t reconciled = FileOperator::reconcileJournal(journal);
+    if (reconciled > 0) {
+        std::cout << reconciled << " more actions had already taken effect.\n";
+    }
+
+    const PlanFile& plan = journal.plan();
     if (args.dryRun) {
         std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
-        plan.printPlan();
-        return;
+        std::cout << "=== Remaining Actions ===\n";
+        for (size_t i = 0; i < plan.size(); ++i) {
+            if (!journal.isDone(i)) {
+                Plan::printAction(plan.action(i));
+            }
+        }
+        Log::flush();
+        std::cout << "========================\n";
+        return true;
     }
 
     std::cout << "\nPhase 2: Execution...\n";
-    FileOperator::executePlan(plan);
+    return FileOperator::executePlan(plan, args.jobs, &journal, executionEngine());
+}
+
+bool FileOrganizer::undoJournal(const fs::path& journalFile) {
+    Journal journal;
+    if (!openJournal(journalFile, journal)) {
+        return false;
+    }
+    if (args.dryRun) {
+        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
+        std::cout << journal.doneCount() << " actions would be undone.\n";
+        return true;
+    }
+    return FileOperator::undoJournal(journal);
+}
+
+bool FileOrganizer::organizeBatch(const std::string& listFile) {
+    std::vector<fs::path> roots;
+    if (listFile == "-") {
+        roots = BatchOrganizer::readRoots(std::cin);
+    } else {
+        std::ifstream in(listFile);
+        if (!in) {
+            std::cerr << "Error: Cannot read the list of roots " << listFile << ".\n";
+            return false;
+        }
+        roots = BatchOrganizer::readRoots(in);
+    }
+    if (roots.empty()) {
+        std::cout << "No roots to organize.\n";
+        return true;
+    }
+
+    OrganizerOptions options;
+    options.recursive = args.recursive;
+    options.sniff = args.sniff;
+    options.metadataDates = args.metadataDates;
+    options.byMtime = args.byMtime;
+    options.dedupe = args.dedupe;
+    options.typesFile = args.typesFile;
+    options.keywordsFile = args.keywordsFile;
+    const BatchOrganizer batch(options, args.jobs, args.dryRun);
+
+    const unsigned threads = WorkStealingPool::resolveThreadCount(args.jobs);
+    std::cout << "Organizing " << roots.size() << " roots on " << threads
+              << (threads > 1 ? " threads" : " thread") << "...\n";
+    if (args.dryRun) {
+        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
+    }
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<RootSummary> summaries;
+    try {
+        summaries = batch.run(roots);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+    Log::finishProgress();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    RootSummary total;
+    size_t failedRoots = 0;
+    for (const RootSummary& summary : summaries) {
+        total.moves += summary.moves;
+        total.directories += summary.directories;
+        total.duplicates += summary.duplicates;
+        total.failed += summary.failed;
+        if (!summary.planned || summary.failed > 0 || summary.errors > 0) {
+            ++failedRoots;
+        }
+    }
+    std::cout << std::fixed << std::setprecision(2) << "Organized " << summaries.size() << " roots in "
+              << seconds << " s: " << (args.dryRun ? "would make " : "") << total.moves << " moves, "
+              << total.directories << " directories";
+    if (total.duplicates > 0) {
+        std::cout << ", " << total.duplicates << " duplicates";
+    }
+    std::cout << ".\n" << std::defaultfloat;
+    if (failedRoots > 0) {
+        std::cerr << "Some roots had errors. (" << failedRoots << " of " << summaries.size() << " roots, "
+                  << total.failed << " failed actions)\n";
+    }
+    return failedRoots == 0;
+}
+
+bool FileOrganizer::applyPlan(const fs::path& planFile) {
+    const auto started = std::chrono::steady_clock::now();
+    PlanFile plan;
+    try {
+        plan.load(planFile);
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+    const auto loaded = std::chrono::steady_clock::now();
+    std::cout << std::fixed << std::setprecision(1)
+              << "Loaded plan " << planFile << " with " << plan.size() << " actions in "
+              << std::chrono::duration<double, std::milli>(loaded - started).count() << " ms.\n"
+              << std::defaultfloat;
+
+    // Refuse to run a plan made for a tree that has changed since
+    const auto stale = plan.findStale();
+    if (!stale.empty()) {
+        constexpr size_t kShown = 10;
+        for (size_t i = 0; i < stale.size() && i < kShown; ++i) {
+            const Action action = plan.action(stale[i].index);
+            const fs::path& path = stale[i].reason == StaleAction::DESTINATION_EXISTS ? action.destination
+                                                                                      : action.source;
+            std::cerr << "Stale: " << path << ": " << stale[i].describe() << "\n";
+        }
+        if (stale.size() > kShown) {
+            std::cerr << "... and " << (stale.size() - kShown) << " more.\n";
+        }
+        std::cerr << "Error: " << stale.size() << " of " << plan.size()
+                  << " actions are out of date; nothing was done. Plan again with --save-plan.\n";
+        return false;
+    }
+    std::cout << "All sources are unchanged since planning.\n";
+
+    if (args.dryRun) {
+        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
+        plan.printPlan();
+        return true;
+    }
+
+    return executePlan(plan);
 }
 
-void FileOrganizer::renameFiles(const std::string& pattern) {
+bool FileOrganizer::organizeStreaming() {
+    std::cout << "Streaming: planning and executing while scanning...\n";
+    if (args.dryRun) {
+        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
+        std::cout << "=== Plan of Actions ===\n";
+    }
+
+    // Scanner thread -> planner (this thread) -> executor threads
+    BoundedQueue<FileInfo> scanned(kStreamQueueCapacity);
+    BoundedQueue<Action> planned(kStreamQueueCapacity);
+    std::exception_ptr scanError;
+    std::thread scanner([&] {
+        try {
+            Stats::PhaseTimer timer(Stats::SCAN);
+            FileScanner::streamFiles(workingDirectory, args.recursive,
+                                     [&scanned](FileInfo&& file) { return scanned.push(std::move(file)); });
+        } catch (...) {
+            scanError = std::current_exception();
+        }
+        scanned.close();
+    });
+
+    bool executed = true;
+    std::thread executor;
+    if (!args.dryRun) {
+        executor = std::thread([&] { executed = FileOperator::executeStream(planned, args.jobs); });
+    }
+
+    // Emits an action to the executor, or lists it in dry-run mode
+    int moves = 0;
+    int createdDirs = 0;
+    auto emit = [&](const Action& action) {
+        (action.type == Action::CREATE_DIR ? createdDirs : moves)++;
+        if (args.dryRun) {
+            Plan::printAction(action);
+        } else {
+            planned.push(action);
+        }
+    };
+
+    size_t fileCount = 0;
+    try {
+        Stats::PhaseTimer timer(Stats::PLAN);
+        NamespaceIndex names;
+        std::set<fs::path> plannedDirs;
+        FileInfo file;
+        while (scanned.pop(file)) {
+            ++fileCount;
+            if (args.sniff && needsSniffing(file)) {
+                file.contentType = ContentSniffer::sniff(file.path);
+            }
+            if (args.metadataDates && needsMetadataDate(file)) {
+                file.detectedDate = MetadataDate::read(file.path, metadataExtension(file));
+            }
+            if (args.byMtime && file.detectedDate.empty() && file.metadata.fetch(file.path, FileMetadata::MTIME)) {
+                file.detectedDate = file.metadata.mtimeYearMonth();
+            }
+            file.targetDir = targetDirectory(classify(file));
+            planMove(file, names, plannedDirs, emit);
+        }
+    } catch (...) {
+        // Unblock the other stages before leaving
+        scanned.close();
+        planned.close();
+        scanner.join();
+        if (executor.joinable()) executor.join();
+        throw;
+    }
+    planned.close();
+    scanner.join();
+    if (executor.joinable()) {
+        executor.join();
+    }
+    if (scanError) {
+        std::rethrow_exception(scanError);
+    }
+
+    if (args.dryRun) {
+        Log::flush();
+        if (moves + createdDirs == 0) {
+            std::cout << "No actions to perform.\n";
+        } else {
+            std::cout << "========================\n";
+        }
+    }
+    std::cout << "Processed " << fileCount << " files: " << moves << " moves and "
+              << createdDirs << " directories to create.\n";
+    return executed;
+}
+
+bool FileOrganizer::watchFiles() {
+    // Subscribe before the initial pass, so nothing arriving during it is missed
+    DirectoryWatcher watcher(workingDirectory);
+    bool success = organizeFiles();
+
+    stopRequested = 0;
+    auto previousInt = std::signal(SIGINT, requestStop);
+    auto previousTerm = std::signal(SIGTERM, requestStop);
+
+    const auto maxDelay = std::chrono::milliseconds(args.maxDelayMs);
+    WatchQueue queue(workingDirectory, args.maxBatch, maxDelay);
+    std::cout << "\nWatching " << workingDirectory << " for new files (batches of up to " << args.maxBatch
+              << " files, at most " << args.maxDelayMs << " ms delay). Press Ctrl+C to stop.\n";
+
+    std::vector<WatchEvent> events;
+    while (!stopRequested) {
+        events.clear();
+        watcher.wait(queue.timeUntilDue(WatchQueue::Clock::now()), events);
+        const auto now = WatchQueue::Clock::now();
+
+        for (const auto& event : events) {
+            if (event.kind == WatchEvent::CREATED) {
+                queue.created(event.name, now);
+            } else {
+                queue.completed(event.name, now);
+            }
+        }
+        if (watcher.overflowed()) {
+            // The kernel dropped events: whatever is in the directory now may be new
+            std::cout << "Too many events at once; rescanning " << workingDirectory << ".\n";
+            for (const auto& file : FileScanner::scanDirectory(workingDirectory)) {
+                queue.completed(file.path.filename().string(), now);
+            }
+        }
+
+        for (auto names = queue.takeBatch(now); !names.empty(); names = queue.takeBatch(now)) {
+            std::vector<FileInfo> files;
+            files.reserve(names.size());
+            for (const auto& name : names) {
+                const fs::path path = workingDirectory / name;
+                if (isOwnFile(path)) continue;
+                if (auto file = FileScanner::describeFile(path)) {
+                    files.push_back(std::move(*file));
+                }
+            }
+            if (files.empty()) continue;
+
+            std::cout << "\n" << files.size() << " new files (" << queue.size() << " pending).\n";
+            success = organize(files, false) && success;
+        }
+    }
+
+    std::signal(SIGINT, previousInt);
+    std::signal(SIGTERM, previousTerm);
+    std::cout << "\nStopped watching.\n";
+    return success;
+}
+
+bool FileOrganizer::renameFiles(const std::string& pattern) {
+    // Reject a bad pattern before doing any work
+    const RenamePattern compiledPattern = RenamePattern::compile(pattern);
+
     std::cout << "Phase 1: Planning...\n";
 
-    auto files = FileScanner::scanDirectory(workingDirectory);
+    auto files = scanFiles();
     if (files.empty()) {
         std::cout << "No files found to rename in the current directory.\n";
-        return;
+        return true;
     }
     std::cout << "Found " << files.size() << " files to process.\n";
 
+    Stats::PhaseTimer planTimer(Stats::PLAN);
     Plan plan;
+    NamespaceIndex names;
     int counter = 1;
 
     for (auto& file : files) {
-        std::string newName = generateNewName(file, pattern, counter);
+        std::string newName = generateNewName(file, compiledPattern, counter);
 
         fs::path newFilePath = file.path.parent_path() / newName;
 
-        newFilePath = resolveConflict(newFilePath);
+        newFilePath = resolveConflict(newFilePath, names);
 
         plan.addAction(Action(Action::RENAME, file.path, newFilePath));
         
         counter++;
     }
 
-    auto summary = plan.getSummary();
-    std::cout << "Plan created with " << summary["renames"] << " renames.\n";
+    planTimer.stop();
+    std::cout << "Plan created with " << plan.count(Action::RENAME) << " renames.\n";
 
-    if (args.dryRun) {
-        std::cout << "\n--- DRY RUN: No actual changes will be made. ---\n";
-        plan.printPlan();
-        return;
+    return finishPlan(plan);
+}
+
+std::vector<FileInfo> FileOrganizer::scanFiles(const FileScanner::ErrorHandler& onError, unsigned scanThreads) const {
+    Stats::PhaseTimer timer(Stats::SCAN);
+    auto files = args.recursive ? FileScanner::scanRecursive(workingDirectory, scanThreads, onError)
+                                : FileScanner::scanDirectory(workingDirectory, onError);
+
+    // The index or plan may live inside the tree it describes; it is not a file to organize
+    if (!args.indexFile.empty() || !args.savePlanFile.empty() || !args.journalFile.empty()) {
+        files.erase(std::remove_if(files.begin(), files.end(),
+                                   [this](const FileInfo& file) { return isOwnFile(file.path); }),
+                    files.end());
     }
+    return files;
+}
 
-    std::cout << "\nPhase 2: Execution...\n";
-    FileOperator::executePlan(plan);
+bool FileOrganizer::isOwnFile(const fs::path& path) const {
+    const fs::path normalized = path.lexically_normal();
+    for (const std::string& ownFile : {args.indexFile, args.savePlanFile, args.journalFile}) {
+        if (ownFile.empty()) {
+            continue;
+        }
+        const fs::path absolute = fs::absolute(ownFile).lexically_normal();
+        if (normalized == absolute || normalized == AtomicFile::temporaryPath(absolute)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-fs::path FileOrganizer::resolveConflict(const fs::path& filePath) {
-    if (!fs::exists(filePath)) {
-        return filePath;
+void FileOrganizer::classifyFiles(std::vector<FileInfo>& files, bool completeScan) const {
+    Stats::PhaseTimer timer(Stats::CLASSIFY);
+    std::vector<IndexedClassification> results(files.size());
+    std::vector<char> cached(files.size(), 0);
+
+    // Reuse the results of unchanged files from the last run
+    ScanIndex index;
+    std::vector<std::optional<IndexKey>> keys;
+    const uint64_t fingerprint = rulesFingerprint();
+    if (!args.indexFile.empty()) {
+        keys = indexKeys(files);
+        if (!index.load(args.indexFile, fingerprint) && fs::exists(args.indexFile) && printing) {
+            std::cout << "Index " << args.indexFile << " is outdated or unreadable; rebuilding it.\n";
+        }
+        size_t hits = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (keys[i] && index.lookup(*keys[i], results[i])) {
+                files[i].detectedDate = results[i].detectedDate;
+                files[i].contentType = results[i].contentType;
+                cached[i] = 1;
+                ++hits;
+            }
+        }
+        if (printing) {
+            std::cout << "Index: " << hits << " of " << files.size() << " files unchanged since the last run.\n";
+        }
     }
 
-    fs::path stem = filePath.stem();
-    fs::path ext = filePath.extension();
-    fs::path parent = filePath.parent_path();
+    if (args.sniff) {
+        sniffContentTypes(files, cached);
+    }
+    if (args.metadataDates) {
+        readMetadataDates(files, cached);
+    }
+    if (args.byMtime) {
+        dateByMtime(files, cached);
+    }
 
-    int counter = 1;
-    fs::path newPath;
-    do {
-        std::ostringstream oss;
-        oss << stem.string() << " (" << counter << ")" << ext.string();
-        newPath = parent / oss.str();
-        counter++;
-    } while (fs::exists(newPath));
+    for (size_t i = 0; i < files.size(); ++i) {
+        FileInfo& file = files[i];
+        IndexedClassification& result = results[i];
+        if (!cached[i]) {
+            result = classify(file);
+        }
+        file.targetDir = targetDirectory(result);
+    }
+
+    if (!args.indexFile.empty() && !args.dryRun) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (keys[i]) {
+                index.record(*keys[i], results[i]);
+            }
+        }
+        try {
+            index.save(args.indexFile, fingerprint, !completeScan);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << "Warning: " << e.what() << "\n";
+        }
+    }
+}
+
+IndexedClassification FileOrganizer::classify(const FileInfo& file) const {
+    IndexedClassification result;
+    result.detectedDate = file.detectedDate;
+    result.keyword = keywords.match(file.name);
+    result.category = fileTypes.classify(file.contentType.empty() ? file.ext : file.contentType);
+    result.contentType = file.contentType;
+    return result;
+}
 
-    return newPath;
+const std::string& FileOrganizer::targetDirectory(const IndexedClassification& result) {
+    // A date wins over a keyword, which wins over the file type
+    if (!result.detectedDate.empty()) {
+        return result.detectedDate;
+    }
+    if (!result.keyword.empty()) {
+        return result.keyword;
+    }
+    return result.category;
 }
 
-std::string FileOrganizer::generateNewName(const FileInfo& file, const std::string& pattern, int counter) {
-    std::string result = pattern;
+fs::path FileOrganizer::planMove(const FileInfo& file, NamespaceIndex& names, std::set<fs::path>& plannedDirs,
+                                 const std::function<void(const Action&)>& emit) {
+    fs::path targetDirPath = workingDirectory / file.targetDir;
 
-    size_t pos = result.find("{name}");
-    while (pos != std::string::npos) {
-        result.replace(pos, 6, file.name);
-        pos = result.find("{name}", pos + file.name.length());
+    // With --recursive, files from earlier runs are already where they belong
+    if (file.path.parent_path() == targetDirPath) {
+        return file.path;
     }
 
-    pos = result.find("{ext}");
-    while (pos != std::string::npos) {
-        result.replace(pos, 5, file.ext);
-        pos = result.find("{ext}", pos + file.ext.length());
+    if (plannedDirs.find(targetDirPath) == plannedDirs.end()) {
+        emit(Action(Action::CREATE_DIR, "", targetDirPath));
+        plannedDirs.insert(targetDirPath);
     }
 
-    pos = result.find("{counter");
-    while (pos != std::string::npos) {
-        size_t endPos = result.find("}", pos);
-        if (endPos != std::string::npos) {
-            std::string counterStr = result.substr(pos, endPos - pos + 1);
-            
-            int padding = 0;
-            size_t colonPos = counterStr.find(":");
-            if (colonPos != std::string::npos) {
-                try {
-                    padding = std::stoi(counterStr.substr(colonPos + 1));
-                } catch (const std::invalid_argument& ia) {
-                    padding = 0;
-                }
-            }
+    fs::path targetFilePath = targetDirPath / file.path.filename();
 
-            std::ostringstream oss;
-            if (padding > 0) {
-                oss << std::setw(padding) << std::setfill('0') << counter;
-            } else {
-                oss << counter;
-            }
-            
-            result.replace(pos, counterStr.length(), oss.str());
-            pos = result.find("{counter", pos + oss.str().length());
-        } else {
-            break;
+    targetFilePath = resolveConflict(targetFilePath, names);
+
+    emit(Action(Action::MOVE, file.path, targetFilePath));
+    return targetFilePath;
+}
+
+std::vector<std::optional<IndexKey>> FileOrganizer::indexKeys(std::vector<FileInfo>& files) {
+    FileScanner::fetchMetadata(files, FileMetadata::ALL);
+    std::vector<std::optional<IndexKey>> keys(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        keys[i] = IndexKey::of(files[i].path, files[i].metadata);
+    }
+    return keys;
+}
+
+uint64_t FileOrganizer::rulesFingerprint() const {
+    XxHash64 hash(ScanIndex::kFormatVersion);
+    // --sniff counts as 2 since it also reads files with untrusted extensions
+    const uint64_t parts[] = {fileTypes.fingerprint(), keywords.fingerprint(), args.sniff ? 2u : 0u,
+                               args.metadataDates ? 1u : 0u, args.byMtime ? 1u : 0u};
+    hash.update(parts, sizeof(parts));
+    return hash.digest();
+}
+
+void FileOrganizer::sniffContentTypes(std::vector<FileInfo>& files, const std::vector<char>& skip) const {
+    Stats::PhaseTimer timer(Stats::SNIFF);
+    // Only files that would otherwise end up in "Others", or whose extension proves
+    // little, are worth reading
+    std::vector<FileInfo*> candidates;
+    for (size_t i = 0; i < files.size(); ++i) {
+        FileInfo& file = files[i];
+        if (!skip[i] && needsSniffing(file)) {
+            candidates.push_back(&file);
         }
     }
+    if (candidates.empty()) {
+        return;
+    }
 
-    pos = result.find("{date}");
-    while (pos != std::string::npos) {
-        result.replace(pos, 6, file.detectedDate);
-        pos = result.find("{date}", pos + file.detectedDate.length());
+    std::vector<fs::path> paths;
+    paths.reserve(candidates.size());
+    for (const FileInfo* file : candidates) {
+        paths.push_back(file->path);
     }
+    auto contentTypes = ContentSniffer::sniffAll(paths);
 
-    return result;
+    size_t recognized = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!contentTypes[i].empty()) {
+            candidates[i]->contentType = std::move(contentTypes[i]);
+            ++recognized;
+        }
+    }
+    if (printing) {
+        std::cout << "Sniffed " << candidates.size() << " files with unknown or untrusted extensions, recognized "
+                  << recognized << ".\n";
+    }
+}
+
+bool FileOrganizer::needsSniffing(const FileInfo& file) const {
+    return file.detectedDate.empty() &&
+           (!fileTypes.isKnown(file.ext) || FileTypeClassifier::isUntrusted(file.ext)) &&
+           keywords.match(file.name).empty();
+}
+
+void FileOrganizer::readMetadataDates(std::vector<FileInfo>& files, const std::vector<char>& skip) const {
+    Stats::PhaseTimer timer(Stats::METADATA);
+    std::vector<FileInfo*> candidates;
+    std::vector<fs::path> paths;
+    std::vector<std::string> exts;
+    for (size_t i = 0; i < files.size(); ++i) {
+        FileInfo& file = files[i];
+        if (!skip[i] && needsMetadataDate(file)) {
+            candidates.push_back(&file);
+            paths.push_back(file.path);
+            exts.push_back(metadataExtension(file));
+        }
+    }
+    if (candidates.empty()) {
+        return;
+    }
+
+    auto dates = MetadataDate::readAll(paths, exts);
+
+    size_t found = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!dates[i].empty()) {
+            candidates[i]->detectedDate = std::move(dates[i]);
+            ++found;
+        }
+    }
+    if (printing) {
+        std::cout << "Read the dates of " << candidates.size() << " photos and videos, found " << found << ".\n";
+    }
+}
+
+void FileOrganizer::dateByMtime(std::vector<FileInfo>& files, const std::vector<char>& skip) const {
+    std::vector<FileInfo*> undated;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!skip[i] && files[i].detectedDate.empty()) {
+            undated.push_back(&files[i]);
+        }
+    }
+    // Only the modification time is requested; with --index it is already known
+    FileScanner::fetchMetadata(undated, FileMetadata::MTIME);
+    for (FileInfo* file : undated) {
+        file->detectedDate = file->metadata.mtimeYearMonth();
+    }
+}
+
+bool FileOrganizer::needsMetadataDate(const FileInfo& file) {
+    return file.detectedDate.empty() && MetadataDate::supports(metadataExtension(file));
+}
+
+const std::string& FileOrganizer::metadataExtension(const FileInfo& file) {
+    // A sniffed type names the real format of a file with a wrong or missing extension
+    return file.contentType.empty() ? file.ext : file.contentType;
+}
+
+DuplicateReport FileOrganizer::findDuplicates(const std::vector<FileInfo>& files) const {
+    Stats::PhaseTimer timer(Stats::DEDUPE);
+    if (printing) {
+        std::cout << "Looking for duplicates...\n";
+    }
+    DuplicateReport report = DuplicateFinder::find(files);
+    if (!printing) {
+        return report;
+    }
+
+    size_t copies = 0;
+    uintmax_t reclaimable = 0;
+    for (const auto& group : report.groups) {
+        copies += group.duplicates.size();
+        reclaimable += group.size * group.duplicates.size();
+    }
+    std::cout << std::fixed << std::setprecision(1)
+              << "Found " << copies << " duplicates of " << report.groups.size() << " files ("
+              << static_cast<double>(reclaimable) / 1e6 << " MB reclaimable); read "
+              << static_cast<double>(report.bytesRead) / 1e6 << " MB, "
+              << report.fullyHashed << " files in full.\n"
+              << std::defaultfloat;
+    return report;
+}
+
+fs::path FileOrganizer::resolveConflict(const fs::path& filePath, NamespaceIndex& names) {
+    return names.claim(filePath);
+}
+
+std::string FileOrganizer::generateNewName(const FileInfo& file, const RenamePattern& pattern, int counter) {
+    return pattern.render(file, counter);
 }
@@ -1,9 +1,18 @@
 #pragma once
 
+#include "DuplicateFinder.h"
+#include "FileOperator.h"
 #include "FileScanner.h"
+#include "FileTypeClassifier.h"
+#include "Journal.h"
+#include "KeywordMatcher.h"
+#include "NamespaceIndex.h"
 #include "Plan.h"
+#include "RenamePattern.h"
+#include "ScanIndex.h"
 #include "utils/CommandLineParser.h"  // <-- THIS LINE MUST BE CORRECT
 #include <filesystem>
+#include <functional>
 #include <set>
 
 /**
@@ -20,16 +29,40 @@ public:
      * @brief Construct a new FileOrganizer object.
      *
      * @param args The parsed command-line arguments that configure the organizer's behavior.
+     * @param root The directory to organize.
+     * @param printing False to print nothing while planning (see planOrganization).
+     * @throws std::runtime_error If a rules file given in `args` cannot be loaded.
      */
-    explicit FileOrganizer(const CommandLineArgs& args);
+    explicit FileOrganizer(const CommandLineArgs& args,
+                           std::filesystem::path root = std::filesystem::current_path(), bool printing = true);
+
+    /**
+     * @brief Copies this organizer, rules included, to work on another directory.
+     */
+    FileOrganizer rootedAt(std::filesystem::path root) const;
+
+    /**
+     * @brief Scans the root and plans its organization, without executing anything.
+     *
+     * The plan is the one organizeFiles() would execute.
+     *
+     * @param onError Receives the directories that cannot be read.
+     * @param scanThreads The threads of a recursive scan; 0 means one per hardware thread.
+     * @return The plan; empty if there is nothing to organize.
+     * @throws std::filesystem::filesystem_error If the root is not a directory.
+     */
+    Plan planOrganization(const FileScanner::ErrorHandler& onError = FileScanner::ErrorHandler(),
+                          unsigned scanThreads = 0);
 
     /**
      * @brief Organizes files in the current working directory based on hardcoded rules.
      *
      * This method executes the full workflow: scanning, planning, and (if not in dry-run mode)
      * executing the plan to move files into organized directory structures.
+     *
+     * @return False if any action of the plan failed, true otherwise.
      */
-    void organizeFiles();
+    bool organizeFiles();
 
     /**
      * @brief Renames files in the current working directory based on a given pattern.
@@ -38,33 +71,300 @@ public:
      * in dry-run mode) executing the plan to rename files according to the pattern.
      *
      * @param pattern The renaming pattern string with placeholders.
+     * @return False if any action of the plan failed, true otherwise.
+     * @throws std::invalid_argument If the pattern is invalid (checked before scanning).
+     */
+    bool renameFiles(const std::string& pattern);
+
+    /**
+     * @brief Organizes the working directory, then keeps organizing files as they arrive.
+     *
+     * After an initial organizeFiles() pass, new files reported by a DirectoryWatcher
+     * are collected by a WatchQueue into debounced batches (bounded by --max-batch
+     * and --max-delay), and each batch goes through the same classify, plan and
+     * execute steps without rescanning the directory. If the event queue overflows,
+     * the directory is rescanned once to pick up what was missed.
+     *
+     * Runs until interrupted with SIGINT or SIGTERM.
+     *
+     * @return False if any action failed during the session, true otherwise.
+     * @throws std::runtime_error If the directory cannot be watched.
+     */
+    bool watchFiles();
+
+    /**
+     * @brief Organizes the working directory without holding the file list or plan in memory.
+     *
+     * The scan, the planning and the execution run concurrently and are connected
+     * by bounded queues: a scanner thread streams files (see FileScanner::streamFiles)
+     * to the planner on the calling thread, which classifies each one, plans its move
+     * and hands the actions to `--jobs` executor threads. Memory then stays flat no
+     * matter how many files there are, except for the names of the destination
+     * directories that conflict resolution must remember.
+     *
+     * The actions planned are the same as with organizeFiles(), and in the same order;
+     * in dry-run mode they are listed as they are planned. --dedupe and --index need
+     * the complete file list and cannot be streamed.
+     *
+     * @return False if any action failed, true otherwise.
+     */
+    bool organizeStreaming();
+
+    /**
+     * @brief Organizes every root listed in a file, on one shared set of threads (--batch).
+     *
+     * Each root is organized as organizeFiles() would organize it as the working
+     * directory, with the same rules and options; --jobs caps the threads for the
+     * whole batch (see BatchOrganizer). A summary line is logged for each root as
+     * it finishes, and the totals are printed at the end.
+     *
+     * @param listFile The list of roots, one per line; "-" reads the standard input.
+     * @return False if the list cannot be read or any root had an error.
+     */
+    bool organizeBatch(const std::string& listFile);
+
+    /**
+     * @brief Executes a plan saved earlier with --save-plan.
+     *
+     * The plan is mapped rather than parsed, and nothing is scanned. Before anything
+     * runs, every source is compared with its state at planning time and every
+     * destination is checked to still be free; if any action is stale, nothing is
+     * done and the stale actions are listed. In dry-run mode the plan is printed.
+     *
+     * @param planFile The file written by --save-plan.
+     * @return False if the plan cannot be loaded, is stale, or an action failed.
      */
-    void renameFiles(const std::string& pattern);
+    bool applyPlan(const std::filesystem::path& planFile);
+
+    /**
+     * @brief Finishes a run that was interrupted, from the journal it left (--resume).
+     *
+     * Actions the journal records as done are skipped, as are actions that took
+     * effect after the last group commit (see FileOperator::reconcileJournal). The
+     * rest of the plan runs with the journal still recording. In dry-run mode the
+     * remaining actions are printed.
+     *
+     * @return False if the journal cannot be read or an action failed.
+     */
+    bool resumeJournal(const std::filesystem::path& journalFile);
+
+    /**
+     * @brief Reverts a run, from its journal (--undo).
+     *
+     * @return False if the journal cannot be read or an action could not be reverted.
+     */
+    bool undoJournal(const std::filesystem::path& journalFile);
 
 private:
     CommandLineArgs args;              ///< Stores the configuration from command-line.
-    std::filesystem::path workingDirectory; ///< The target directory (current path).
+    std::filesystem::path workingDirectory; ///< The target directory (current path by default).
+    bool printing;                     ///< False to keep the planning steps quiet.
+    FileTypeClassifier fileTypes;      ///< Built-in extension table plus any --types rules.
+    KeywordMatcher keywords;           ///< Built-in keyword rules plus any --keywords rules.
+
+    /**
+     * @brief Plans and executes the organization of the given files.
+     *
+     * @param files The files to organize; classified in place.
+     * @param completeScan True if `files` is everything in the tree (see classifyFiles).
+     * @return False if any action of the plan failed, true otherwise.
+     */
+    bool organize(std::vector<FileInfo>& files, bool completeScan);
+
+    /**
+     * @brief Classifies the given files, finds duplicates if requested, and plans the moves.
+     *
+     * @param files The files to organize; classified in place.
+     * @param completeScan True if `files` is everything in the tree (see classifyFiles).
+     */
+    Plan buildPlan(std::vector<FileInfo>& files, bool completeScan);
+
+    /**
+     * @brief Shows the plan for --dry-run, saves it for --save-plan, or executes it
+     *        (with a journal for --journal).
+     *
+     * @return False if saving the plan or any of its actions failed, true otherwise.
+     */
+    bool finishPlan(const Plan& plan);
+
+    /**
+     * @brief Executes a plan, recording it in a new --journal file if one was given.
+     *
+     * @tparam PlanType Plan, or PlanFile for --apply-plan.
+     * @return False if the journal cannot be created or any action failed.
+     */
+    template <typename PlanType>
+    bool executePlan(const PlanType& plan);
+
+    /**
+     * @brief The engine that executes plans: io_uring for --io-uring, threads otherwise.
+     */
+    ExecutionEngine executionEngine() const;
+
+    /**
+     * @brief Opens a journal for --resume or --undo, reporting errors.
+     *
+     * @return False if the journal cannot be opened.
+     */
+    bool openJournal(const std::filesystem::path& journalFile, Journal& journal) const;
+
+    /**
+     * @brief Checks whether a path is one of the organizer's own files (the index,
+     *        the saved plan or the journal).
+     */
+    bool isOwnFile(const std::filesystem::path& path) const;
+
+    /**
+     * @brief Scans the working directory, recursively if requested.
+     *
+     * @param onError Receives the directories that cannot be read; if empty, they
+     *        are reported on the standard error.
+     * @param scanThreads The threads of a recursive scan; 0 means one per hardware thread.
+     * @return The files to process, in a deterministic order for recursive scans. The
+     *         --index, --save-plan and --journal files, if they lie in the tree, are left out.
+     */
+    std::vector<FileInfo> scanFiles(const FileScanner::ErrorHandler& onError = FileScanner::ErrorHandler(),
+                                    unsigned scanThreads = 0) const;
+
+    /**
+     * @brief Determines the target directory of every file.
+     *
+     * A date in the name wins over a keyword rule, which wins over the file type
+     * (by extension, or by content with --sniff). With --index, files unchanged
+     * since the last run take their results from the index instead, and the index
+     * is then rewritten with the results of this run (except in dry-run mode).
+     *
+     * @param files The scanned files; `targetDir` is set for each one.
+     * @param completeScan True if `files` is everything in the tree, so index entries
+     *        of files that are not among them can be dropped.
+     */
+    void classifyFiles(std::vector<FileInfo>& files, bool completeScan) const;
+
+    /**
+     * @brief Runs the classification rules on one file.
+     */
+    IndexedClassification classify(const FileInfo& file) const;
+
+    /**
+     * @brief Picks the target directory from the classification results.
+     *
+     * A date wins over a keyword, which wins over the file type.
+     */
+    static const std::string& targetDirectory(const IndexedClassification& result);
+
+    /**
+     * @brief Plans the move of one classified file into its target directory.
+     *
+     * Emits a CREATE_DIR action the first time a directory is used, then the MOVE.
+     * A file that already is in its target directory needs no action.
+     *
+     * @param file The file, with `targetDir` set.
+     * @param names The namespace index of the plan being built.
+     * @param plannedDirs The directories created by the plan so far.
+     * @param emit Receives the actions.
+     * @return Where the file will be once the plan has run.
+     */
+    std::filesystem::path planMove(const FileInfo& file, NamespaceIndex& names,
+                                   std::set<std::filesystem::path>& plannedDirs,
+                                   const std::function<void(const Action&)>& emit);
+
+    /**
+     * @brief Fetches the metadata of the files (in parallel) to build their index keys.
+     *
+     * @return One key per file; empty where the file could not be stat'ed.
+     */
+    static std::vector<std::optional<IndexKey>> indexKeys(std::vector<FileInfo>& files);
+
+    /**
+     * @brief Hashes everything that influences classification, for the index.
+     */
+    uint64_t rulesFingerprint() const;
+
+    /**
+     * @brief Fills in the content type of files that no other rule would classify.
+     *
+     * Only files without a date or a keyword match, whose extension is unknown or
+     * untrusted (FileTypeClassifier::isUntrusted), are read, and their headers are
+     * read concurrently in batches (see ContentSniffer::sniffAll). A recognized format
+     * then decides the category instead of the extension.
+     *
+     * @param files The scanned files; `contentType` is set where detection succeeds.
+     * @param skip Files to leave alone (already classified from the index), by index.
+     */
+    void sniffContentTypes(std::vector<FileInfo>& files, const std::vector<char>& skip) const;
+
+    /**
+     * @brief Whether only the content of a file can classify it: no date in its name,
+     *        no keyword match, and an unknown or untrusted extension.
+     */
+    bool needsSniffing(const FileInfo& file) const;
+
+    /**
+     * @brief Dates photos and videos that have no date in their name (--metadata-dates).
+     *
+     * Runs after sniffing, so a file whose content was recognized is read as the
+     * format it really is. The headers are read concurrently in batches (see
+     * MetadataDate::readAll); a date found becomes the file's `detectedDate`, so it
+     * ranks below a date in the name but above keywords and the file type.
+     *
+     * @param files The scanned files.
+     * @param skip Files to leave alone (already classified from the index), by index.
+     */
+    void readMetadataDates(std::vector<FileInfo>& files, const std::vector<char>& skip) const;
+
+    /**
+     * @brief Dates the files that are still undated by their modification time (--by-mtime).
+     *
+     * Runs last among the date sources, so a date in the name or the metadata wins.
+     * Only the modification time is fetched, and only for those files.
+     *
+     * @param files The scanned files.
+     * @param skip Files to leave alone (already classified from the index), by index.
+     */
+    void dateByMtime(std::vector<FileInfo>& files, const std::vector<char>& skip) const;
+
+    /**
+     * @brief Whether a file has no date in its name but a format that may carry one.
+     */
+    static bool needsMetadataDate(const FileInfo& file);
+
+    /**
+     * @brief The extension a file is read as: its sniffed type if any, else its own.
+     */
+    static const std::string& metadataExtension(const FileInfo& file);
+
+    /**
+     * @brief Finds identical files for --dedupe and reports what was found.
+     *
+     * @param files The scanned files.
+     * @return The duplicate groups, with indices into `files`.
+     */
+    DuplicateReport findDuplicates(const std::vector<FileInfo>& files) const;
 
     /**
      * @brief Resolves a file name conflict by appending a counter.
      *
-     * If a file at `filePath` already exists, this function generates a new path
-     * like "filename (1).ext", "filename (2).ext", etc., until a unique path is found.
+     * If a file at `filePath` already exists, or another action of the same plan
+     * already targets it, this function generates a new path like "filename (1).ext",
+     * "filename (2).ext", etc., until a unique path is found. The lookups go through
+     * the plan's NamespaceIndex rather than probing the filesystem.
      *
      * @param filePath The desired destination path.
-     * @return A unique, conflict-free file path.
+     * @param names The namespace index of the plan being built.
+     * @return A unique, conflict-free file path, now claimed in `names`.
      */
-    std::filesystem::path resolveConflict(const std::filesystem::path& filePath);
+    std::filesystem::path resolveConflict(const std::filesystem::path& filePath, NamespaceIndex& names);
 
     /**
      * @brief Generates a new filename based on a pattern and file info.
      *
      * Replaces placeholders like {name}, {ext}, {counter}, and {date} in the pattern.
+     * The pattern is compiled once per run, so this only renders its tokens.
      *
      * @param file The information about the original file.
-     * @param pattern The user-provided pattern string.
+     * @param pattern The compiled rename pattern.
      * @param counter The current counter value for this file.
      * @return The newly generated filename.
      */
-    std::string generateNewName(const FileInfo& file, const std::string& pattern, int counter);
+    std::string generateNewName(const FileInfo& file, const RenamePattern& pattern, int counter);
 };
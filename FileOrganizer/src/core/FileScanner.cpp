@@ -1,35 +1,401 @@
 #include <iostream>          // <-- THIS LINE WAS ADDED
 #include "FileScanner.h"
 #include "PatternMatcher.h"
+#include "utils/Stats.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
-std::vector<FileInfo> FileScanner::scanDirectory(const fs::path& directory) {
+namespace {
+
+FileInfo makeFileInfo(fs::path path) {
+    Stats::add(Stats::FILES_SCANNED);
+    FileInfo info;
+    info.name = path.stem().string();
+    info.ext = path.extension().string();
+    info.path = std::move(path);
+
+    // Pre-detect the date pattern during the scan for efficiency
+    info.detectedDate = PatternMatcher::detectDatePattern(info.name);
+    return info;
+}
+
+/**
+ * @brief Hands a directory that cannot be read to `onError`, or prints it on the
+ *        standard error if there is no handler.
+ */
+void reportScanError(const FileScanner::ErrorHandler& onError, const fs::path& directory,
+                     const std::error_code& error) {
+    if (onError) {
+        onError(directory, error);
+        return;
+    }
+    if (error == std::errc::not_a_directory) {
+        std::cerr << "Error: Directory does not exist or is not a directory: " << directory << std::endl;
+    } else {
+        std::cerr << "Error: Cannot read directory " << directory << ": " << error.message() << std::endl;
+    }
+}
+
+/**
+ * @brief Checks that the root of a scan is a directory, reporting it otherwise.
+ */
+bool isScannableRoot(const FileScanner::ErrorHandler& onError, const fs::path& directory) {
+    if (fs::exists(directory) && fs::is_directory(directory)) {
+        return true;
+    }
+    reportScanError(onError, directory, std::make_error_code(std::errc::not_a_directory));
+    return false;
+}
+
+/**
+ * @brief The files found directly inside one directory of the tree.
+ */
+struct DirectoryChunk {
+    fs::path relativeDir;
+    std::vector<FileInfo> files;
+};
+
+/**
+ * @brief Concatenates the per-thread chunks in a deterministic order.
+ *
+ * fs::path compares element by element, so sorting by directory yields a pre-order
+ * walk: a directory's own files come before those of any of its subdirectories.
+ */
+std::vector<FileInfo> mergeChunks(std::vector<std::vector<DirectoryChunk>>& buffers) {
+    std::vector<DirectoryChunk*> chunks;
+    size_t fileCount = 0;
+    for (auto& buffer : buffers) {
+        for (auto& chunk : buffer) {
+            chunks.push_back(&chunk);
+            fileCount += chunk.files.size();
+        }
+    }
+    std::sort(chunks.begin(), chunks.end(), [](const DirectoryChunk* a, const DirectoryChunk* b) {
+        return a->relativeDir < b->relativeDir;
+    });
+
+    std::vector<FileInfo> files;
+    files.reserve(fileCount);
+    for (DirectoryChunk* chunk : chunks) {
+        std::move(chunk->files.begin(), chunk->files.end(), std::back_inserter(files));
+    }
+    return files;
+}
+
+#ifdef __linux__
+
+/// The record layout returned by getdents64 (glibc does not export it).
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+/**
+ * @class RecursiveScan
+ * @brief One parallel walk of a directory tree.
+ *
+ * Each directory is a task on the work-stealing pool. Directories are opened with
+ * openat relative to a descriptor of the root, so the number of open descriptors
+ * stays bounded by the number of workers however many tasks are queued.
+ */
+class RecursiveScan {
+public:
+    RecursiveScan(const fs::path& root, int rootFd, unsigned threadCount, const FileScanner::ErrorHandler& onError)
+        : root(root), rootFd(rootFd), onError(onError), pool(threadCount), buffers(pool.size()) {}
+
+    std::vector<FileInfo> run() {
+        pool.submit([this] { scanOne(fs::path()); });
+        pool.wait();
+        return mergeChunks(buffers);
+    }
+
+private:
+    const fs::path root;
+    const int rootFd;
+    const FileScanner::ErrorHandler& onError;
+    WorkStealingPool pool;
+    std::vector<std::vector<DirectoryChunk>> buffers; ///< One result buffer per worker.
+    std::mutex errorMutex;
+
+    enum class EntryKind { File, Directory, Other };
+
+    void reportError(const fs::path& relativeDir, int error) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        reportScanError(onError, root / relativeDir, std::error_code(error, std::generic_category()));
+    }
+
+    // Resolves the kind of an entry. d_type answers without a syscall on most
+    // filesystems; only symlinks and DT_UNKNOWN entries need an fstatat, and the
+    // metadata of a file that had one is kept so it is not stat'ed again.
+    static EntryKind classify(int dirFd, const char* name, unsigned char type, FileMetadata& metadata) {
+        switch (type) {
+            case DT_REG: return EntryKind::File;
+            case DT_DIR: return EntryKind::Directory;
+            case DT_LNK: case DT_UNKNOWN: break;
+            default: return EntryKind::Other;
+        }
+
+        struct stat st;
+        if (type == DT_UNKNOWN) {
+            if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return EntryKind::Other;
+            if (S_ISREG(st.st_mode)) {
+                metadata.fill(st);
+                return EntryKind::File;
+            }
+            if (S_ISDIR(st.st_mode)) return EntryKind::Directory;
+            if (!S_ISLNK(st.st_mode)) return EntryKind::Other;
+        }
+        // Like directory_entry::is_regular_file(), a symlink counts if its target is a
+        // regular file. Symlinked directories are not followed to avoid cycles.
+        if (fstatat(dirFd, name, &st, 0) == 0 && S_ISREG(st.st_mode)) {
+            metadata.fill(st);
+            return EntryKind::File;
+        }
+        return EntryKind::Other;
+    }
+
+    void scanOne(const fs::path& relativeDir) {
+        const char* openPath = relativeDir.empty() ? "." : relativeDir.c_str();
+        int dirFd = openat(rootFd, openPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        if (dirFd < 0) {
+            reportError(relativeDir, errno);
+            return;
+        }
+
+        Stats::add(Stats::DIRECTORIES_SCANNED);
+        std::vector<std::pair<std::string, FileMetadata>> fileNames;
+        alignas(LinuxDirent64) char buffer[64 * 1024];
+        while (true) {
+            long bytes = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+            if (bytes < 0) {
+                reportError(relativeDir, errno);
+                break;
+            }
+            if (bytes == 0) {
+                break;
+            }
+
+            for (long offset = 0; offset < bytes;) {
+                const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                const char* name = entry->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                FileMetadata metadata;
+                switch (classify(dirFd, name, entry->d_type, metadata)) {
+                    case EntryKind::File:
+                        fileNames.emplace_back(name, metadata);
+                        break;
+                    case EntryKind::Directory:
+                        // Each subdirectory is a separate, stealable task
+                        pool.submit([this, child = relativeDir / name] { scanOne(child); });
+                        break;
+                    case EntryKind::Other:
+                        break;
+                }
+            }
+        }
+        close(dirFd);
+
+        if (fileNames.empty()) {
+            return;
+        }
+        std::sort(fileNames.begin(), fileNames.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        DirectoryChunk chunk;
+        chunk.relativeDir = relativeDir;
+        chunk.files.reserve(fileNames.size());
+        const fs::path directory = root / relativeDir;
+        for (auto& [name, metadata] : fileNames) {
+            chunk.files.push_back(makeFileInfo(directory / name));
+            chunk.files.back().metadata = metadata;
+        }
+        buffers[pool.workerIndex()].push_back(std::move(chunk));
+    }
+};
+
+#endif
+
+/**
+ * @brief Streams one directory and, depth-first, its subdirectories.
+ *
+ * Files come out in the order scanRecursive() returns them: a directory's files
+ * sorted by name, then each subdirectory in name order.
+ */
+bool streamTree(const fs::path& directory, const std::function<bool(FileInfo&&)>& sink,
+                const FileScanner::ErrorHandler& onError) {
+    Stats::add(Stats::DIRECTORIES_SCANNED);
+    std::vector<std::string> fileNames;
+    std::vector<std::string> subdirectories;
+
+    std::error_code ec;
+    fs::directory_iterator it(directory, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        const auto& entry = *it;
+        std::error_code typeError;
+        if (entry.is_regular_file(typeError)) {
+            fileNames.push_back(entry.path().filename().string());
+        } else if (entry.is_directory(typeError) && !entry.is_symlink(typeError)) {
+            // Symlinked directories are not followed, as in scanRecursive()
+            subdirectories.push_back(entry.path().filename().string());
+        }
+    }
+    if (ec) {
+        reportScanError(onError, directory, ec);
+    }
+
+    std::sort(fileNames.begin(), fileNames.end());
+    for (const auto& name : fileNames) {
+        if (!sink(makeFileInfo(directory / name))) return false;
+    }
+    std::sort(subdirectories.begin(), subdirectories.end());
+    for (const auto& name : subdirectories) {
+        if (!streamTree(directory / name, sink, onError)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<FileInfo> FileScanner::scanDirectory(const fs::path& directory, const ErrorHandler& onError) {
     std::vector<FileInfo> files;
-    
+
     // Check if the directory exists and is indeed a directory
-    if (!fs::exists(directory) || !fs::is_directory(directory)) {
+    if (!isScannableRoot(onError, directory)) {
         // In a real-world scenario, you might throw an exception or return an error
         // For this utility, we'll just return an empty vector.
-        std::cerr << "Error: Directory does not exist or is not a directory: " << directory << std::endl;
         return files;
     }
 
+    Stats::add(Stats::DIRECTORIES_SCANNED);
     for (const auto& entry : fs::directory_iterator(directory)) {
         // We only care about regular files, not subdirectories or symlinks
         if (entry.is_regular_file()) {
-            FileInfo info;
-            info.path = entry.path();
-            info.name = entry.path().stem().string();
-            info.ext = entry.path().extension().string();
-            
-            // Pre-detect the date pattern during the scan for efficiency
-            info.detectedDate = PatternMatcher::detectDatePattern(info.name);
-            
-            files.push_back(std::move(info));
-        }
-    }
-    
+            files.push_back(makeFileInfo(entry.path()));
+        }
+    }
+
+    return files;
+}
+
+bool FileScanner::streamFiles(const fs::path& directory, bool recursive,
+                              const std::function<bool(FileInfo&&)>& sink, const ErrorHandler& onError) {
+    if (!isScannableRoot(onError, directory)) {
+        return true;
+    }
+    if (recursive) {
+        return streamTree(directory, sink, onError);
+    }
+
+    Stats::add(Stats::DIRECTORIES_SCANNED);
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.is_regular_file() && !sink(makeFileInfo(entry.path()))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<FileInfo> FileScanner::describeFile(const fs::path& file) {
+    std::error_code ec;
+    if (!fs::is_regular_file(file, ec)) {
+        return std::nullopt;
+    }
+    return makeFileInfo(file);
+}
+
+std::vector<FileInfo> FileScanner::scanRecursive(const fs::path& directory, unsigned threadCount,
+                                                 const ErrorHandler& onError) {
+    if (!isScannableRoot(onError, directory)) {
+        return {};
+    }
+
+#ifdef __linux__
+    int rootFd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        reportScanError(onError, directory, std::error_code(errno, std::generic_category()));
+        return {};
+    }
+    std::vector<FileInfo> files = RecursiveScan(directory, rootFd, threadCount, onError).run();
+    close(rootFd);
     return files;
+#else
+    // Portable fallback: a sequential walk, merged in the same order as the parallel one
+    (void)threadCount;
+    (void)onError;
+    std::vector<std::vector<DirectoryChunk>> buffers(1);
+    std::map<fs::path, size_t> chunkIndex;
+    auto options = fs::directory_options::skip_permission_denied;
+    for (const auto& entry : fs::recursive_directory_iterator(directory, options)) {
+        if (!entry.is_regular_file()) continue;
+        fs::path relativeDir = entry.path().parent_path().lexically_relative(directory);
+        if (relativeDir == ".") relativeDir.clear();
+        auto [it, inserted] = chunkIndex.emplace(relativeDir, buffers[0].size());
+        if (inserted) buffers[0].push_back(DirectoryChunk{relativeDir, {}});
+        buffers[0][it->second].files.push_back(makeFileInfo(entry.path()));
+    }
+    for (auto& chunk : buffers[0]) {
+        std::sort(chunk.files.begin(), chunk.files.end(), [](const FileInfo& a, const FileInfo& b) {
+            return a.path.filename() < b.path.filename();
+        });
+    }
+    return mergeChunks(buffers);
+#endif
+}
+
+void FileScanner::fetchMetadata(std::vector<FileInfo>& files, unsigned fields, unsigned threadCount) {
+    std::vector<FileInfo*> all;
+    all.reserve(files.size());
+    for (FileInfo& file : files) {
+        all.push_back(&file);
+    }
+    fetchMetadata(all, fields, threadCount);
+}
+
+void FileScanner::fetchMetadata(const std::vector<FileInfo*>& files, unsigned fields, unsigned threadCount) {
+    // Stats are cheap and many; batches keep the pool's overhead per file small
+    constexpr size_t batchSize = 256;
+
+    std::vector<FileInfo*> missing;
+    for (FileInfo* file : files) {
+        if (!file->metadata.attempted(fields)) {
+            missing.push_back(file);
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    WorkStealingPool pool(threadCount);
+    for (size_t begin = 0; begin < missing.size(); begin += batchSize) {
+        const size_t end = std::min(begin + batchSize, missing.size());
+        pool.submit([&missing, fields, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                missing[i]->metadata.fetch(missing[i]->path, fields);
+            }
+        });
+    }
+    pool.wait();
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "FileMetadata.h"
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include <vector>
 #include <string>
 
@@ -15,8 +18,10 @@ struct FileInfo {
     std::filesystem::path path;         ///< The full path to the file.
     std::string name;                   ///< The base name of the file (filename without extension).
     std::string ext;                    ///< The file extension, including the dot (e.g., ".txt").
-    std::string detectedDate;           ///< The date string detected in the filename, if any.
+    std::string detectedDate;           ///< The date detected in the filename (or, with --metadata-dates, the file header), if any.
+    std::string contentType;            ///< The extension implied by the file's content, if sniffed.
     std::string targetDir;              ///< The target directory for organization, determined later.
+    FileMetadata metadata;              ///< Size, mtime and identity, fetched on demand (see FileScanner::fetchMetadata).
 };
 
 /**
@@ -29,6 +34,14 @@ struct FileInfo {
  */
 class FileScanner {
 public:
+    /**
+     * @brief Receives a directory that could not be read and why; the scan goes on without it.
+     *
+     * A root that is missing or not a directory arrives with errc::not_a_directory.
+     * Where a scan is given no handler, it prints these errors on the standard error.
+     */
+    using ErrorHandler = std::function<void(const std::filesystem::path& directory, const std::error_code& error)>;
+
     /**
      * @brief Scans the given directory and returns a vector of FileInfo objects.
      *
@@ -36,7 +49,80 @@ public:
      * For each regular file, it extracts the name and extension.
      *
      * @param directory The path to the directory to scan.
+     * @param onError Receives the directory if it cannot be scanned; if empty, the
+     *        error is reported on the standard error.
      * @return A vector of FileInfo objects, one for each file found.
      */
-    static std::vector<FileInfo> scanDirectory(const std::filesystem::path& directory);
+    static std::vector<FileInfo> scanDirectory(const std::filesystem::path& directory,
+                                               const ErrorHandler& onError = ErrorHandler());
+
+    /**
+     * @brief Scans the given directory and all of its subdirectories in parallel.
+     *
+     * Every subdirectory becomes a task on a work-stealing pool. On Linux, entries are
+     * read with raw getdents64 on directories opened with openat, and the entry type
+     * comes from d_type, so no stat is needed except for symlinks and filesystems that
+     * report DT_UNKNOWN. Symlinks to regular files are included (as in scanDirectory);
+     * symlinked directories are not followed.
+     *
+     * Each worker collects its results in its own buffer. The buffers are merged so
+     * that the output order is deterministic: directories in path order (a directory's
+     * files before those of its subdirectories), files sorted by name within each one.
+     *
+     * @param directory The path to the root directory to scan.
+     * @param threadCount The number of scanner threads; 0 means one per hardware thread.
+     * @param onError Receives the directories that cannot be read, one call at a time;
+     *        if empty, they are reported on the standard error.
+     * @return A vector of FileInfo objects, one for each file found in the tree.
+     */
+    static std::vector<FileInfo> scanRecursive(const std::filesystem::path& directory, unsigned threadCount = 0,
+                                               const ErrorHandler& onError = ErrorHandler());
+
+    /**
+     * @brief Scans a directory, handing each file to `sink` as soon as it is found.
+     *
+     * Nothing is accumulated: memory use does not grow with the number of files
+     * (except that a recursive scan sorts the names of one directory at a time).
+     * The files arrive in the same order as from scanDirectory() or scanRecursive(),
+     * but a recursive scan runs sequentially.
+     *
+     * @param directory The path to the directory to scan.
+     * @param recursive Whether to descend into subdirectories.
+     * @param sink Receives each file; returning false stops the scan.
+     * @param onError Receives the directories that cannot be read; if empty, they
+     *        are reported on the standard error.
+     * @return False if `sink` stopped the scan, true otherwise.
+     */
+    static bool streamFiles(const std::filesystem::path& directory, bool recursive,
+                            const std::function<bool(FileInfo&&)>& sink,
+                            const ErrorHandler& onError = ErrorHandler());
+
+    /**
+     * @brief Builds the FileInfo of a single file, as a scan would.
+     *
+     * Used when files are reported one by one (e.g. by a DirectoryWatcher) instead
+     * of being found by a scan.
+     *
+     * @param file The path of the file.
+     * @return The FileInfo, or nothing if `file` is not (or no longer) a regular file.
+     */
+    static std::optional<FileInfo> describeFile(const std::filesystem::path& file);
+
+    /**
+     * @brief Fills in the metadata fields that a later step needs, for many files.
+     *
+     * Files that already have the fields (from an earlier call, or from a stat the
+     * scan could not avoid) are skipped; the others are stat'ed in batches on a
+     * thread pool, each with only the missing fields requested.
+     *
+     * @param files The scanned files.
+     * @param fields The fields needed, as a set of FileMetadata::Field bits.
+     * @param threadCount The number of threads; 0 means one per hardware thread.
+     */
+    static void fetchMetadata(std::vector<FileInfo>& files, unsigned fields, unsigned threadCount = 0);
+
+    /**
+     * @brief Same as above, for a subset of the scanned files.
+     */
+    static void fetchMetadata(const std::vector<FileInfo*>& files, unsigned fields, unsigned threadCount = 0);
 };
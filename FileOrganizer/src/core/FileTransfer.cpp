@@ -0,0 +1,380 @@
+#include "FileTransfer.h"
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+double TransferResult::megabytesPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(bytes) / seconds / 1e6 : 0.0;
+}
+
+const char* TransferResult::methodName() const {
+    switch (method) {
+        case REFLINK: return "reflink";
+        case COPY_FILE_RANGE: return "copy_file_range";
+        case SENDFILE: return "sendfile";
+        case BUFFERED: return "buffered";
+    }
+    return "unknown";
+}
+
+namespace {
+
+[[noreturn]] void fail(const char* what, const fs::path& source, const fs::path& destination, int error) {
+    throw fs::filesystem_error(what, source, destination, std::error_code(error, std::generic_category()));
+}
+
+[[noreturn]] void throwTaken(const fs::path& source, const fs::path& destination) {
+    throw fs::filesystem_error("destination is taken", source, destination,
+                               std::make_error_code(std::errc::file_exists));
+}
+
+/**
+ * @brief The name of the temporary file the data is staged in before the final rename.
+ */
+fs::path stagingPath(const fs::path& destination) {
+    return destination.parent_path() / ("." + destination.filename().string() + ".fo-partial");
+}
+
+#ifdef __linux__
+
+constexpr uint64_t kKernelChunk = 64ull << 20;  ///< Bytes per copy_file_range/sendfile call.
+constexpr size_t kBufferBytes = 1u << 20;        ///< Buffer size of the user-space fallback.
+
+/// Result code meaning "this mechanism is not available here, nothing was copied".
+constexpr int kUnsupported = -1;
+
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd = -1) : fd(fd) {}
+    ~FileDescriptor() { reset(); }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    int get() const { return fd; }
+    bool valid() const { return fd >= 0; }
+    void reset(int newFd = -1) {
+        if (fd >= 0) ::close(fd);
+        fd = newFd;
+    }
+    /// Closes the descriptor, reporting the error close() may return (e.g. from NFS).
+    int close() {
+        int result = ::close(fd);
+        fd = -1;
+        return result == 0 ? 0 : errno;
+    }
+
+private:
+    int fd;
+};
+
+bool isUnsupported(int error) {
+    return error == EXDEV || error == ENOSYS || error == EOPNOTSUPP || error == EINVAL;
+}
+
+// Copies [offset, offset + length) with copy_file_range, using explicit offsets so
+// that several ranges of the same file can be copied concurrently.
+int copyRangeKernel(int in, int out, uint64_t offset, uint64_t length) {
+    loff_t inOffset = static_cast<loff_t>(offset);
+    loff_t outOffset = static_cast<loff_t>(offset);
+    uint64_t remaining = length;
+    bool first = true;
+    while (remaining > 0) {
+        ssize_t copied = copy_file_range(in, &inOffset, out, &outOffset,
+                                         static_cast<size_t>(std::min(remaining, kKernelChunk)), 0);
+        if (copied < 0) {
+            if (errno == EINTR) continue;
+            return first && isUnsupported(errno) ? kUnsupported : errno;
+        }
+        if (copied == 0) {
+            return EIO;  // The source shrank while being copied
+        }
+        remaining -= static_cast<uint64_t>(copied);
+        first = false;
+    }
+    return 0;
+}
+
+// Copies the whole file with sendfile. The destination offset is the file position,
+// so this is only used for sequential copies.
+int copyWithSendfile(int in, int out, uint64_t length) {
+    off_t inOffset = 0;
+    uint64_t remaining = length;
+    bool first = true;
+    while (remaining > 0) {
+        ssize_t copied = sendfile(out, in, &inOffset, static_cast<size_t>(std::min(remaining, kKernelChunk)));
+        if (copied < 0) {
+            if (errno == EINTR) continue;
+            return first && isUnsupported(errno) ? kUnsupported : errno;
+        }
+        if (copied == 0) {
+            return EIO;
+        }
+        remaining -= static_cast<uint64_t>(copied);
+        first = false;
+    }
+    return 0;
+}
+
+int copyRangeBuffered(int in, int out, uint64_t offset, uint64_t length) {
+    std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(length, kBufferBytes)));
+    uint64_t done = 0;
+    while (done < length) {
+        const size_t want = static_cast<size_t>(std::min<uint64_t>(length - done, buffer.size()));
+        ssize_t got = pread(in, buffer.data(), want, static_cast<off_t>(offset + done));
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (got == 0) {
+            return EIO;
+        }
+        for (ssize_t written = 0; written < got;) {
+            ssize_t n = pwrite(out, buffer.data() + written, static_cast<size_t>(got - written),
+                               static_cast<off_t>(offset + done + written));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            written += n;
+        }
+        done += static_cast<uint64_t>(got);
+    }
+    return 0;
+}
+
+int copySequential(int in, int out, uint64_t size, TransferResult& result) {
+    int error = copyRangeKernel(in, out, 0, size);
+    if (error == 0) {
+        result.method = TransferResult::COPY_FILE_RANGE;
+        return 0;
+    }
+    if (error != kUnsupported) return error;
+
+    error = copyWithSendfile(in, out, size);
+    if (error == 0) {
+        result.method = TransferResult::SENDFILE;
+        return 0;
+    }
+    if (error != kUnsupported) return error;
+
+    result.method = TransferResult::BUFFERED;
+    return copyRangeBuffered(in, out, 0, size);
+}
+
+// Splits a large file into contiguous ranges copied on separate threads. Each range
+// uses copy_file_range if the filesystems allow it and pread/pwrite otherwise.
+int copyParallel(int in, int out, uint64_t size, TransferResult& result) {
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned streams = std::min(FileTransfer::kMaxStreams, hardware);
+    if (streams < 2) {
+        return copySequential(in, out, size, result);
+    }
+    const uint64_t rangeSize = (size + streams - 1) / streams;
+
+    std::vector<int> errors(streams, 0);
+    std::vector<char> buffered(streams, 0);  // Not vector<bool>: written concurrently
+    std::vector<std::thread> threads;
+    threads.reserve(streams);
+    for (unsigned i = 0; i < streams; ++i) {
+        const uint64_t offset = i * rangeSize;
+        const uint64_t length = offset < size ? std::min(rangeSize, size - offset) : 0;
+        threads.emplace_back([&, i, offset, length] {
+            int error = copyRangeKernel(in, out, offset, length);
+            if (error == kUnsupported) {
+                buffered[i] = 1;
+                error = copyRangeBuffered(in, out, offset, length);
+            }
+            errors[i] = error;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    result.streams = streams;
+    result.method = std::find(buffered.begin(), buffered.end(), 1) != buffered.end()
+        ? TransferResult::BUFFERED
+        : TransferResult::COPY_FILE_RANGE;
+    for (int error : errors) {
+        if (error != 0) return error;
+    }
+    return 0;
+}
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+
+/**
+ * @brief Renames the staged copy into place, failing with EEXIST rather than
+ *        replacing a file that appeared at the destination during the copy.
+ *
+ * renameat2 with RENAME_NOREPLACE where the kernel and filesystem have it; else a
+ * hard link, which also refuses to replace, and an unlink of the staged name. Only
+ * a filesystem without either falls back to a check just before the rename.
+ *
+ * @return 0 or the errno of the failure.
+ */
+int commitNoReplace(const fs::path& staging, const fs::path& destination) {
+#ifdef SYS_renameat2
+    if (::syscall(SYS_renameat2, AT_FDCWD, staging.c_str(), AT_FDCWD, destination.c_str(), RENAME_NOREPLACE) == 0) {
+        return 0;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return errno;
+    }
+#endif
+    if (::link(staging.c_str(), destination.c_str()) == 0) {
+        ::unlink(staging.c_str());
+        return 0;
+    }
+    if (errno != EPERM && errno != EOPNOTSUPP && errno != EMLINK) {
+        return errno;
+    }
+    struct stat st;
+    if (::lstat(destination.c_str(), &st) == 0) {
+        return EEXIST;
+    }
+    return ::rename(staging.c_str(), destination.c_str()) == 0 ? 0 : errno;
+}
+
+// Makes a completed rename durable by syncing the directory that holds it
+void syncDirectory(const fs::path& directory) {
+    FileDescriptor dir(open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dir.valid()) {
+        fsync(dir.get());
+    }
+}
+
+#endif
+
+} // namespace
+
+TransferResult FileTransfer::moveAcrossDevices(const fs::path& source, const fs::path& destination) {
+    const auto start = std::chrono::steady_clock::now();
+    TransferResult result;
+    const fs::path staging = stagingPath(destination);
+
+#ifdef __linux__
+    FileDescriptor in(open(source.c_str(), O_RDONLY | O_CLOEXEC));
+    if (!in.valid()) {
+        fail("cannot open source for cross-device move", source, destination, errno);
+    }
+    struct stat st;
+    if (fstat(in.get(), &st) != 0) {
+        fail("cannot stat source for cross-device move", source, destination, errno);
+    }
+    if (!S_ISREG(st.st_mode)) {
+        fail("cross-device move of a non-regular file", source, destination, EINVAL);
+    }
+    result.bytes = static_cast<uint64_t>(st.st_size);
+
+    FileDescriptor out(open(staging.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600));
+    if (!out.valid() && errno == EEXIST) {
+        // Left over from an interrupted run; it was never renamed into place
+        unlink(staging.c_str());
+        out.reset(open(staging.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600));
+    }
+    if (!out.valid()) {
+        fail("cannot create file for cross-device move", source, staging, errno);
+    }
+
+    // From here on, any failure must not leave a partial copy behind
+    struct StagingGuard {
+        const fs::path& path;
+        bool committed = false;
+        ~StagingGuard() { if (!committed) unlink(path.c_str()); }
+    } guard{staging};
+
+    int error = 0;
+    if (ioctl(out.get(), FICLONE, in.get()) == 0) {
+        result.method = TransferResult::REFLINK;
+    } else {
+        posix_fadvise(in.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+        error = result.bytes >= kParallelThreshold
+            ? copyParallel(in.get(), out.get(), result.bytes, result)
+            : copySequential(in.get(), out.get(), result.bytes, result);
+    }
+    if (error != 0) {
+        fail("cannot copy file across devices", source, destination, error);
+    }
+
+    // Ownership first: chown clears the set-user-ID and set-group-ID bits.
+    // Only privileged users can give files away, so a failure here is not an error.
+    [[maybe_unused]] int chownResult = fchown(out.get(), st.st_uid, st.st_gid);
+    if (fchmod(out.get(), st.st_mode & 07777) != 0) {
+        fail("cannot preserve permissions on cross-device move", source, destination, errno);
+    }
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    if (futimens(out.get(), times) != 0) {
+        fail("cannot preserve timestamps on cross-device move", source, destination, errno);
+    }
+    if (fsync(out.get()) != 0) {
+        fail("cannot sync cross-device copy", source, destination, errno);
+    }
+    if ((error = out.close()) != 0) {
+        fail("cannot close cross-device copy", source, destination, error);
+    }
+
+    if ((error = commitNoReplace(staging, destination)) == EEXIST) {
+        throwTaken(source, destination);
+    }
+    if (error != 0) {
+        fail("cannot rename cross-device copy into place", staging, destination, error);
+    }
+    guard.committed = true;
+    syncDirectory(destination.parent_path());
+
+    // The destination is complete and durable; only now give up the source
+    if (unlink(source.c_str()) != 0) {
+        fail("copied across devices but cannot remove source", source, destination, errno);
+    }
+#else
+    // Portable fallback: a plain copy through std::filesystem
+    result.bytes = fs::file_size(source);
+    result.method = TransferResult::BUFFERED;
+    try {
+        fs::copy_file(source, staging, fs::copy_options::overwrite_existing);
+        fs::permissions(staging, fs::status(source).permissions());
+        fs::last_write_time(staging, fs::last_write_time(source));
+        // A hard link refuses to replace the destination; filesystems without links
+        // fall back to a check just before the rename
+        std::error_code ec;
+        fs::create_hard_link(staging, destination, ec);
+        if (ec == std::errc::file_exists) {
+            throwTaken(source, destination);
+        }
+        if (ec) {
+            if (fs::exists(fs::symlink_status(destination))) {
+                throwTaken(source, destination);
+            }
+            fs::rename(staging, destination);
+        } else {
+            fs::remove(staging);
+        }
+    } catch (const fs::filesystem_error&) {
+        std::error_code ignored;
+        fs::remove(staging, ignored);
+        throw;
+    }
+    fs::remove(source);
+#endif
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+/**
+ * @struct TransferResult
+ * @brief Describes how a cross-device move was carried out.
+ */
+struct TransferResult {
+    enum Method {
+        REFLINK,          ///< FICLONE: the destination shares the source's extents.
+        COPY_FILE_RANGE,  ///< In-kernel copy, no data passes through user space.
+        SENDFILE,         ///< In-kernel copy through sendfile.
+        BUFFERED          ///< read/write through a user-space buffer.
+    };
+
+    Method method = BUFFERED;
+    uint64_t bytes = 0;       ///< Size of the transferred file.
+    double seconds = 0.0;     ///< Wall time of the whole transfer, including fsync.
+    unsigned streams = 1;     ///< Number of chunks copied in parallel.
+
+    /**
+     * @brief Gets the achieved throughput in MB/s (10^6 bytes per second).
+     */
+    double megabytesPerSecond() const;
+
+    /**
+     * @brief Gets a short human-readable name for the method.
+     */
+    const char* methodName() const;
+};
+
+/**
+ * @class FileTransfer
+ * @brief Moves files between filesystems, where rename() fails with EXDEV.
+ *
+ * The data is written to a hidden temporary file next to the destination using the
+ * fastest mechanism the two filesystems support: a FICLONE reflink first, then
+ * copy_file_range (or sendfile) in large chunks, then a plain buffered copy. Files of
+ * at least kParallelThreshold bytes are split into chunks copied on several threads.
+ *
+ * Permissions, ownership (where allowed) and timestamps are carried over, the copy is
+ * fsynced and renamed into place, and only then is the source removed. The final
+ * rename never replaces an existing file (RENAME_NOREPLACE, or a hard link where the
+ * filesystem lacks it), so a file created at the destination during the copy is
+ * kept. If anything fails, the temporary file is removed and the source is left
+ * untouched.
+ * All methods are static as this class is stateless.
+ */
+class FileTransfer {
+public:
+    static constexpr uint64_t kParallelThreshold = 256ull << 20;  ///< 256 MiB.
+    static constexpr unsigned kMaxStreams = 4;
+
+    /**
+     * @brief Moves a regular file to a destination on another filesystem.
+     *
+     * @param source The file to move.
+     * @param destination The full destination path.
+     * @return How the file was transferred.
+     * @throws std::filesystem::filesystem_error If the transfer fails, with
+     *         errc::file_exists if the destination is taken.
+     */
+    static TransferResult moveAcrossDevices(const std::filesystem::path& source,
+                                            const std::filesystem::path& destination);
+};
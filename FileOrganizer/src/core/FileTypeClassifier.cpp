@@ -0,0 +1,251 @@
+#include "FileTypeClassifier.h"
+#include "utils/XxHash64.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+struct BuiltInType {
+    const char* extension;
+    const char* category;
+};
+
+// The categories FileOrganizer has always known about
+constexpr BuiltInType kBuiltInTypes[] = {
+    // Document types
+    {"pdf", "Documents"}, {"docx", "Documents"}, {"doc", "Documents"},
+    {"txt", "Documents"}, {"rtf", "Documents"}, {"odt", "Documents"},
+    // Image types
+    {"jpg", "Images"}, {"jpeg", "Images"}, {"png", "Images"}, {"gif", "Images"},
+    {"bmp", "Images"}, {"tiff", "Images"}, {"webp", "Images"},
+    // Video types
+    {"mp4", "Videos"}, {"avi", "Videos"}, {"mkv", "Videos"}, {"mov", "Videos"},
+    {"wmv", "Videos"}, {"flv", "Videos"}, {"webm", "Videos"},
+    // Audio types
+    {"mp3", "Audio"}, {"wav", "Audio"}, {"flac", "Audio"}, {"aac", "Audio"},
+    {"ogg", "Audio"}, {"wma", "Audio"},
+    // Archive types
+    {"zip", "Archives"}, {"rar", "Archives"}, {"7z", "Archives"}, {"tar", "Archives"},
+    {"gz", "Archives"},
+    // Code types
+    {"cpp", "Code"}, {"h", "Code"}, {"hpp", "Code"}, {"java", "Code"}, {"py", "Code"},
+    {"js", "Code"}, {"html", "Code"}, {"css", "Code"},
+};
+
+// Extensions that say little about the format of a file (see isUntrusted)
+constexpr const char* kUntrustedExtensions[] = {
+    "txt", "dat", "data", "bin", "tmp", "temp", "part", "download", "crdownload",
+};
+
+const std::string kOthers = "Others";
+
+std::string_view trim(std::string_view text) {
+    const char* whitespace = " \t\r\n";
+    const size_t first = text.find_first_not_of(whitespace);
+    if (first == std::string_view::npos) return {};
+    const size_t last = text.find_last_not_of(whitespace);
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+FileTypeClassifier::FileTypeClassifier() {
+    categories.push_back(kOthers);
+    slots.resize(128);
+    for (const auto& type : kBuiltInTypes) {
+        addRule(type.extension, type.category);
+    }
+}
+
+const FileTypeClassifier& FileTypeClassifier::builtIn() {
+    static const FileTypeClassifier instance;
+    return instance;
+}
+
+void FileTypeClassifier::loadRules(const std::filesystem::path& rulesFile) {
+    std::ifstream in(rulesFile);
+    if (!in) {
+        throw std::runtime_error("Cannot open types file " + rulesFile.string());
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        std::string_view text(line);
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) continue;
+
+        auto error = [&](const std::string& reason) {
+            return std::runtime_error(rulesFile.string() + ":" + std::to_string(lineNumber) + ": " + reason);
+        };
+
+        const size_t colon = text.find(':');
+        if (colon == std::string_view::npos) {
+            throw error("expected \"Category: .ext ...\"");
+        }
+        const std::string category(trim(text.substr(0, colon)));
+
+        std::string_view extensions = text.substr(colon + 1);
+        bool any = false;
+        while (!extensions.empty()) {
+            const size_t start = extensions.find_first_not_of(" \t,");
+            if (start == std::string_view::npos) break;
+            extensions.remove_prefix(start);
+            const size_t end = std::min(extensions.find_first_of(" \t,"), extensions.size());
+            try {
+                addRule(extensions.substr(0, end), category);
+            } catch (const std::invalid_argument& e) {
+                throw error(e.what());
+            }
+            extensions.remove_prefix(end);
+            any = true;
+        }
+        if (!any) {
+            throw error("category \"" + category + "\" has no extensions");
+        }
+    }
+}
+
+void FileTypeClassifier::addRule(std::string_view extension, const std::string& category) {
+    if (!isValidCategory(category)) {
+        throw std::invalid_argument("invalid category name \"" + category + "\"");
+    }
+
+    char key[kMaxExtensionLength];
+    const size_t length = fold(extension, key);
+    if (length == 0) {
+        throw std::invalid_argument("invalid extension \"" + std::string(extension) + "\" (1-" +
+                                    std::to_string(kMaxExtensionLength) + " characters)");
+    }
+    insert(key, length, categoryIndex(category));
+}
+
+const std::string& FileTypeClassifier::classify(std::string_view extension) const {
+    char key[kMaxExtensionLength];
+    const size_t length = fold(extension, key);
+    if (length == 0) {
+        return categories[0];
+    }
+    const Slot* slot = find(key, length);
+    return slot ? categories[slot->category] : categories[0];
+}
+
+bool FileTypeClassifier::isKnown(std::string_view extension) const {
+    return &classify(extension) != &categories[0];
+}
+
+bool FileTypeClassifier::isUntrusted(std::string_view extension) {
+    char key[kMaxExtensionLength];
+    const size_t length = fold(extension, key);
+    for (const char* untrusted : kUntrustedExtensions) {
+        if (length == std::strlen(untrusted) && std::memcmp(key, untrusted, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FileTypeClassifier::isValidCategory(const std::string& category) {
+    if (category.empty() || category.front() == '/') {
+        return false;
+    }
+    for (const auto& part : std::filesystem::path(category)) {
+        if (part == "..") return false;
+    }
+    return true;
+}
+
+uint64_t FileTypeClassifier::fingerprint() const {
+    XxHash64 hash;
+    for (const Slot& slot : slots) {
+        if (slot.length == 0) continue;
+        const std::string& category = categories[slot.category];
+        hash.update(&slot.length, sizeof(slot.length));
+        hash.update(slot.key, slot.length);
+        hash.update(category.c_str(), category.size() + 1);
+    }
+    return hash.digest();
+}
+
+size_t FileTypeClassifier::fold(std::string_view extension, char (&key)[kMaxExtensionLength]) {
+    if (!extension.empty() && extension.front() == '.') {
+        extension.remove_prefix(1);
+    }
+    if (extension.empty() || extension.size() > kMaxExtensionLength) {
+        return 0;
+    }
+    for (size_t i = 0; i < extension.size(); ++i) {
+        const char c = extension[i];
+        key[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    return extension.size();
+}
+
+uint64_t FileTypeClassifier::hash(const char* key, size_t length) {
+    // FNV-1a; extensions are a handful of bytes, so anything fancier would not pay off
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+const FileTypeClassifier::Slot* FileTypeClassifier::find(const char* key, size_t length) const {
+    const size_t mask = slots.size() - 1;
+    for (size_t i = hash(key, length) & mask;; i = (i + 1) & mask) {
+        const Slot& slot = slots[i];
+        if (slot.length == 0) {
+            return nullptr;
+        }
+        if (slot.length == length && std::memcmp(slot.key, key, length) == 0) {
+            return &slot;
+        }
+    }
+}
+
+uint16_t FileTypeClassifier::categoryIndex(const std::string& category) {
+    auto it = std::find(categories.begin(), categories.end(), category);
+    if (it != categories.end()) {
+        return static_cast<uint16_t>(it - categories.begin());
+    }
+    if (categories.size() > UINT16_MAX) {
+        throw std::invalid_argument("too many categories");
+    }
+    categories.push_back(category);
+    return static_cast<uint16_t>(categories.size() - 1);
+}
+
+void FileTypeClassifier::insert(const char* key, size_t length, uint16_t category) {
+    if (Slot* existing = const_cast<Slot*>(find(key, length))) {
+        existing->category = category;
+        return;
+    }
+    if ((used + 1) * 2 > slots.size()) {
+        grow();
+    }
+
+    const size_t mask = slots.size() - 1;
+    size_t i = hash(key, length) & mask;
+    while (slots[i].length != 0) {
+        i = (i + 1) & mask;
+    }
+    std::memcpy(slots[i].key, key, length);
+    slots[i].length = static_cast<uint8_t>(length);
+    slots[i].category = category;
+    ++used;
+}
+
+void FileTypeClassifier::grow() {
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    used = 0;
+    for (const Slot& slot : old) {
+        if (slot.length != 0) {
+            insert(slot.key, slot.length, slot.category);
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class FileTypeClassifier
+ * @brief Maps file extensions to category directories through a flat hash table.
+ *
+ * The classifier starts from a built-in table of common extensions (compiled in as
+ * constexpr data) and can be extended at startup with user rules, so new categories
+ * such as RAW photo formats need no rebuild.
+ *
+ * Extensions are case-folded into a fixed-size key on the stack and looked up in an
+ * open-addressing table with linear probing, so classify() never allocates.
+ *
+ * Rules files contain one category per line, followed by a colon and the extensions
+ * that belong to it, separated by spaces or commas. A leading dot is optional, and
+ * '#' starts a comment:
+ *
+ *     # Camera RAW formats
+ *     RawPhotos: .cr2 .cr3 .nef .arw .dng
+ *     Images: heic, avif
+ *
+ * A user rule overrides the built-in category of the same extension.
+ */
+class FileTypeClassifier {
+public:
+    /// Extensions longer than this (without the dot) are never matched.
+    static constexpr size_t kMaxExtensionLength = 15;
+
+    /**
+     * @brief Builds a classifier containing the built-in table.
+     */
+    FileTypeClassifier();
+
+    /**
+     * @brief Gets a shared classifier containing only the built-in table.
+     */
+    static const FileTypeClassifier& builtIn();
+
+    /**
+     * @brief Adds the rules of a rules file.
+     *
+     * @param rulesFile The path of the file to read.
+     * @throws std::runtime_error If the file cannot be read or a line is malformed;
+     *         the message names the file and line.
+     */
+    void loadRules(const std::filesystem::path& rulesFile);
+
+    /**
+     * @brief Maps an extension to a category, replacing any previous mapping.
+     *
+     * @param extension The extension, with or without the leading dot, in any case.
+     * @param category The category directory name.
+     * @throws std::invalid_argument If the extension or category is not usable.
+     */
+    void addRule(std::string_view extension, const std::string& category);
+
+    /**
+     * @brief Determines the category of an extension.
+     *
+     * The check is case-insensitive and does not allocate.
+     *
+     * @param extension The file extension, including the dot (e.g., ".jpg").
+     * @return The category (e.g., "Images"), or "Others" if the extension is unknown.
+     */
+    const std::string& classify(std::string_view extension) const;
+
+    /**
+     * @brief Checks whether an extension has a category other than "Others".
+     */
+    bool isKnown(std::string_view extension) const;
+
+    /**
+     * @brief Checks whether an extension is too generic to vouch for the content.
+     *
+     * ".txt", ".dat", ".bin", temporary files and partial downloads are often found on
+     * files of another format, such as an image saved by a browser. With --sniff these
+     * are read like files with an unknown extension.
+     */
+    static bool isUntrusted(std::string_view extension);
+
+    /**
+     * @brief Checks that a category name is a safe relative directory name.
+     *
+     * Nested categories such as "Images/Raw" are allowed; absolute paths and ".."
+     * components are not, since categories are created under the working directory.
+     */
+    static bool isValidCategory(const std::string& category);
+
+    /**
+     * @brief Hashes the rule set; equal rules added in the same order give equal values.
+     *
+     * Used to detect cached classifications that were made under other rules.
+     */
+    uint64_t fingerprint() const;
+
+private:
+    /// One table slot: a case-folded extension and the index of its category.
+    struct Slot {
+        char key[kMaxExtensionLength];
+        uint8_t length = 0;       ///< 0 marks an empty slot.
+        uint16_t category = 0;
+    };
+
+    std::vector<Slot> slots;               ///< Power-of-two sized, at most half full.
+    size_t used = 0;
+    std::vector<std::string> categories;   ///< Index 0 is "Others".
+
+    /**
+     * @brief Case-folds an extension (without its dot) into a fixed-size key.
+     *
+     * @return The key length, or 0 if the extension is empty or too long.
+     */
+    static size_t fold(std::string_view extension, char (&key)[kMaxExtensionLength]);
+
+    static uint64_t hash(const char* key, size_t length);
+
+    const Slot* find(const char* key, size_t length) const;
+    uint16_t categoryIndex(const std::string& category);
+    void insert(const char* key, size_t length, uint16_t category);
+    void grow();
+};
@@ -0,0 +1,287 @@
+#include "Journal.h"
+#include "utils/AtomicFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The start of a journal file, followed by the plan image and the records.
+ */
+struct Journal::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t planBytes;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'O', 'J', 'O', 'U', 'R', 'N', '\n'};
+
+// A record is the action index shifted left by two bits, or'ed with its kind. A
+// MISSING record has the level count in the low bits of its index part.
+constexpr unsigned kKindBits = 2;
+constexpr uint64_t kKindMask = (uint64_t(1) << kKindBits) - 1;
+constexpr unsigned kLevelBits = 8;
+constexpr uint64_t kLevelMask = (uint64_t(1) << kLevelBits) - 1;
+
+size_t recordIndex(uint64_t record) {
+    const uint64_t index = record >> kKindBits;
+    return static_cast<size_t>((record & kKindMask) == Journal::MISSING ? index >> kLevelBits : index);
+}
+
+[[noreturn]] void throwWriteError(const fs::path& file, int error) {
+    throw fs::filesystem_error("cannot write journal", file, std::error_code(error, std::generic_category()));
+}
+
+} // namespace
+
+Journal::~Journal() {
+    // Best effort; a lost batch is recovered by resume like after a crash
+    try {
+        flush();
+    } catch (const fs::filesystem_error&) {
+    }
+    close();
+}
+
+void Journal::create(const fs::path& journalFile, const Plan& plan) {
+    // Resume checks the filesystem itself, so the sources need no stamps
+    create(journalFile, PlanFile::serialize(plan, sizeof(Header), false));
+}
+
+void Journal::create(const fs::path& journalFile, const PlanFile& plan) {
+    std::vector<unsigned char> image(sizeof(Header));
+    image.insert(image.end(), plan.imageData(), plan.imageData() + plan.imageSize());
+    create(journalFile, std::move(image));
+}
+
+void Journal::create(const fs::path& journalFile, std::vector<unsigned char> image) {
+    close();
+    path = journalFile;
+
+    // The whole plan is the intent record: written and synced before anything runs
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.planBytes = image.size() - sizeof(Header);
+    std::memcpy(image.data(), &header, sizeof(Header));
+    AtomicFile::write(path, image);
+
+    planFile.load(path, sizeof(Header), header.planBytes);
+    state.assign(planFile.size(), 0);
+    missing.assign(planFile.size(), 0);
+    order.clear();
+    done = 0;
+    undone = 0;
+
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) {
+        throwWriteError(path, errno);
+    }
+    startCommitter();
+}
+
+void Journal::open(const fs::path& journalFile) {
+    close();
+    path = journalFile;
+    auto damaged = [this](const char* what) {
+        return std::runtime_error("Journal " + path.string() + " " + what);
+    };
+
+    std::ifstream in(path, std::ios::binary);
+    Header header{};
+    if (!in) {
+        throw damaged("cannot be read");
+    }
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw damaged("is not a journal");
+    }
+    if (header.version != kFormatVersion) {
+        throw damaged("was written by another version of FileOrganizer");
+    }
+    const uint64_t fileSize = fs::file_size(path);
+    if (header.planBytes > fileSize - sizeof(Header)) {
+        throw damaged("is truncated or damaged");
+    }
+    planFile.load(path, sizeof(Header), header.planBytes);
+    state.assign(planFile.size(), 0);
+    missing.assign(planFile.size(), 0);
+    order.clear();
+    done = 0;
+    undone = 0;
+
+    // Replay the records; a torn or invalid tail ends the journal
+    const uint64_t recordsStart = sizeof(Header) + header.planBytes;
+    uint64_t validEnd = recordsStart;
+    in.seekg(static_cast<std::streamoff>(recordsStart));
+    std::vector<uint64_t> chunk(8192);
+    bool valid = true;
+    while (valid && in) {
+        in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size() * sizeof(uint64_t)));
+        const size_t count = static_cast<size_t>(in.gcount()) / sizeof(uint64_t);
+        for (size_t i = 0; i < count; ++i) {
+            if ((chunk[i] & kKindMask) == 0 || recordIndex(chunk[i]) >= planFile.size()) {
+                valid = false;
+                break;
+            }
+            apply(chunk[i]);
+            validEnd += sizeof(uint64_t);
+        }
+    }
+    in.close();
+
+    if (validEnd != fileSize) {
+        fs::resize_file(path, validEnd);
+    }
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) {
+        throwWriteError(path, errno);
+    }
+    startCommitter();
+}
+
+std::vector<size_t> Journal::doneInOrder() const {
+    // An action undone and done again appears twice; its last record counts
+    std::vector<uint8_t> seen(state.size(), 0);
+    std::vector<size_t> result;
+    result.reserve(done);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        if (state[*it] == DONE && !seen[*it]) {
+            seen[*it] = 1;
+            result.push_back(*it);
+        }
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+void Journal::record(size_t index, RecordKind kind) {
+    append((static_cast<uint64_t>(index) << kKindBits) | kind);
+}
+
+void Journal::recordMissingLevels(size_t index, unsigned levels) {
+    const uint64_t payload = (static_cast<uint64_t>(index) << kLevelBits) | std::min(levels, kMaxMissingLevels);
+    append((payload << kKindBits) | MISSING);
+}
+
+void Journal::append(uint64_t value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (writeError != 0) {
+        throwWriteError(path, writeError);
+    }
+    apply(value);
+    buffer.push_back(value);
+    if (buffer.size() < kGroupSize) {
+        return;
+    }
+
+    // Hand the full batch over; only wait if the disk is far behind
+    committed.wait(lock, [this] { return pending.size() < kMaxPendingGroups || writeError != 0; });
+    pending.push_back(std::move(buffer));
+    buffer = std::vector<uint64_t>();
+    buffer.reserve(kGroupSize);
+    wakeCommitter.notify_one();
+}
+
+void Journal::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!buffer.empty()) {
+        pending.push_back(std::move(buffer));
+        buffer = std::vector<uint64_t>();
+        wakeCommitter.notify_one();
+    }
+    committed.wait(lock, [this] { return (pending.empty() && !writing) || !committer.joinable(); });
+    if (writeError != 0) {
+        throwWriteError(path, writeError);
+    }
+}
+
+void Journal::apply(uint64_t record) {
+    const size_t index = recordIndex(record);
+    const auto kind = static_cast<uint8_t>(record & kKindMask);
+    if (kind == MISSING) {
+        const auto levels = static_cast<uint8_t>((record >> kKindBits) & kLevelMask);
+        missing[index] = std::max(missing[index], levels);
+        return;
+    }
+    if (state[index] == DONE) --done;
+    if (state[index] == UNDONE) --undone;
+    state[index] = kind;
+    if (kind == DONE) {
+        ++done;
+        order.push_back(index);
+    } else {
+        ++undone;
+    }
+}
+
+void Journal::startCommitter() {
+    stopping = false;
+    writeError = 0;
+    committer = std::thread([this] { commitLoop(); });
+}
+
+void Journal::commitLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeCommitter.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            return;
+        }
+        // Batches are written one at a time and in order, so the file keeps the record order
+        std::vector<uint64_t> batch = std::move(pending.front());
+        pending.pop_front();
+        writing = true;
+        const bool failed = writeError != 0;
+        lock.unlock();
+        const int error = failed ? 0 : write(batch);
+        lock.lock();
+        writing = false;
+        if (error != 0 && writeError == 0) {
+            writeError = error;
+        }
+        committed.notify_all();
+    }
+}
+
+int Journal::write(const std::vector<uint64_t>& records) {
+    if (std::fwrite(records.data(), sizeof(uint64_t), records.size(), file) != records.size() ||
+        std::fflush(file) != 0) {
+        return errno != 0 ? errno : EIO;
+    }
+#ifdef __linux__
+    // One sync commits the whole group
+    if (::fdatasync(::fileno(file)) != 0) {
+        return errno;
+    }
+#endif
+    return 0;
+}
+
+void Journal::close() {
+    if (committer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCommitter.notify_all();
+        committer.join();
+    }
+    pending.clear();
+    buffer.clear();
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Plan.h"
+#include "PlanFile.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class Journal
+ * @brief An append-only record of a plan's execution, for --resume and --undo.
+ *
+ * A journal starts with the whole plan (a PlanFile image), written and synced
+ * before the first action runs. Each run then records how many levels of every
+ * directory it is about to create are missing, so undo removes only what the run
+ * made. After that, one 8-byte record is appended per completed action, or per
+ * action later undone. Records are group-committed: they are buffered and written
+ * with a single fdatasync per kGroupSize actions, so durability costs one sync per
+ * batch rather than one per action. A committer thread does the writing, so the
+ * threads executing actions never wait for the disk unless it falls more than
+ * kMaxPendingGroups batches behind.
+ *
+ * A crash can lose at most the last uncommitted batch of records. Resuming treats
+ * those actions as not done and checks the filesystem instead: a move whose
+ * source is gone and whose destination exists has already happened. Every other
+ * action is safe to repeat.
+ *
+ * record() and recordMissingLevels() are thread-safe; the other methods are not.
+ */
+class Journal {
+public:
+    /// Bump whenever the file layout changes.
+    static constexpr uint32_t kFormatVersion = 2;
+    /// The number of records written per sync.
+    static constexpr size_t kGroupSize = 4096;
+    /// The number of full batches that may wait for the committer.
+    static constexpr size_t kMaxPendingGroups = 4;
+    /// The most missing levels recorded for one directory; deeper ones are capped.
+    static constexpr unsigned kMaxMissingLevels = 255;
+
+    enum RecordKind : uint64_t {
+        DONE = 1,     ///< The action was executed.
+        UNDONE = 2,   ///< The action was reverted by --undo.
+        MISSING = 3   ///< Levels of a CREATE_DIR action's directory missing before it ran.
+    };
+
+    Journal() = default;
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    /**
+     * @brief Starts a new journal for a plan, replacing any file of that name.
+     *
+     * @throws std::filesystem::filesystem_error If the journal cannot be written.
+     */
+    void create(const std::filesystem::path& file, const Plan& plan);
+
+    /**
+     * @brief Starts a new journal for a saved plan, replacing any file of that name.
+     *
+     * @throws std::filesystem::filesystem_error If the journal cannot be written.
+     */
+    void create(const std::filesystem::path& file, const PlanFile& plan);
+
+    /**
+     * @brief Opens an existing journal to continue it.
+     *
+     * A torn record at the end, left by a crash, is ignored and overwritten.
+     *
+     * @throws std::runtime_error If the file is not a journal or is damaged.
+     * @throws std::filesystem::filesystem_error If it cannot be opened for appending.
+     */
+    void open(const std::filesystem::path& file);
+
+    /**
+     * @brief The journaled plan, mapped from the journal file.
+     */
+    const PlanFile& plan() const { return planFile; }
+
+    /**
+     * @brief Whether an action is recorded as done (and not undone).
+     */
+    bool isDone(size_t index) const { return state[index] == DONE; }
+
+    /**
+     * @brief The number of actions recorded as done (and not undone).
+     */
+    size_t doneCount() const { return done; }
+
+    /**
+     * @brief The number of actions recorded as undone.
+     */
+    size_t undoneCount() const { return undone; }
+
+    /**
+     * @brief The done actions, in the order they were recorded.
+     */
+    std::vector<size_t> doneInOrder() const;
+
+    /**
+     * @brief How many levels of a CREATE_DIR action's directory, itself first, did
+     *        not exist before the run: the directories it creates.
+     *
+     * A resumed run records again what is still missing; the most recorded counts.
+     */
+    unsigned missingLevels(size_t index) const { return missing[index]; }
+
+    /**
+     * @brief Appends a record; written out with the next group commit.
+     *
+     * @throws std::filesystem::filesystem_error If an earlier group commit failed.
+     */
+    void record(size_t index, RecordKind kind);
+
+    /**
+     * @brief Appends a MISSING record; flush() before creating the directory.
+     *
+     * @throws std::filesystem::filesystem_error If an earlier group commit failed.
+     */
+    void recordMissingLevels(size_t index, unsigned levels);
+
+    /**
+     * @brief Writes and syncs the buffered records, waiting until they are on disk.
+     *
+     * @throws std::filesystem::filesystem_error If a write failed.
+     */
+    void flush();
+
+private:
+    struct Header;
+
+    std::filesystem::path path;
+    PlanFile planFile;
+    std::FILE* file = nullptr;         ///< Opened for appending records.
+    std::vector<uint8_t> state;        ///< The latest DONE or UNDONE per action; 0 if none.
+    std::vector<uint8_t> missing;      ///< The most MISSING levels recorded per action.
+    std::vector<size_t> order;         ///< Actions in the order their DONE records were read.
+    size_t done = 0;
+    size_t undone = 0;
+
+    // Group commit
+    std::mutex mutex;
+    std::condition_variable wakeCommitter;
+    std::condition_variable committed;
+    std::vector<uint64_t> buffer;                   ///< The batch being filled.
+    std::deque<std::vector<uint64_t>> pending;      ///< Full batches, oldest first.
+    bool writing = false;                           ///< The committer holds a batch.
+    bool stopping = false;
+    int writeError = 0;                             ///< The errno of the first failed commit.
+    std::thread committer;
+
+    void create(const std::filesystem::path& file, std::vector<unsigned char> image);
+    void append(uint64_t record);
+    void apply(uint64_t record);
+    void startCommitter();
+    void commitLoop();
+    int write(const std::vector<uint64_t>& records);
+    void close();
+};
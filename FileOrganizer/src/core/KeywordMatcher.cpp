@@ -0,0 +1,222 @@
+#include "KeywordMatcher.h"
+#include "FileTypeClassifier.h"
+#include "utils/XxHash64.h"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+struct BuiltInKeyword {
+    const char* keyword;
+    const char* folder;
+};
+
+// The keywords FileOrganizer has always known about, highest priority first
+constexpr BuiltInKeyword kBuiltInKeywords[] = {
+    {"wallpaper", "Wallpapers"},
+    {"wallpapers", "Wallpapers"},
+    {"screenshot", "Screenshots"},
+    {"snap", "Screenshots"},
+};
+
+const std::string kNone;
+
+char foldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string_view trim(std::string_view text) {
+    const char* whitespace = " \t\r\n";
+    const size_t first = text.find_first_not_of(whitespace);
+    if (first == std::string_view::npos) return {};
+    const size_t last = text.find_last_not_of(whitespace);
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+KeywordMatcher::KeywordMatcher() {
+    uint32_t rank = kBuiltInRank;
+    for (const auto& rule : kBuiltInKeywords) {
+        add(rule.keyword, rule.folder, rank++);
+    }
+    compile();
+}
+
+const KeywordMatcher& KeywordMatcher::builtIn() {
+    static const KeywordMatcher instance;
+    return instance;
+}
+
+void KeywordMatcher::loadRules(const std::filesystem::path& rulesFile) {
+    std::ifstream in(rulesFile);
+    if (!in) {
+        throw std::runtime_error("Cannot open keywords file " + rulesFile.string());
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        std::string_view text(line);
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) continue;
+
+        auto error = [&](const std::string& reason) {
+            return std::runtime_error(rulesFile.string() + ":" + std::to_string(lineNumber) + ": " + reason);
+        };
+
+        const size_t colon = text.find(':');
+        if (colon == std::string_view::npos) {
+            throw error("expected \"Folder: keyword, ...\"");
+        }
+        const std::string folder(trim(text.substr(0, colon)));
+
+        std::string_view keywords = text.substr(colon + 1);
+        bool any = false;
+        while (!keywords.empty()) {
+            const size_t comma = std::min(keywords.find(','), keywords.size());
+            const std::string_view keyword = trim(keywords.substr(0, comma));
+            keywords.remove_prefix(std::min(comma + 1, keywords.size()));
+            if (keyword.empty()) continue;
+            try {
+                add(keyword, folder, nextUserRank++);
+            } catch (const std::invalid_argument& e) {
+                throw error(e.what());
+            }
+            any = true;
+        }
+        if (!any) {
+            throw error("folder \"" + folder + "\" has no keywords");
+        }
+    }
+    compile();
+}
+
+void KeywordMatcher::addRule(std::string_view keyword, const std::string& folder) {
+    add(keyword, folder, nextUserRank++);
+    compile();
+}
+
+const std::string& KeywordMatcher::match(std::string_view filename) const {
+    uint32_t state = 0;
+    uint32_t best = kNoMatch;
+    for (char c : filename) {
+        state = transitions[state * classCount + byteClass[static_cast<unsigned char>(c)]];
+        const uint32_t candidate = bestRule[state];
+        if (candidate != kNoMatch && (best == kNoMatch || rules[candidate].rank < rules[best].rank)) {
+            best = candidate;
+            if (rules[best].rank == topRank) break;  // Nothing can beat it
+        }
+    }
+    return best == kNoMatch ? kNone : folders[rules[best].folder];
+}
+
+uint64_t KeywordMatcher::fingerprint() const {
+    XxHash64 hash;
+    for (const Rule& rule : rules) {
+        const std::string& folder = folders[rule.folder];
+        hash.update(rule.keyword.c_str(), rule.keyword.size() + 1);
+        hash.update(folder.c_str(), folder.size() + 1);
+        hash.update(&rule.rank, sizeof(rule.rank));
+    }
+    return hash.digest();
+}
+
+void KeywordMatcher::add(std::string_view keyword, const std::string& folder, uint32_t rank) {
+    if (keyword.empty()) {
+        throw std::invalid_argument("empty keyword");
+    }
+    if (!FileTypeClassifier::isValidCategory(folder)) {
+        throw std::invalid_argument("invalid folder name \"" + folder + "\"");
+    }
+
+    Rule rule;
+    rule.keyword.reserve(keyword.size());
+    for (char c : keyword) {
+        rule.keyword += foldCase(c);
+    }
+    rule.rank = rank;
+
+    auto it = std::find(folders.begin(), folders.end(), folder);
+    rule.folder = static_cast<uint32_t>(it - folders.begin());
+    if (it == folders.end()) {
+        folders.push_back(folder);
+    }
+    rules.push_back(std::move(rule));
+}
+
+void KeywordMatcher::compile() {
+    // Compress the alphabet: only bytes that occur in some keyword get their own class,
+    // and upper- and lower-case letters share one
+    std::fill(std::begin(byteClass), std::end(byteClass), 0);
+    classCount = 1;
+    for (const Rule& rule : rules) {
+        for (char c : rule.keyword) {
+            const auto byte = static_cast<unsigned char>(c);
+            if (byteClass[byte] == 0) {
+                byteClass[byte] = static_cast<uint8_t>(classCount++);
+                if (c >= 'a' && c <= 'z') {
+                    byteClass[static_cast<unsigned char>(c - 'a' + 'A')] = byteClass[byte];
+                }
+            }
+        }
+    }
+
+    // Build the trie; kNoMatch marks a missing edge until the failure links fill it in
+    transitions.assign(classCount, kNoMatch);
+    bestRule.assign(1, kNoMatch);
+    topRank = kNoMatch;
+    for (uint32_t r = 0; r < rules.size(); ++r) {
+        uint32_t state = 0;
+        for (char c : rules[r].keyword) {
+            const size_t edge = state * classCount + byteClass[static_cast<unsigned char>(c)];
+            if (transitions[edge] == kNoMatch) {
+                transitions[edge] = static_cast<uint32_t>(bestRule.size());
+                transitions.resize(transitions.size() + classCount, kNoMatch);
+                bestRule.push_back(kNoMatch);
+            }
+            state = transitions[edge];
+        }
+        if (bestRule[state] == kNoMatch || rules[r].rank < rules[bestRule[state]].rank) {
+            bestRule[state] = r;
+        }
+        topRank = std::min(topRank, rules[r].rank);
+    }
+
+    auto better = [this](uint32_t a, uint32_t b) {
+        if (a == kNoMatch) return b;
+        if (b == kNoMatch) return a;
+        return rules[a].rank <= rules[b].rank ? a : b;
+    };
+
+    // Breadth-first: complete the transition function and fold in the outputs of
+    // each state's failure chain, so matching never has to follow failure links
+    std::vector<uint32_t> fail(bestRule.size(), 0);
+    std::deque<uint32_t> queue;
+    for (size_t c = 0; c < classCount; ++c) {
+        uint32_t& next = transitions[c];
+        if (next == kNoMatch) {
+            next = 0;
+        } else {
+            queue.push_back(next);
+        }
+    }
+    while (!queue.empty()) {
+        const uint32_t state = queue.front();
+        queue.pop_front();
+        bestRule[state] = better(bestRule[state], bestRule[fail[state]]);
+        for (size_t c = 0; c < classCount; ++c) {
+            uint32_t& next = transitions[state * classCount + c];
+            const uint32_t fallback = transitions[fail[state] * classCount + c];
+            if (next == kNoMatch) {
+                next = fallback;
+            } else {
+                fail[next] = fallback;
+                queue.push_back(next);
+            }
+        }
+    }
+}
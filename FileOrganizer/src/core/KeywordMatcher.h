@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class KeywordMatcher
+ * @brief Finds keyword rules in filenames with a case-insensitive Aho-Corasick automaton.
+ *
+ * Each rule maps a keyword to a target folder. All keywords are compiled into a
+ * single deterministic automaton over a compressed byte alphabet, so matching a
+ * filename is one pass over its bytes no matter how many rules there are.
+ *
+ * When several keywords occur in the same name, the rule with the highest priority
+ * wins, regardless of where in the name it occurs. Rules loaded from a file take
+ * priority over the built-in ones, in the order they appear in the file; among the
+ * built-in rules, Wallpapers wins over Screenshots as it always has.
+ *
+ * Rules files contain one folder per line, followed by a colon and a comma-separated
+ * list of keywords; '#' starts a comment:
+ *
+ *     # Client work
+ *     Clients/Acme: acme, acm-
+ *     Projects/P-1042: p1042, p-1042
+ */
+class KeywordMatcher {
+public:
+    /**
+     * @brief Builds a matcher containing the built-in rules.
+     */
+    KeywordMatcher();
+
+    /**
+     * @brief Gets a shared matcher containing only the built-in rules.
+     */
+    static const KeywordMatcher& builtIn();
+
+    /**
+     * @brief Adds the rules of a rules file and recompiles the automaton once.
+     *
+     * @param rulesFile The path of the file to read.
+     * @throws std::runtime_error If the file cannot be read or a line is malformed;
+     *         the message names the file and line.
+     */
+    void loadRules(const std::filesystem::path& rulesFile);
+
+    /**
+     * @brief Adds a rule ranked below all user rules added before it, and recompiles.
+     *
+     * @param keyword The keyword; matched case-insensitively anywhere in a name.
+     * @param folder The target folder for names containing the keyword.
+     * @throws std::invalid_argument If the keyword is empty or the folder is not usable.
+     */
+    void addRule(std::string_view keyword, const std::string& folder);
+
+    /**
+     * @brief Finds the highest-priority keyword contained in a filename.
+     *
+     * @param filename The name of the file (without path or extension).
+     * @return The target folder of the winning rule, or an empty string if none matches.
+     */
+    const std::string& match(std::string_view filename) const;
+
+    /**
+     * @brief Gets the number of rules.
+     */
+    size_t ruleCount() const { return rules.size(); }
+
+    /**
+     * @brief Hashes the rule set; equal rules added in the same order give equal values.
+     */
+    uint64_t fingerprint() const;
+
+private:
+    struct Rule {
+        std::string keyword;    ///< Case-folded.
+        uint32_t rank;          ///< Lower wins.
+        uint32_t folder;        ///< Index into `folders`.
+    };
+
+    static constexpr uint32_t kNoMatch = UINT32_MAX;
+    static constexpr uint32_t kBuiltInRank = 1u << 30;  ///< Built-in rules rank after user rules.
+
+    std::vector<Rule> rules;
+    std::vector<std::string> folders;
+    uint32_t nextUserRank = 0;
+
+    // The compiled automaton
+    uint8_t byteClass[256] = {};          ///< Byte -> alphabet class (0 = not in any keyword).
+    size_t classCount = 1;
+    std::vector<uint32_t> transitions;    ///< state * classCount + class -> next state.
+    std::vector<uint32_t> bestRule;       ///< state -> best rule ending here (or kNoMatch).
+    uint32_t topRank = kNoMatch;          ///< The best rank of all; lets match() stop early.
+
+    void add(std::string_view keyword, const std::string& folder, uint32_t rank);
+    void compile();
+};
@@ -0,0 +1,389 @@
+#include "MetadataDate.h"
+#include "DateScanner.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Files handed to one pool task; large enough to amortize the task, small enough to balance.
+constexpr size_t kBatchSize = 32;
+
+/// Seconds from 1904-01-01, the QuickTime epoch, to 1970-01-01.
+constexpr uint64_t kMovieEpochOffset = 2082844800;
+
+/// Caps on the structures walked, so a corrupt file cannot keep a reader busy.
+constexpr int kMaxSegments = 64;
+constexpr int kMaxBoxes = 256;
+constexpr uint16_t kMaxIfdEntries = 512;
+
+constexpr uint16_t kTagExifIfd = 0x8769;
+constexpr uint16_t kTagDateTimeOriginal = 0x9003;
+constexpr uint16_t kTagDateTimeDigitized = 0x9004;
+constexpr uint16_t kTypeAscii = 2;
+constexpr uint16_t kTypeLong = 4;
+
+/// The length of "YYYY:MM:DD HH:MM:SS".
+constexpr size_t kExifDateLength = 19;
+
+enum class Format { NONE, JPEG, TIFF, MOVIE };
+
+Format formatOf(std::string_view ext) {
+    std::string lower(ext);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (lower == ".jpg" || lower == ".jpeg" || lower == ".jpe") return Format::JPEG;
+    if (lower == ".tif" || lower == ".tiff" || lower == ".dng" || lower == ".cr2" ||
+        lower == ".nef" || lower == ".arw" || lower == ".pef" || lower == ".srw") return Format::TIFF;
+    if (lower == ".mp4" || lower == ".m4v" || lower == ".mov" || lower == ".3gp" ||
+        lower == ".3g2") return Format::MOVIE;
+    return Format::NONE;
+}
+
+/**
+ * @brief A file opened for reading metadata: its first kHeaderBytes are read at
+ *        once, anything further in is read on demand.
+ */
+class Source {
+public:
+    explicit Source(const fs::path& file) {
+#ifdef __linux__
+        // O_NOATIME keeps the read from dirtying inodes, but is only allowed on our own files
+        fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0 && errno == EPERM) {
+            fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            fileSize = static_cast<uint64_t>(st.st_size);
+        }
+#else
+        in.open(file, std::ios::binary | std::ios::ate);
+        if (!in) {
+            return;
+        }
+        fileSize = static_cast<uint64_t>(in.tellg());
+#endif
+        headerLength = static_cast<size_t>(std::min<uint64_t>(fileSize, MetadataDate::kHeaderBytes));
+        if (!readFile(0, header.data(), headerLength)) {
+            headerLength = 0;
+        }
+    }
+
+    ~Source() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    uint64_t size() const { return fileSize; }
+
+    /**
+     * @brief Reads exactly `length` bytes at `offset`; false if the file is shorter.
+     */
+    bool read(uint64_t offset, void* out, size_t length) {
+        if (offset > fileSize || length > fileSize - offset) {
+            return false;
+        }
+        if (offset + length <= headerLength) {
+            std::memcpy(out, header.data() + offset, length);
+            return true;
+        }
+        return readFile(offset, static_cast<char*>(out), length);
+    }
+
+private:
+#ifdef __linux__
+    int fd = -1;
+#else
+    std::ifstream in;
+#endif
+    uint64_t fileSize = 0;
+    std::array<char, MetadataDate::kHeaderBytes> header;
+    size_t headerLength = 0;
+
+    bool readFile(uint64_t offset, char* out, size_t length) {
+#ifdef __linux__
+        size_t total = 0;
+        while (total < length) {
+            const ssize_t n = ::pread(fd, out + total, length - total, static_cast<off_t>(offset + total));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            total += static_cast<size_t>(n);
+        }
+        return true;
+#else
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset));
+        in.read(out, static_cast<std::streamsize>(length));
+        return static_cast<size_t>(in.gcount()) == length;
+#endif
+    }
+};
+
+uint16_t bigEndian16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] << 8 | p[1]);
+}
+
+uint32_t bigEndian32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 | p[3];
+}
+
+uint64_t bigEndian64(const unsigned char* p) {
+    return static_cast<uint64_t>(bigEndian32(p)) << 32 | bigEndian32(p + 4);
+}
+
+/**
+ * @brief Reads the EXIF date of a TIFF structure starting at `base`.
+ *
+ * Offsets inside a TIFF structure are relative to its start, which for a JPEG is
+ * just past the "Exif\0\0" marker of its APP1 segment.
+ */
+class TiffReader {
+public:
+    TiffReader(Source& source, uint64_t base) : source(source), base(base) {}
+
+    std::string date() {
+        unsigned char head[8];
+        if (!source.read(base, head, sizeof(head))) return "";
+        if (head[0] == 'I' && head[1] == 'I') {
+            littleEndian = true;
+        } else if (!(head[0] == 'M' && head[1] == 'M')) {
+            return "";
+        }
+        if (get16(head + 2) != 42) return "";
+
+        Entry exifIfd;
+        if (!findTag(get32(head + 4), kTagExifIfd, exifIfd) || exifIfd.type != kTypeLong) return "";
+        const uint32_t exifOffset = get32(exifIfd.value);
+
+        // A camera writes DateTimeOriginal; a scanner only DateTimeDigitized
+        for (uint16_t tag : {kTagDateTimeOriginal, kTagDateTimeDigitized}) {
+            Entry entry;
+            if (!findTag(exifOffset, tag, entry) || entry.type != kTypeAscii || entry.count < kExifDateLength) {
+                continue;
+            }
+            char text[kExifDateLength];
+            if (!source.read(base + get32(entry.value), text, sizeof(text))) continue;
+            std::string date = MetadataDate::fromExifDate(std::string_view(text, sizeof(text)));
+            if (!date.empty()) return date;
+        }
+        return "";
+    }
+
+private:
+    struct Entry {
+        uint16_t type = 0;
+        uint32_t count = 0;
+        unsigned char value[4] = {};
+    };
+
+    Source& source;
+    uint64_t base;
+    bool littleEndian = false;
+
+    uint16_t get16(const unsigned char* p) const {
+        return littleEndian ? static_cast<uint16_t>(p[1] << 8 | p[0]) : bigEndian16(p);
+    }
+
+    uint32_t get32(const unsigned char* p) const {
+        return littleEndian ? static_cast<uint32_t>(p[3]) << 24 | static_cast<uint32_t>(p[2]) << 16 |
+                                  static_cast<uint32_t>(p[1]) << 8 | p[0]
+                            : bigEndian32(p);
+    }
+
+    // Looks a tag up in the directory at `offset`; the directory is read in one go
+    bool findTag(uint32_t offset, uint16_t tag, Entry& found) {
+        unsigned char countBytes[2];
+        if (offset == 0 || !source.read(base + offset, countBytes, sizeof(countBytes))) return false;
+        const uint16_t count = std::min(get16(countBytes), kMaxIfdEntries);
+        std::vector<unsigned char> entries(static_cast<size_t>(count) * 12);
+        if (!source.read(base + offset + 2, entries.data(), entries.size())) return false;
+        for (uint16_t i = 0; i < count; ++i) {
+            const unsigned char* entry = entries.data() + i * 12;
+            if (get16(entry) == tag) {
+                found.type = get16(entry + 2);
+                found.count = get32(entry + 4);
+                std::memcpy(found.value, entry + 8, 4);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief Walks the segments of a JPEG to its EXIF segment; stops at the image data.
+ */
+std::string readJpeg(Source& source) {
+    unsigned char marker[4];
+    if (!source.read(0, marker, 2) || marker[0] != 0xFF || marker[1] != 0xD8) return "";
+    uint64_t offset = 2;
+    for (int i = 0; i < kMaxSegments && source.read(offset, marker, sizeof(marker)); ++i) {
+        if (marker[0] != 0xFF) return "";
+        const unsigned type = marker[1];
+        if (type == 0xFF) {  // Fill byte before the marker
+            offset += 1;
+            continue;
+        }
+        if (type == 0xDA || type == 0xD9) return "";  // Start of scan, end of image
+        const uint16_t length = bigEndian16(marker + 2);
+        if (length < 2) return "";
+        if (type == 0xE1 && length >= 8) {
+            char id[6];
+            if (source.read(offset + 4, id, sizeof(id)) && std::memcmp(id, "Exif\0\0", 6) == 0) {
+                return TiffReader(source, offset + 10).date();
+            }
+        }
+        offset += 2 + length;
+    }
+    return "";
+}
+
+/**
+ * @brief Walks the boxes of an MP4 or QuickTime file to moov/mvhd, skipping the
+ *        media data by its size.
+ */
+std::string readMovie(Source& source) {
+    uint64_t offset = 0;
+    uint64_t end = source.size();
+    bool inMovie = false;
+    for (int i = 0; i < kMaxBoxes && offset + 8 <= end; ++i) {
+        unsigned char box[16];
+        if (!source.read(offset, box, 8)) return "";
+        uint64_t size = bigEndian32(box);
+        uint64_t headerSize = 8;
+        if (size == 1) {
+            if (!source.read(offset + 8, box + 8, 8)) return "";
+            size = bigEndian64(box + 8);
+            headerSize = 16;
+        } else if (size == 0) {
+            size = end - offset;  // The box runs to the end of its parent
+        }
+        if (size < headerSize || size > end - offset) return "";
+
+        if (!inMovie && std::memcmp(box + 4, "moov", 4) == 0) {
+            inMovie = true;
+            end = offset + size;
+            offset += headerSize;
+            continue;
+        }
+        if (inMovie && std::memcmp(box + 4, "mvhd", 4) == 0) {
+            unsigned char header[12];
+            if (!source.read(offset + headerSize, header, sizeof(header))) return "";
+            // Version 1 stores the times as 64 bits, version 0 as 32
+            const uint64_t created = header[0] == 1 ? bigEndian64(header + 4) : bigEndian32(header + 4);
+            return MetadataDate::fromMovieTime(created);
+        }
+        offset += size;
+    }
+    return "";
+}
+
+std::string readDate(const fs::path& file, Format format) {
+    if (format == Format::NONE) return "";
+    Source source(file);
+    switch (format) {
+        case Format::JPEG: return readJpeg(source);
+        case Format::TIFF: return TiffReader(source, 0).date();
+        case Format::MOVIE: return readMovie(source);
+        default: return "";
+    }
+}
+
+std::string formatYearMonth(int year, int month) {
+    std::string result(7, '/');
+    for (int k = 3; k >= 0; --k, year /= 10) {
+        result[static_cast<size_t>(k)] = static_cast<char>('0' + year % 10);
+    }
+    result[5] = static_cast<char>('0' + month / 10);
+    result[6] = static_cast<char>('0' + month % 10);
+    return result;
+}
+
+} // namespace
+
+bool MetadataDate::supports(std::string_view ext) {
+    return formatOf(ext) != Format::NONE;
+}
+
+std::string MetadataDate::read(const fs::path& file, std::string_view ext) {
+    return readDate(file, formatOf(ext));
+}
+
+std::vector<std::string> MetadataDate::readAll(const std::vector<fs::path>& files,
+                                               const std::vector<std::string>& exts, unsigned threadCount) {
+    std::vector<std::string> results(files.size());
+    if (files.empty()) {
+        return results;
+    }
+
+    const size_t batches = (files.size() + kBatchSize - 1) / kBatchSize;
+    const unsigned requested = threadCount > 0 ? threadCount : kDefaultReadThreads;
+    WorkStealingPool pool(static_cast<unsigned>(std::min<size_t>(requested, batches)));
+
+    // Each batch writes only its own slice of `results`, so no locking is needed
+    for (size_t begin = 0; begin < files.size(); begin += kBatchSize) {
+        const size_t end = std::min(begin + kBatchSize, files.size());
+        pool.submit([&files, &exts, &results, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                results[i] = readDate(files[i], formatOf(exts[i]));
+            }
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+std::string MetadataDate::fromExifDate(std::string_view text) {
+    if (text.size() < 10 || text[4] != ':' || text[7] != ':') return "";
+    int fields[3] = {};
+    const size_t starts[3] = {0, 5, 8};
+    const size_t lengths[3] = {4, 2, 2};
+    for (int f = 0; f < 3; ++f) {
+        for (size_t k = 0; k < lengths[f]; ++k) {
+            const char c = text[starts[f] + k];
+            if (c < '0' || c > '9') return "";  // Also rejects the "    :  :  " of an unset date
+            fields[f] = fields[f] * 10 + (c - '0');
+        }
+    }
+    if (!DateScanner::isValidDate(fields[0], fields[1], fields[2])) return "";
+    return formatYearMonth(fields[0], fields[1]);
+}
+
+std::string MetadataDate::fromMovieTime(uint64_t seconds) {
+    if (seconds <= kMovieEpochOffset) return "";
+    // Days since 1970-01-01 to a civil date (H. Hinnant's algorithm); no time zone involved
+    const int64_t days = static_cast<int64_t>((seconds - kMovieEpochOffset) / 86400);
+    const int64_t shifted = days + 719468;
+    const int64_t era = shifted / 146097;
+    const int64_t dayOfEra = shifted - era * 146097;
+    const int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    const int month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    const int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    if (year > 9999) return "";
+    return formatYearMonth(static_cast<int>(year), month);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class MetadataDate
+ * @brief Reads the date a photo or video was taken from the metadata in its header.
+ *
+ * For JPEG and TIFF-based files (TIFF, DNG and the TIFF-based raw formats), the date
+ * is the EXIF DateTimeOriginal tag, or DateTimeDigitized if it is missing. For MP4
+ * and QuickTime files, it is the creation time of the movie header box (mvhd).
+ *
+ * Nothing but the metadata is read. The first kHeaderBytes of a file are read at
+ * once, which covers the EXIF directories of almost every JPEG; anything past them
+ * (a directory further in, or the movie box of a video whose media data comes
+ * first) is fetched with a small pread of just the bytes needed. Top-level video
+ * boxes are skipped by their size, so the media data itself is never read.
+ *
+ * readAll() works like ContentSniffer::sniffAll(): the files are split into batches
+ * that run on a thread pool, so the reads of many files overlap.
+ */
+class MetadataDate {
+public:
+    /// The number of bytes read from the start of each file at once.
+    static constexpr size_t kHeaderBytes = 4096;
+
+    /// The default number of concurrent reads used by readAll().
+    static constexpr unsigned kDefaultReadThreads = 16;
+
+    /**
+     * @brief Checks whether files with this extension may carry a date this class reads.
+     *
+     * @param ext The extension, including the dot, in any case (e.g. ".JPG").
+     */
+    static bool supports(std::string_view ext);
+
+    /**
+     * @brief Reads the date a file was taken.
+     *
+     * @param file The file to read.
+     * @param ext Its extension, or the one implied by its content (see supports()).
+     * @return A string in "YYYY/MM" format, as for dates found in file names, or an
+     *         empty string if the file has no valid date or cannot be read.
+     */
+    static std::string read(const std::filesystem::path& file, std::string_view ext);
+
+    /**
+     * @brief Reads the dates of many files with batched, concurrent reads.
+     *
+     * @param files The files to read.
+     * @param exts The extension of each file (see read()).
+     * @param threadCount The number of concurrent readers; 0 means kDefaultReadThreads.
+     * @return One date per file, in the order of `files`; empty where none was found.
+     */
+    static std::vector<std::string> readAll(const std::vector<std::filesystem::path>& files,
+                                            const std::vector<std::string>& exts, unsigned threadCount = 0);
+
+    /**
+     * @brief Formats an EXIF date ("YYYY:MM:DD HH:MM:SS") as "YYYY/MM".
+     *
+     * @return An empty string if the text is not a valid date.
+     */
+    static std::string fromExifDate(std::string_view text);
+
+    /**
+     * @brief Formats an mvhd creation time (seconds since 1904-01-01 UTC) as "YYYY/MM".
+     *
+     * @return An empty string for 0 (not set) or a time before 1970.
+     */
+    static std::string fromMovieTime(uint64_t seconds);
+};
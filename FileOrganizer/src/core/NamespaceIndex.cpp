@@ -0,0 +1,48 @@
+#include "NamespaceIndex.h"
+#include "utils/Stats.h"
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+fs::path NamespaceIndex::claim(const fs::path& desired) {
+    const fs::path parent = desired.parent_path();
+    Directory& dir = directory(parent);
+
+    if (dir.names.insert(desired.filename().string()).second) {
+        return desired;
+    }
+
+    const std::string stem = desired.stem().string();
+    const std::string ext = desired.extension().string();
+
+    // '/' cannot appear in a filename, so it safely separates the two parts of the key
+    int& next = dir.nextSuffix[stem + '/' + ext];
+    if (next == 0) {
+        next = 1;
+    }
+
+    Stats::add(Stats::CONFLICTS_RESOLVED);
+
+    // Every suffix below `next` is known to be taken, and names are never released,
+    // so the first free candidate from here is the smallest free one overall.
+    std::string candidate;
+    while (true) {
+        candidate = stem + " (" + std::to_string(next++) + ")" + ext;
+        if (dir.names.insert(candidate).second) {
+            return parent / candidate;
+        }
+    }
+}
+
+NamespaceIndex::Directory& NamespaceIndex::directory(const fs::path& path) {
+    auto [it, inserted] = directories.try_emplace(path.string());
+    if (inserted) {
+        // One listing replaces all the per-candidate fs::exists probes for this directory
+        Stats::add(Stats::DIRECTORY_LISTINGS);
+        std::error_code ec;
+        for (fs::directory_iterator entries(path, ec), end; !ec && entries != end; entries.increment(ec)) {
+            it->second.names.insert(entries->path().filename().string());
+        }
+    }
+    return it->second;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @class NamespaceIndex
+ * @brief An in-memory view of the names taken in each destination directory.
+ *
+ * The first time a directory is used, its existing entries are read with a single
+ * directory listing. From then on every name handed out by claim() is recorded as
+ * well, so destinations planned earlier in the same Plan are seen as taken even
+ * though they do not exist on disk yet. Conflict resolution is then a matter of hash
+ * lookups instead of one filesystem probe per candidate name.
+ *
+ * For each stem and extension the index remembers the next "(N)" suffix to try, so
+ * a batch of identically named files costs O(1) per file instead of O(k).
+ *
+ * One index is meant to live for the planning of one Plan. It is not thread-safe.
+ */
+class NamespaceIndex {
+public:
+    /**
+     * @brief Claims a unique path as close as possible to the desired one.
+     *
+     * If `desired` is free it is returned unchanged; otherwise the result is
+     * "stem (N).ext" in the same directory with the smallest N that is free, which
+     * is the same name the old fs::exists loop would have picked.
+     *
+     * @param desired The desired destination path.
+     * @return A path that is neither on disk nor claimed before. It is now claimed.
+     */
+    std::filesystem::path claim(const std::filesystem::path& desired);
+
+    /**
+     * @brief Gets the number of directories whose contents have been loaded.
+     */
+    size_t loadedDirectories() const { return directories.size(); }
+
+private:
+    struct Directory {
+        std::unordered_set<std::string> names;            ///< Existing and claimed names.
+        std::unordered_map<std::string, int> nextSuffix;  ///< "stem/ext" -> next N to try.
+    };
+
+    std::unordered_map<std::string, Directory> directories; ///< Keyed by directory path.
+
+    /**
+     * @brief Gets the entry for a directory, listing it on first use.
+     *
+     * A directory that does not exist yet starts out empty.
+     */
+    Directory& directory(const std::filesystem::path& path);
+};
@@ -0,0 +1,37 @@
+#include "Organizer.h"
+
+namespace fs = std::filesystem;
+
+Organizer::Organizer(const OrganizerOptions& options)
+    : options(options), prototype(toArgs(options), fs::path(), false) {}
+
+Plan Organizer::plan(const fs::path& root, const ExecutionCallbacks& callbacks) const {
+    FileScanner::ErrorHandler onError;
+    if (callbacks.error) {
+        onError = [&callbacks](const fs::path& directory, const std::error_code& error) {
+            callbacks.error(nullptr, "cannot read directory " + directory.string() + ": " + error.message());
+        };
+    } else {
+        // Without a callback, unreadable directories are skipped silently
+        onError = [](const fs::path&, const std::error_code&) {};
+    }
+    return prototype.rootedAt(root).planOrganization(onError, options.scanThreads);
+}
+
+bool Organizer::execute(const Plan& plan, const ExecutionCallbacks& callbacks) const {
+    return FileOperator::executePlan(plan, options.jobs, nullptr, options.engine, &callbacks);
+}
+
+CommandLineArgs Organizer::toArgs(const OrganizerOptions& options) {
+    CommandLineArgs args;
+    args.recursive = options.recursive;
+    args.sniff = options.sniff;
+    args.metadataDates = options.metadataDates;
+    args.byMtime = options.byMtime;
+    args.dedupe = options.dedupe;
+    args.jobs = options.jobs;
+    args.ioUring = options.engine == ExecutionEngine::IO_URING;
+    args.typesFile = options.typesFile;
+    args.keywordsFile = options.keywordsFile;
+    return args;
+}
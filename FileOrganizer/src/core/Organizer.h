@@ -0,0 +1,73 @@
+#pragma once
+
+#include "FileOperator.h"
+#include "FileOrganizer.h"
+#include "Plan.h"
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief What an Organizer does, the library's counterpart of the command-line options.
+ */
+struct OrganizerOptions {
+    bool recursive = false;       ///< Also organize the files in subdirectories.
+    bool sniff = false;           ///< Detect the type of files with unknown or generic extensions from their content.
+    bool metadataDates = false;   ///< Date photos and videos without a date in their name by their metadata.
+    bool byMtime = false;         ///< Date files that have no other date by their modification time.
+    DedupeMode dedupe = DedupeMode::OFF; ///< What to do with identical files.
+    unsigned jobs = 1;            ///< Executor threads (0 = one per hardware thread).
+    unsigned scanThreads = 0;     ///< Threads of a recursive scan (0 = one per hardware thread).
+    ExecutionEngine engine = ExecutionEngine::THREADS; ///< How plans are executed.
+    std::string typesFile;        ///< Extra extension-to-category rules, loaded once.
+    std::string keywordsFile;     ///< Extra keyword-to-folder rules, loaded once.
+};
+
+/**
+ * @class Organizer
+ * @brief The entry point of the fileorganizer library: plans and executes the
+ *        organization of any directory, without printing.
+ *
+ * The rules are loaded once, when the organizer is built, and every call works on
+ * the root it is given rather than the current directory. The organizer holds no
+ * state between calls, so one long-lived instance can serve many directories, from
+ * several threads at once. Progress and errors go to the callbacks given with each
+ * call; nothing is written to the standard output or error.
+ *
+ * Two calls working on the same tree at the same time see each other's files
+ * move; that is for the caller to avoid.
+ */
+class Organizer {
+public:
+    /**
+     * @brief Builds an organizer and loads its rules files.
+     *
+     * @throws std::runtime_error If a rules file cannot be loaded.
+     */
+    explicit Organizer(const OrganizerOptions& options);
+
+    /**
+     * @brief Scans a directory and plans its organization.
+     *
+     * @param root The directory to organize.
+     * @param callbacks Receives the directories that cannot be read, as errors
+     *        without an action; they are left out of the plan.
+     * @return The plan; empty if there is nothing to organize.
+     * @throws std::filesystem::filesystem_error If `root` is not a directory.
+     */
+    Plan plan(const std::filesystem::path& root, const ExecutionCallbacks& callbacks = ExecutionCallbacks()) const;
+
+    /**
+     * @brief Executes a plan made by plan().
+     *
+     * @param plan The plan to execute.
+     * @param callbacks Receives the progress and the actions that failed.
+     * @return True if every action succeeded.
+     */
+    bool execute(const Plan& plan, const ExecutionCallbacks& callbacks = ExecutionCallbacks()) const;
+
+private:
+    OrganizerOptions options;
+    FileOrganizer prototype;   ///< Holds the loaded rules; copied for each root.
+
+    static CommandLineArgs toArgs(const OrganizerOptions& options);
+};
@@ -1,59 +1,121 @@
 #include "Plan.h"
+#include "utils/Log.h"
 #include <iostream>
 #include <iomanip>
 
+namespace fs = std::filesystem;
+
 void Plan::addAction(const Action& action) {
-    actions.push_back(action);
+    const fs::path sourceName = action.source.filename();
+    const fs::path destinationName = action.destination.filename();
+
+    types.push_back(static_cast<uint8_t>(action.type));
+    sourceDirs.push_back(internDirectory(action.source.parent_path()));
+    sourceNames.push_back(appendName(sourceName));
+    destinationDirs.push_back(internDirectory(action.destination.parent_path()));
+    // A MOVE usually keeps the name; store it once
+    destinationNames.push_back(destinationName == sourceName ? sourceNames.back() : appendName(destinationName));
+    ++counts[action.type];
+}
+
+Action Plan::action(size_t index) const {
+    fs::path source = fs::path(directory(sourceDirs[index])) / name(sourceNames[index]);
+    fs::path destination = fs::path(directory(destinationDirs[index])) / name(destinationNames[index]);
+    return Action(type(index), source, destination);
+}
+
+size_t Plan::memoryUsage() const {
+    const size_t bytes = types.capacity() * sizeof(uint8_t) +
+                         (sourceDirs.capacity() + sourceNames.capacity() +
+                          destinationDirs.capacity() + destinationNames.capacity()) * sizeof(uint32_t) +
+                         directoryBytes.capacity() + directoryEnds.capacity() * sizeof(uint64_t) +
+                         nameBytes.capacity() + nameEnds.capacity() * sizeof(uint64_t);
+    // One hash node per directory
+    return bytes + directoryIds.size() * (sizeof(std::pair<const size_t, uint32_t>) + 2 * sizeof(void*)) +
+           directoryIds.bucket_count() * sizeof(void*);
+}
+
+uint32_t Plan::internDirectory(const fs::path& path) {
+    const std::string text = path.string();
+    const size_t hash = std::hash<std::string_view>()(text);
+    auto [first, last] = directoryIds.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        if (directory(it->second) == text) {
+            return it->second;
+        }
+    }
+    const uint32_t id = static_cast<uint32_t>(directoryEnds.size());
+    directoryBytes += text;
+    directoryEnds.push_back(directoryBytes.size());
+    directoryIds.emplace(hash, id);
+    return id;
+}
+
+uint32_t Plan::appendName(const fs::path& name) {
+    nameBytes += name.native();
+    nameEnds.push_back(nameBytes.size());
+    return static_cast<uint32_t>(nameEnds.size() - 1);
+}
+
+std::string_view Plan::name(uint32_t id) const {
+    const size_t begin = id == 0 ? 0 : static_cast<size_t>(nameEnds[id - 1]);
+    return std::string_view(nameBytes).substr(begin, static_cast<size_t>(nameEnds[id]) - begin);
 }
 
-const std::vector<Action>& Plan::getActions() const {
-    return actions;
+std::string_view Plan::directory(uint32_t id) const {
+    const size_t begin = id == 0 ? 0 : static_cast<size_t>(directoryEnds[id - 1]);
+    return std::string_view(directoryBytes).substr(begin, static_cast<size_t>(directoryEnds[id]) - begin);
 }
 
 void Plan::printPlan() const {
     std::cout << "=== Plan of Actions ===\n";
-    if (actions.empty()) {
+    if (empty()) {
         std::cout << "No actions to perform.\n";
         return;
     }
 
-    for (const auto& action : actions) {
-        switch (action.type) {
-            case Action::MOVE:
-                std::cout << "MOVE:   \"" << action.source.filename().string() 
-                          << "\" -> \"" << action.destination.parent_path().string() << "/\"\n";
-                break;
-            case Action::RENAME:
-                std::cout << "RENAME: \"" << action.source.filename().string() 
-                          << "\" -> \"" << action.destination.filename().string() << "\"\n";
-                break;
-            case Action::CREATE_DIR:
-                std::cout << "CREATE: \"" << action.destination.string() << "\"\n";
-                break;
-        }
+    for (size_t i = 0; i < size(); ++i) {
+        printAction(action(i));
     }
+    Log::flush();
     std::cout << "========================\n";
 }
 
+void Plan::printAction(const Action& action) {
+    if (!Log::enabled(Log::INFO)) {
+        return;
+    }
+    std::string line;
+    switch (action.type) {
+        case Action::MOVE:
+            line = "MOVE:   \"" + action.source.filename().string() + "\" -> \"" +
+                   action.destination.parent_path().string() + "/\"";
+            break;
+        case Action::RENAME:
+            line = "RENAME: \"" + action.source.filename().string() + "\" -> \"" +
+                   action.destination.filename().string() + "\"";
+            break;
+        case Action::CREATE_DIR:
+            line = "CREATE: \"" + action.destination.string() + "\"";
+            break;
+        case Action::HARDLINK:
+            line = "LINK:   \"" + action.destination.string() + "\" -> \"" + action.source.string() + "\"";
+            break;
+        case Action::DELETE_DUPLICATE:
+            line = "DELETE: \"" + action.source.string() + "\" (duplicate of \"" +
+                   action.destination.string() + "\")";
+            break;
+    }
+    Log::write(Log::INFO, "planned", std::move(line), action.source.string(), action.destination.string());
+}
+
 std::map<std::string, int> Plan::getSummary() const {
+    // The counts are maintained by addAction(), so this is just a copy
     std::map<std::string, int> summary;
-    summary["moves"] = 0;
-    summary["renames"] = 0;
-    summary["created_dirs"] = 0;
-    
-    for (const auto& action : actions) {
-        switch (action.type) {
-            case Action::MOVE:
-                summary["moves"]++;
-                break;
-            case Action::RENAME:
-                summary["renames"]++;
-                break;
-            case Action::CREATE_DIR:
-                summary["created_dirs"]++;
-                break;
-        }
-    }
-    
+    summary["moves"] = static_cast<int>(counts[Action::MOVE]);
+    summary["renames"] = static_cast<int>(counts[Action::RENAME]);
+    summary["created_dirs"] = static_cast<int>(counts[Action::CREATE_DIR]);
+    summary["hardlinks"] = static_cast<int>(counts[Action::HARDLINK]);
+    summary["deleted_duplicates"] = static_cast<int>(counts[Action::DELETE_DUPLICATE]);
     return summary;
 }
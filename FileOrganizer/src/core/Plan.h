@@ -1,9 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 
 /**
  * @struct Action
@@ -11,12 +15,17 @@
  *
  * An action can be moving a file, renaming a file, or creating a directory.
  * It stores the type of operation and the necessary source and destination paths.
+ *
+ * The duplicate actions run after all other actions of a plan, once every kept
+ * copy has reached its final place.
  */
 struct Action {
     enum Type { 
         MOVE,       ///< Move a file from source to destination.
         RENAME,     ///< Rename a file from source to destination.
-        CREATE_DIR  ///< Create a directory at the destination path.
+        CREATE_DIR, ///< Create a directory at the destination path.
+        HARDLINK,   ///< Replace the file at destination with a hard link to source (its identical copy).
+        DELETE_DUPLICATE ///< Delete source, an identical copy of the file kept at destination.
     };
     
     Type type;
@@ -41,6 +50,14 @@ struct Action {
  * This class is the core of the "Planning Phase". It stores all the actions
  * that need to be performed, allows for adding new actions, and provides
  * utilities for displaying the plan and summarizing its contents.
+ *
+ * Plans can hold millions of actions, so they are not stored as Action objects
+ * (a type and two heap-allocated paths each). Every path is split into its
+ * directory, interned once per plan since most actions share a handful of
+ * destination directories, and its filename, which is appended to a single
+ * arena (and shared when a MOVE keeps the name). The actions themselves are
+ * parallel arrays of small integer ids, and the per-type counts are kept up to
+ * date as actions are added. action() rebuilds an Action on demand.
  */
 class Plan {
 public:
@@ -50,13 +67,39 @@ public:
      * @param action The Action object to add.
      */
     void addAction(const Action& action);
-    
+
     /**
-     * @brief Gets the list of all actions in the plan.
-     * 
-     * @return A const reference to the vector of actions.
+     * @brief Gets the number of actions in the plan.
+     */
+    size_t size() const { return types.size(); }
+
+    /**
+     * @brief Checks whether the plan has no actions.
      */
-    const std::vector<Action>& getActions() const;
+    bool empty() const { return types.empty(); }
+
+    /**
+     * @brief Rebuilds an action of the plan.
+     *
+     * @param index The position of the action, in the order it was added.
+     * @return A copy of the action.
+     */
+    Action action(size_t index) const;
+
+    /**
+     * @brief Gets the type of an action without rebuilding its paths.
+     */
+    Action::Type type(size_t index) const { return static_cast<Action::Type>(types[index]); }
+
+    /**
+     * @brief Gets the number of actions of one type.
+     */
+    size_t count(Action::Type type) const { return counts[type]; }
+
+    /**
+     * @brief Estimates the heap memory held by the plan, in bytes.
+     */
+    size_t memoryUsage() const;
     
     /**
      * @brief Prints the entire plan to the standard output.
@@ -64,6 +107,13 @@ public:
      * Useful for the --dry-run mode to show the user what will happen.
      */
     void printPlan() const;
+
+    /**
+     * @brief Logs one action the way printPlan() lists it.
+     *
+     * @param action The action to print.
+     */
+    static void printAction(const Action& action);
     
     /**
      * @brief Generates a summary of the actions in the plan.
@@ -74,5 +124,32 @@ public:
     std::map<std::string, int> getSummary() const;
 
 private:
-    std::vector<Action> actions; ///< The list of actions to be executed.
+    friend class PlanFile;  // Writes the arrays below to disk as they are
+
+    static constexpr size_t kTypeCount = Action::DELETE_DUPLICATE + 1;
+
+    // The actions, one element per action in every array
+    std::vector<uint8_t> types;
+    std::vector<uint32_t> sourceDirs;        ///< Ids into the directory arena.
+    std::vector<uint32_t> sourceNames;       ///< Ids into the name arena.
+    std::vector<uint32_t> destinationDirs;
+    std::vector<uint32_t> destinationNames;
+
+    // Interned directories, in an arena like the names; the map finds a directory's
+    // id by the hash of its path. Only offsets are stored, so copies of a plan are
+    // independent of each other.
+    std::unordered_multimap<size_t, uint32_t> directoryIds;
+    std::string directoryBytes;
+    std::vector<uint64_t> directoryEnds;
+
+    // The name arena: name i is nameBytes[nameEnds[i - 1], nameEnds[i])
+    std::string nameBytes;
+    std::vector<uint64_t> nameEnds;
+
+    std::array<size_t, kTypeCount> counts{};
+
+    uint32_t internDirectory(const std::filesystem::path& directory);
+    uint32_t appendName(const std::filesystem::path& name);
+    std::string_view name(uint32_t id) const;
+    std::string_view directory(uint32_t id) const;
 };
@@ -0,0 +1,335 @@
+#include "PlanFile.h"
+#include "utils/AtomicFile.h"
+#include "utils/WorkStealingPool.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The start of a plan file. All fields are in host byte order.
+ */
+struct PlanFile::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;     ///< sizeof(Header); catches layout changes the version missed.
+    uint64_t actionCount;
+    uint64_t directoryCount;
+    uint64_t directoryBytes;
+    uint64_t nameCount;
+    uint64_t nameBytes;
+    uint64_t counts[kTypeCount];
+};
+
+/**
+ * @brief The state of an action's source when the plan was made.
+ */
+struct PlanFile::Stamp {
+    uint64_t inode;
+    int64_t mtime;           ///< Nanoseconds since the epoch; kNoStamp if the source did not exist.
+    uint64_t size;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'O', 'P', 'L', 'A', 'N', '\n', '\0'};
+constexpr int64_t kNoStamp = INT64_MIN;
+
+size_t align8(size_t offset) {
+    return (offset + 7) & ~size_t(7);
+}
+
+template <typename T>
+void append(std::vector<unsigned char>& out, const T* values, size_t count) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+    out.resize(align8(out.size()), 0);
+}
+
+} // namespace
+
+/**
+ * @brief Where each section of a plan file starts, computed from its header.
+ */
+struct PlanFile::Layout {
+    size_t stamps, directoryEnds, nameEnds;
+    size_t sourceDirs, sourceNames, destinationDirs, destinationNames, types;
+    size_t directoryBytes, nameBytes, total;
+
+    explicit Layout(const Header& header) {
+        const size_t actions = static_cast<size_t>(header.actionCount);
+        stamps = sizeof(Header);
+        directoryEnds = align8(stamps + actions * sizeof(Stamp));
+        nameEnds = align8(directoryEnds + static_cast<size_t>(header.directoryCount) * sizeof(uint64_t));
+        sourceDirs = align8(nameEnds + static_cast<size_t>(header.nameCount) * sizeof(uint64_t));
+        sourceNames = align8(sourceDirs + actions * sizeof(uint32_t));
+        destinationDirs = align8(sourceNames + actions * sizeof(uint32_t));
+        destinationNames = align8(destinationDirs + actions * sizeof(uint32_t));
+        types = align8(destinationNames + actions * sizeof(uint32_t));
+        directoryBytes = align8(types + actions);
+        nameBytes = align8(directoryBytes + static_cast<size_t>(header.directoryBytes));
+        total = align8(nameBytes + static_cast<size_t>(header.nameBytes));
+    }
+};
+
+const char* StaleAction::describe() const {
+    switch (reason) {
+        case SOURCE_MISSING: return "source is missing";
+        case SOURCE_CHANGED: return "source changed since planning";
+        case DESTINATION_EXISTS: return "destination already exists";
+    }
+    return "";
+}
+
+void PlanFile::save(const Plan& plan, const fs::path& file) {
+    AtomicFile::write(file, serialize(plan));
+}
+
+std::vector<unsigned char> PlanFile::serialize(const Plan& plan, size_t headroom, bool stampSources) {
+    const size_t actions = plan.size();
+
+    // Stamp the sources now, so a later run can tell whether they were touched
+    std::vector<Stamp> stampList(actions, Stamp{0, kNoStamp, 0});
+    constexpr size_t batchSize = 256;
+    WorkStealingPool pool;
+    for (size_t begin = 0; stampSources && begin < actions; begin += batchSize) {
+        const size_t end = std::min(begin + batchSize, actions);
+        pool.submit([&plan, &stampList, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                const fs::path source = plan.action(i).source;
+                stampList[i] = source.empty() ? Stamp{0, kNoStamp, 0} : stampOf(source);
+            }
+        });
+    }
+    pool.wait();
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.headerSize = sizeof(Header);
+    header.actionCount = actions;
+    header.directoryCount = plan.directoryEnds.size();
+    header.directoryBytes = plan.directoryBytes.size();
+    header.nameCount = plan.nameEnds.size();
+    header.nameBytes = plan.nameBytes.size();
+    for (size_t type = 0; type < kTypeCount; ++type) {
+        header.counts[type] = plan.counts[type];
+    }
+
+    const Layout layout(header);
+    std::vector<unsigned char> image;
+    image.reserve(headroom + layout.total);
+    image.resize(headroom, 0);
+    append(image, &header, 1);
+    append(image, stampList.data(), stampList.size());
+    append(image, plan.directoryEnds.data(), plan.directoryEnds.size());
+    append(image, plan.nameEnds.data(), plan.nameEnds.size());
+    append(image, plan.sourceDirs.data(), actions);
+    append(image, plan.sourceNames.data(), actions);
+    append(image, plan.destinationDirs.data(), actions);
+    append(image, plan.destinationNames.data(), actions);
+    append(image, plan.types.data(), actions);
+    append(image, plan.directoryBytes.data(), plan.directoryBytes.size());
+    append(image, plan.nameBytes.data(), plan.nameBytes.size());
+    return image;
+}
+
+void PlanFile::load(const fs::path& file, uint64_t offset, uint64_t length) {
+    auto reset = [this] {
+        mappedFile.close();
+        imageBegin = nullptr;
+        imageLength = 0;
+        actionCount = 0;
+        counts.fill(0);
+    };
+    reset();
+    // Leaves the plan empty rather than half-loaded
+    auto damaged = [&file, &reset](const char* what) {
+        reset();
+        return std::runtime_error("Plan file " + file.string() + " " + what);
+    };
+
+    if (!mappedFile.open(file)) {
+        throw damaged("cannot be read");
+    }
+    if (offset % 8 != 0 || offset > mappedFile.size() || length > mappedFile.size() - offset) {
+        throw damaged("is truncated or damaged");
+    }
+    const unsigned char* data = mappedFile.data() + offset;
+    const size_t imageSize = length != 0 ? static_cast<size_t>(length)
+                                         : mappedFile.size() - static_cast<size_t>(offset);
+
+    // Validate everything before trusting a single offset
+    Header header;
+    if (imageSize < sizeof(Header)) {
+        throw damaged("is not a saved plan");
+    }
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw damaged("is not a saved plan");
+    }
+    if (header.version != kFormatVersion || header.headerSize != sizeof(Header)) {
+        throw damaged("was saved by another version of FileOrganizer");
+    }
+    // Bound every count by the file size first, so the layout cannot overflow
+    const bool countsPlausible =
+        header.actionCount <= imageSize && header.directoryCount <= imageSize &&
+        header.directoryBytes <= imageSize && header.nameCount <= imageSize && header.nameBytes <= imageSize;
+    const Layout layout(header);
+    if (!countsPlausible || layout.total != imageSize) {
+        throw damaged("is truncated or damaged");
+    }
+
+    actionCount = static_cast<size_t>(header.actionCount);
+    stamps = reinterpret_cast<const Stamp*>(data + layout.stamps);
+    types = data + layout.types;
+    sourceDirs = reinterpret_cast<const uint32_t*>(data + layout.sourceDirs);
+    sourceNames = reinterpret_cast<const uint32_t*>(data + layout.sourceNames);
+    destinationDirs = reinterpret_cast<const uint32_t*>(data + layout.destinationDirs);
+    destinationNames = reinterpret_cast<const uint32_t*>(data + layout.destinationNames);
+    directoryEnds = reinterpret_cast<const uint64_t*>(data + layout.directoryEnds);
+    directoryBytes = reinterpret_cast<const char*>(data + layout.directoryBytes);
+    nameEnds = reinterpret_cast<const uint64_t*>(data + layout.nameEnds);
+    nameBytes = reinterpret_cast<const char*>(data + layout.nameBytes);
+
+    auto endsValid = [](const uint64_t* ends, uint64_t count, uint64_t bytes) {
+        uint64_t previous = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (ends[i] < previous) return false;
+            previous = ends[i];
+        }
+        return previous <= bytes && (count == 0 || previous == bytes);
+    };
+    if (!endsValid(directoryEnds, header.directoryCount, header.directoryBytes) ||
+        !endsValid(nameEnds, header.nameCount, header.nameBytes)) {
+        throw damaged("is truncated or damaged");
+    }
+
+    // One pass over the ids; the counts are rebuilt rather than trusted
+    for (size_t i = 0; i < actionCount; ++i) {
+        if (types[i] >= kTypeCount ||
+            sourceDirs[i] >= header.directoryCount || destinationDirs[i] >= header.directoryCount ||
+            sourceNames[i] >= header.nameCount || destinationNames[i] >= header.nameCount) {
+            throw damaged("is truncated or damaged");
+        }
+        ++counts[types[i]];
+    }
+    for (size_t type = 0; type < kTypeCount; ++type) {
+        if (counts[type] != header.counts[type]) {
+            throw damaged("is truncated or damaged");
+        }
+    }
+    imageBegin = data;
+    imageLength = imageSize;
+}
+
+std::vector<StaleAction> PlanFile::findStale() const {
+    // One slot per action, filled in parallel, then compacted in plan order
+    constexpr int kFresh = -1;
+    std::vector<int> reasons(actionCount, kFresh);
+    constexpr size_t batchSize = 256;
+    WorkStealingPool pool;
+    for (size_t begin = 0; begin < actionCount; begin += batchSize) {
+        const size_t end = std::min(begin + batchSize, actionCount);
+        pool.submit([this, &reasons, begin, end] {
+            for (size_t i = begin; i < end; ++i) {
+                const Stamp& planned = stamps[i];
+                if (planned.mtime != kNoStamp) {
+                    const Stamp current = stampOf(source(i));
+                    if (current.mtime == kNoStamp) {
+                        reasons[i] = StaleAction::SOURCE_MISSING;
+                        continue;
+                    }
+                    if (current.inode != planned.inode || current.mtime != planned.mtime ||
+                        current.size != planned.size) {
+                        reasons[i] = StaleAction::SOURCE_CHANGED;
+                        continue;
+                    }
+                }
+                // Moves never overwrite: their destinations were free when planned
+                std::error_code ec;
+                if (type(i) == Action::MOVE || type(i) == Action::RENAME) {
+                    if (fs::exists(fs::symlink_status(destination(i), ec))) {
+                        reasons[i] = StaleAction::DESTINATION_EXISTS;
+                    }
+                } else if (type(i) == Action::CREATE_DIR) {
+                    const auto status = fs::status(destination(i), ec);
+                    if (fs::exists(status) && !fs::is_directory(status)) {
+                        reasons[i] = StaleAction::DESTINATION_EXISTS;
+                    }
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    std::vector<StaleAction> stale;
+    for (size_t i = 0; i < actionCount; ++i) {
+        if (reasons[i] != kFresh) {
+            stale.push_back(StaleAction{i, static_cast<StaleAction::Reason>(reasons[i])});
+        }
+    }
+    return stale;
+}
+
+Action PlanFile::action(size_t index) const {
+    return Action(type(index), source(index), destination(index));
+}
+
+void PlanFile::printPlan() const {
+    std::cout << "=== Plan of Actions ===\n";
+    if (empty()) {
+        std::cout << "No actions to perform.\n";
+        return;
+    }
+
+    for (size_t i = 0; i < size(); ++i) {
+        Plan::printAction(action(i));
+    }
+    std::cout << "========================\n";
+}
+
+PlanFile::Stamp PlanFile::stampOf(const fs::path& file) {
+#ifdef __linux__
+    // lstat: a symlink is moved as a link, so the link itself is what must not change
+    struct stat st;
+    if (::lstat(file.c_str(), &st) != 0) {
+        return Stamp{0, kNoStamp, 0};
+    }
+    return Stamp{static_cast<uint64_t>(st.st_ino),
+                 static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+                 static_cast<uint64_t>(st.st_size)};
+#else
+    std::error_code ec;
+    const auto status = fs::symlink_status(file, ec);
+    if (ec || !fs::exists(status)) {
+        return Stamp{0, kNoStamp, 0};
+    }
+    const auto mtime = fs::last_write_time(file, ec);
+    const auto size = fs::is_regular_file(status) ? fs::file_size(file, ec) : 0;
+    return Stamp{0, ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count()), static_cast<uint64_t>(size)};
+#endif
+}
+
+std::string_view PlanFile::entry(const uint64_t* ends, const char* bytes, uint32_t id) {
+    const size_t begin = id == 0 ? 0 : static_cast<size_t>(ends[id - 1]);
+    return std::string_view(bytes + begin, static_cast<size_t>(ends[id]) - begin);
+}
+
+fs::path PlanFile::source(size_t index) const {
+    return fs::path(entry(directoryEnds, directoryBytes, sourceDirs[index])) /
+           entry(nameEnds, nameBytes, sourceNames[index]);
+}
+
+fs::path PlanFile::destination(size_t index) const {
+    return fs::path(entry(directoryEnds, directoryBytes, destinationDirs[index])) /
+           entry(nameEnds, nameBytes, destinationNames[index]);
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "Plan.h"
+#include "utils/MappedFile.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct StaleAction
+ * @brief An action of a saved plan that no longer matches the filesystem.
+ */
+struct StaleAction {
+    enum Reason {
+        SOURCE_MISSING,      ///< The source is gone.
+        SOURCE_CHANGED,      ///< The source was replaced or modified since planning.
+        DESTINATION_EXISTS   ///< Something now occupies the destination of a move, or a file
+                             ///< sits where a directory is to be created.
+    };
+
+    size_t index;    ///< The position of the action in the plan.
+    Reason reason;
+
+    /**
+     * @brief Describes the reason for the console.
+     */
+    const char* describe() const;
+};
+
+/**
+ * @class PlanFile
+ * @brief A plan saved to disk, to be executed later without rescanning.
+ *
+ * The file is the compact Plan written out as is: a header, a stamp per action
+ * (inode, modification time and size of the source at planning time), the
+ * directory and name tables, then the id arrays, each section aligned to 8 bytes.
+ * load() maps it and checks its bounds and ids once; from then on actions are
+ * rebuilt straight from the mapping, so even a plan with millions of actions opens
+ * in milliseconds and FileOperator can run it without an intermediate copy.
+ *
+ * A plan is only correct for the tree it was made for. findStale() compares every
+ * source with its stamp and checks that no destination has been taken since.
+ */
+class PlanFile {
+public:
+    /// Bump whenever the file layout changes.
+    static constexpr uint32_t kFormatVersion = 1;
+
+    PlanFile() = default;
+
+    PlanFile(const PlanFile&) = delete;
+    PlanFile& operator=(const PlanFile&) = delete;
+
+    /**
+     * @brief Stamps the sources of a plan and writes it to a file.
+     *
+     * The file is replaced atomically.
+     *
+     * @param plan The plan to save.
+     * @param file The file to write.
+     * @throws std::filesystem::filesystem_error If the file cannot be written.
+     */
+    static void save(const Plan& plan, const std::filesystem::path& file);
+
+    /**
+     * @brief Stamps the sources of a plan and builds the image save() writes.
+     *
+     * The image can also be embedded in another file (see Journal).
+     *
+     * @param plan The plan to serialize.
+     * @param headroom Zero bytes to put before the image, for the embedding file's
+     *        own header; a multiple of 8.
+     * @param stampSources False to skip stamping; findStale() then only checks the
+     *        destinations.
+     */
+    static std::vector<unsigned char> serialize(const Plan& plan, size_t headroom = 0,
+                                                bool stampSources = true);
+
+    /**
+     * @brief Maps a saved plan.
+     *
+     * @param file The file written by save(), or a file embedding such an image.
+     * @param offset Where the image starts in the file; a multiple of 8.
+     * @param length The size of the image; 0 means up to the end of the file.
+     * @throws std::runtime_error If the file cannot be read, is from another format
+     *         version, or is damaged.
+     */
+    void load(const std::filesystem::path& file, uint64_t offset = 0, uint64_t length = 0);
+
+    /**
+     * @brief Finds the actions whose sources or destinations changed since planning.
+     *
+     * The files are checked in parallel.
+     *
+     * @return The stale actions, in plan order. Empty if the plan is safe to run.
+     */
+    std::vector<StaleAction> findStale() const;
+
+    // The same read interface as Plan, so FileOperator can run either
+    size_t size() const { return actionCount; }
+    bool empty() const { return actionCount == 0; }
+    Action::Type type(size_t index) const { return static_cast<Action::Type>(types[index]); }
+    Action action(size_t index) const;
+    size_t count(Action::Type type) const { return counts[type]; }
+
+    /**
+     * @brief The mapped image, as serialize() built it.
+     */
+    const unsigned char* imageData() const { return imageBegin; }
+    size_t imageSize() const { return imageLength; }
+
+    /**
+     * @brief Prints the entire plan the way Plan::printPlan() does.
+     */
+    void printPlan() const;
+
+private:
+    struct Header;
+    struct Stamp;
+    struct Layout;
+
+    static constexpr size_t kTypeCount = Action::DELETE_DUPLICATE + 1;
+
+    MappedFile mappedFile;
+    const unsigned char* imageBegin = nullptr;
+    size_t imageLength = 0;
+    size_t actionCount = 0;
+    std::array<size_t, kTypeCount> counts{};
+    const Stamp* stamps = nullptr;
+    const uint8_t* types = nullptr;
+    const uint32_t* sourceDirs = nullptr;
+    const uint32_t* sourceNames = nullptr;
+    const uint32_t* destinationDirs = nullptr;
+    const uint32_t* destinationNames = nullptr;
+    const uint64_t* directoryEnds = nullptr;
+    const char* directoryBytes = nullptr;
+    const uint64_t* nameEnds = nullptr;
+    const char* nameBytes = nullptr;
+
+    static Stamp stampOf(const std::filesystem::path& file);
+    static std::string_view entry(const uint64_t* ends, const char* bytes, uint32_t id);
+    std::filesystem::path source(size_t index) const;
+    std::filesystem::path destination(size_t index) const;
+};
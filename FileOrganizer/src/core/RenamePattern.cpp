@@ -0,0 +1,127 @@
+#include "RenamePattern.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+[[noreturn]] void reject(const std::string& pattern, size_t position, const std::string& reason) {
+    throw std::invalid_argument(reason + " at position " + std::to_string(position) +
+                                " in pattern \"" + pattern + "\"");
+}
+
+} // namespace
+
+RenamePattern RenamePattern::compile(const std::string& pattern) {
+    RenamePattern compiled;
+    compiled.source = pattern;
+
+    if (pattern.empty()) {
+        throw std::invalid_argument("the rename pattern is empty");
+    }
+
+    size_t literalStart = 0;
+    auto flushLiteral = [&](size_t end) {
+        if (end > literalStart) {
+            compiled.tokens.push_back(Token{Token::LITERAL, literalStart, end - literalStart, 0});
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        const char c = pattern[pos];
+        if (c == '/' || c == '\0') {
+            reject(pattern, pos, "a new name cannot contain a path separator");
+        }
+        if (c != '{') {
+            ++pos;
+            continue;
+        }
+
+        const size_t close = pattern.find('}', pos);
+        if (close == std::string::npos) {
+            reject(pattern, pos, "unterminated placeholder");
+        }
+        flushLiteral(pos);
+
+        const std::string_view body(pattern.data() + pos + 1, close - pos - 1);
+        Token token{Token::LITERAL, 0, 0, 0};
+        if (body == "name") {
+            token.kind = Token::NAME;
+        } else if (body == "ext") {
+            token.kind = Token::EXT;
+        } else if (body == "date") {
+            token.kind = Token::DATE;
+        } else if (body == "counter") {
+            token.kind = Token::COUNTER;
+        } else if (body.substr(0, 8) == "counter:") {
+            token.kind = Token::COUNTER;
+            const std::string_view digits = body.substr(8);
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), token.padding);
+            if (digits.empty() || ec != std::errc() || end != digits.data() + digits.size() ||
+                token.padding > kMaxPadding) {
+                reject(pattern, pos, "invalid counter padding \"" + std::string(digits) +
+                       "\" (expected 0-" + std::to_string(kMaxPadding) + ")");
+            }
+        } else {
+            reject(pattern, pos, "unknown placeholder {" + std::string(body) + "}");
+        }
+        compiled.tokens.push_back(token);
+
+        pos = close + 1;
+        literalStart = pos;
+    }
+    flushLiteral(pattern.size());
+
+    return compiled;
+}
+
+void RenamePattern::render(const FileInfo& file, int counter, std::string& out) const {
+    char digits[16];
+    const auto [digitsEnd, ec] = std::to_chars(digits, digits + sizeof(digits), counter);
+    (void)ec;  // An int always fits in 16 characters
+    const size_t digitCount = static_cast<size_t>(digitsEnd - digits);
+
+    // Size the output exactly so it is allocated at most once
+    size_t length = 0;
+    for (const Token& token : tokens) {
+        switch (token.kind) {
+            case Token::LITERAL: length += token.length; break;
+            case Token::NAME: length += file.name.size(); break;
+            case Token::EXT: length += file.ext.size(); break;
+            case Token::DATE: length += file.detectedDate.size(); break;
+            case Token::COUNTER:
+                length += std::max(digitCount, static_cast<size_t>(token.padding));
+                break;
+        }
+    }
+
+    out.clear();
+    out.reserve(length);
+    for (const Token& token : tokens) {
+        switch (token.kind) {
+            case Token::LITERAL: out.append(source, token.offset, token.length); break;
+            case Token::NAME: out += file.name; break;
+            case Token::EXT: out += file.ext; break;
+            case Token::DATE:
+                // The detected date is "YYYY/MM"; a filename cannot contain the '/'
+                for (char c : file.detectedDate) {
+                    out += c == '/' ? '-' : c;
+                }
+                break;
+            case Token::COUNTER:
+                if (static_cast<size_t>(token.padding) > digitCount) {
+                    out.append(static_cast<size_t>(token.padding) - digitCount, '0');
+                }
+                out.append(digits, digitCount);
+                break;
+        }
+    }
+}
+
+std::string RenamePattern::render(const FileInfo& file, int counter) const {
+    std::string result;
+    render(file, counter, result);
+    return result;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "FileScanner.h"
+#include <string>
+#include <vector>
+
+/**
+ * @class RenamePattern
+ * @brief A rename pattern parsed once into a sequence of tokens.
+ *
+ * The pattern text is split into literal runs and the placeholders {name}, {ext},
+ * {date}, {counter} and {counter:N} (zero-padded to N digits). Rendering a filename
+ * then walks the token vector and appends each piece to the output, computing the
+ * exact output length first so the result is allocated once.
+ *
+ * Because a placeholder is expanded exactly once, text coming from a file (for
+ * example a name containing "{ext}") is never itself treated as a placeholder.
+ * {date} expands to "YYYY-MM", since the "YYYY/MM" form used for directories
+ * cannot appear in a filename.
+ */
+class RenamePattern {
+public:
+    /// The largest accepted {counter:N} padding.
+    static constexpr int kMaxPadding = 32;
+
+    /**
+     * @brief Parses and validates a pattern.
+     *
+     * @param pattern The user-provided pattern string.
+     * @return The compiled pattern.
+     * @throws std::invalid_argument If the pattern is empty, contains a path separator,
+     *         an unknown placeholder, an unterminated '{' or an invalid counter padding.
+     */
+    static RenamePattern compile(const std::string& pattern);
+
+    /**
+     * @brief Renders the new filename for a file.
+     *
+     * @param file The information about the original file.
+     * @param counter The counter value for this file.
+     * @param out Receives the filename; its previous contents are replaced. Reusing
+     *            the same string across calls avoids allocating at all.
+     */
+    void render(const FileInfo& file, int counter, std::string& out) const;
+
+    /**
+     * @brief Renders the new filename for a file into a new string.
+     */
+    std::string render(const FileInfo& file, int counter) const;
+
+    /**
+     * @brief Gets the original pattern text.
+     */
+    const std::string& text() const { return source; }
+
+private:
+    struct Token {
+        enum Kind { LITERAL, NAME, EXT, DATE, COUNTER };
+        Kind kind;
+        size_t offset = 0;   ///< LITERAL: start of the text in `source`.
+        size_t length = 0;   ///< LITERAL: length of the text.
+        int padding = 0;     ///< COUNTER: minimum number of digits.
+    };
+
+    std::string source;
+    std::vector<Token> tokens;
+};
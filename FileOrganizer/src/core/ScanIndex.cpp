@@ -0,0 +1,258 @@
+#include "ScanIndex.h"
+#include "utils/AtomicFile.h"
+#include "utils/XxHash64.h"
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief The start of an index file. All fields are in host byte order.
+ */
+struct ScanIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;      ///< sizeof(Entry); catches layout changes the version missed.
+    uint64_t fingerprint;
+    uint64_t entryCount;
+    uint64_t stringCount;
+    uint64_t stringBytes;
+};
+
+/**
+ * @brief One cached file. The classification fields index the string table.
+ */
+struct ScanIndex::Entry {
+    uint64_t device;
+    uint64_t inode;
+    int64_t mtime;
+    uint64_t size;
+    uint64_t nameHash;
+    uint32_t detectedDate;
+    uint32_t keyword;
+    uint32_t category;
+    uint32_t contentType;
+};
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'O', 'I', 'N', 'D', 'E', 'X', '\n'};
+
+auto sortKey(uint64_t device, uint64_t inode, uint64_t nameHash) {
+    return std::make_tuple(device, inode, nameHash);
+}
+
+template <typename T>
+void append(std::vector<unsigned char>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // namespace
+
+std::optional<IndexKey> IndexKey::of(const fs::path& file) {
+    FileMetadata metadata;
+    metadata.fetch(file, FileMetadata::ALL);
+    return of(file, metadata);
+}
+
+std::optional<IndexKey> IndexKey::of(const fs::path& file, const FileMetadata& metadata) {
+    if (!metadata.has(FileMetadata::ALL)) {
+        return std::nullopt;
+    }
+    IndexKey key;
+    key.device = metadata.device;
+    key.inode = metadata.inode;
+    key.mtime = metadata.mtime;
+    key.size = metadata.size;
+    const std::string name = file.filename().string();
+    key.nameHash = XxHash64::hash(name.data(), name.size());
+    return key;
+}
+
+ScanIndex::~ScanIndex() {
+    unmap();
+}
+
+bool ScanIndex::load(const fs::path& file, uint64_t fingerprint) {
+    unmap();
+    if (!mappedFile.open(file)) {
+        return false;
+    }
+    const unsigned char* mapping = mappedFile.data();
+    const size_t mappingSize = mappedFile.size();
+
+    // Validate everything before trusting a single offset
+    Header header;
+    if (mappingSize < sizeof(Header)) {
+        unmap();
+        return false;
+    }
+    std::memcpy(&header, mapping, sizeof(Header));
+    const size_t available = mappingSize - sizeof(Header);
+    const bool headerValid =
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+        header.version == kFormatVersion &&
+        header.entrySize == sizeof(Entry) &&
+        header.fingerprint == fingerprint &&
+        header.entryCount <= available / sizeof(Entry) &&
+        header.stringCount < available / sizeof(uint32_t) &&
+        header.stringBytes <= available &&
+        available == header.entryCount * sizeof(Entry) +
+                     (header.stringCount + 1) * sizeof(uint32_t) + header.stringBytes;
+    if (!headerValid) {
+        unmap();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry*>(mapping + sizeof(Header));
+    entryCount = static_cast<size_t>(header.entryCount);
+    stringOffsets = reinterpret_cast<const uint32_t*>(mapping + sizeof(Header) + entryCount * sizeof(Entry));
+    stringCount = static_cast<size_t>(header.stringCount);
+    stringBytes = reinterpret_cast<const char*>(stringOffsets + stringCount + 1);
+
+    bool stringsValid = stringOffsets[0] == 0 && stringOffsets[stringCount] == header.stringBytes;
+    for (size_t i = 0; stringsValid && i < stringCount; ++i) {
+        stringsValid = stringOffsets[i] <= stringOffsets[i + 1];
+    }
+    if (!stringsValid) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+bool ScanIndex::lookup(const IndexKey& key, IndexedClassification& out) const {
+    const Entry* end = entries + entryCount;
+    const auto wanted = sortKey(key.device, key.inode, key.nameHash);
+    const Entry* entry = std::lower_bound(entries, end, wanted, [](const Entry& e, const auto& k) {
+        return sortKey(e.device, e.inode, e.nameHash) < k;
+    });
+    if (entry == end || sortKey(entry->device, entry->inode, entry->nameHash) != wanted ||
+        entry->mtime != key.mtime || entry->size != key.size) {
+        return false;
+    }
+    out.detectedDate = string(entry->detectedDate);
+    out.keyword = string(entry->keyword);
+    out.category = string(entry->category);
+    out.contentType = string(entry->contentType);
+    return true;
+}
+
+void ScanIndex::record(const IndexKey& key, const IndexedClassification& classification) {
+    records.push_back(Record{key, classification});
+}
+
+void ScanIndex::save(const fs::path& file, uint64_t fingerprint, bool keepLoaded) const {
+    std::vector<Record> loaded;
+    if (keepLoaded) {
+        loaded.reserve(entryCount);
+        for (size_t i = 0; i < entryCount; ++i) {
+            const Entry& entry = entries[i];
+            Record record;
+            record.key = IndexKey{entry.device, entry.inode, entry.mtime, entry.size, entry.nameHash};
+            record.classification.detectedDate = string(entry.detectedDate);
+            record.classification.keyword = string(entry.keyword);
+            record.classification.category = string(entry.category);
+            record.classification.contentType = string(entry.contentType);
+            loaded.push_back(std::move(record));
+        }
+    }
+
+    // Recorded entries come first, so they win over loaded ones with the same key
+    std::vector<const Record*> sorted;
+    sorted.reserve(records.size() + loaded.size());
+    for (const auto& record : records) {
+        sorted.push_back(&record);
+    }
+    for (const auto& record : loaded) {
+        sorted.push_back(&record);
+    }
+    auto recordKey = [](const Record* r) { return sortKey(r->key.device, r->key.inode, r->key.nameHash); };
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [&](const Record* a, const Record* b) { return recordKey(a) < recordKey(b); });
+    // Hard links with the same name in two directories share a key (and a classification)
+    sorted.erase(std::unique(sorted.begin(), sorted.end(),
+                             [&](const Record* a, const Record* b) { return recordKey(a) == recordKey(b); }),
+                 sorted.end());
+
+    // Deduplicated string table; the empty string is not stored
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, uint32_t> stringIndex;
+    auto intern = [&](const std::string& text) {
+        if (text.empty()) return kNoString;
+        auto [it, inserted] = stringIndex.emplace(text, static_cast<uint32_t>(strings.size()));
+        if (inserted) strings.push_back(text);
+        return it->second;
+    };
+
+    std::vector<Entry> newEntries;
+    newEntries.reserve(sorted.size());
+    for (const Record* record : sorted) {
+        Entry entry{};
+        entry.device = record->key.device;
+        entry.inode = record->key.inode;
+        entry.mtime = record->key.mtime;
+        entry.size = record->key.size;
+        entry.nameHash = record->key.nameHash;
+        entry.detectedDate = intern(record->classification.detectedDate);
+        entry.keyword = intern(record->classification.keyword);
+        entry.category = intern(record->classification.category);
+        entry.contentType = intern(record->classification.contentType);
+        newEntries.push_back(entry);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.entrySize = sizeof(Entry);
+    header.fingerprint = fingerprint;
+    header.entryCount = newEntries.size();
+    header.stringCount = strings.size();
+    for (std::string_view text : strings) {
+        header.stringBytes += text.size();
+    }
+
+    std::vector<unsigned char> image;
+    image.reserve(sizeof(Header) + newEntries.size() * sizeof(Entry) +
+                  (strings.size() + 1) * sizeof(uint32_t) + header.stringBytes);
+    append(image, header);
+    for (const Entry& entry : newEntries) {
+        append(image, entry);
+    }
+    uint32_t offset = 0;
+    append(image, offset);
+    for (std::string_view text : strings) {
+        offset += static_cast<uint32_t>(text.size());
+        append(image, offset);
+    }
+    for (std::string_view text : strings) {
+        image.insert(image.end(), text.begin(), text.end());
+    }
+
+    // Write a complete new file, then swap it in
+    AtomicFile::write(file, image);
+}
+
+fs::path ScanIndex::temporaryPath(const fs::path& file) {
+    return AtomicFile::temporaryPath(file);
+}
+
+std::string_view ScanIndex::string(uint32_t index) const {
+    if (index >= stringCount) {
+        return {};
+    }
+    return std::string_view(stringBytes + stringOffsets[index], stringOffsets[index + 1] - stringOffsets[index]);
+}
+
+void ScanIndex::unmap() {
+    mappedFile.close();
+    entries = nullptr;
+    entryCount = 0;
+    stringOffsets = nullptr;
+    stringCount = 0;
+    stringBytes = nullptr;
+}
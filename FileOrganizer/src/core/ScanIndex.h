@@ -0,0 +1,150 @@
+#pragma once
+
+#include "FileMetadata.h"
+#include "utils/MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct IndexKey
+ * @brief Identifies one version of one file for the ScanIndex.
+ *
+ * A file whose inode, modification time, size or name changed gets a new key,
+ * so its cached classification is never reused by mistake. The directory is not
+ * part of the key: moving a file into its category keeps its entry valid.
+ */
+struct IndexKey {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    int64_t mtime = 0;        ///< Nanoseconds since the epoch.
+    uint64_t size = 0;
+    uint64_t nameHash = 0;    ///< XXH64 of the filename.
+
+    /**
+     * @brief Stats a file and builds its key.
+     *
+     * @return The key, or nothing if the file cannot be stat'ed.
+     */
+    static std::optional<IndexKey> of(const std::filesystem::path& file);
+
+    /**
+     * @brief Builds the key of a file from metadata fetched earlier.
+     *
+     * @return The key, or nothing unless `metadata` has every field.
+     */
+    static std::optional<IndexKey> of(const std::filesystem::path& file, const FileMetadata& metadata);
+};
+
+/**
+ * @struct IndexedClassification
+ * @brief The classification results cached for a file.
+ */
+struct IndexedClassification {
+    std::string detectedDate;   ///< The date detected in the name ("YYYY/MM"), if any.
+    std::string keyword;        ///< The folder of the matching keyword rule, if any.
+    std::string category;       ///< The type category (after content sniffing, if enabled).
+    std::string contentType;    ///< The sniffed extension, if any.
+};
+
+/**
+ * @class ScanIndex
+ * @brief A persistent cache of classification results, for incremental re-runs.
+ *
+ * The index file is a header followed by fixed-size entries sorted by key and a
+ * deduplicated string table (categories repeat across most entries). It is mapped
+ * into memory read-only and searched in place, so loading costs next to nothing
+ * regardless of its size.
+ *
+ * The header holds a format version and a fingerprint of the rule set the entries
+ * were computed with. If either differs from the current run, the whole index is
+ * discarded and rebuilt; so are files that are truncated or fail a bounds check.
+ *
+ * A new index is built from the entries recorded during a run (after a full scan,
+ * files no longer present simply drop out) and written to a temporary file that is renamed over
+ * the old one, so a crash never leaves a half-written index behind.
+ */
+class ScanIndex {
+public:
+    /// Bump whenever the file layout or the classification logic changes.
+    static constexpr uint32_t kFormatVersion = 1;
+
+    ScanIndex() = default;
+    ~ScanIndex();
+
+    ScanIndex(const ScanIndex&) = delete;
+    ScanIndex& operator=(const ScanIndex&) = delete;
+
+    /**
+     * @brief Maps an existing index file.
+     *
+     * @param file The index file.
+     * @param fingerprint The fingerprint of the current rule set.
+     * @return True if the index was loaded. False if it is missing, from another
+     *         format version or rule set, or corrupt; the index is then empty.
+     */
+    bool load(const std::filesystem::path& file, uint64_t fingerprint);
+
+    /**
+     * @brief Looks up the cached classification of a file.
+     *
+     * @param key The key of the file as it is now.
+     * @param out Receives the cached results on a hit.
+     * @return True on a hit.
+     */
+    bool lookup(const IndexKey& key, IndexedClassification& out) const;
+
+    /**
+     * @brief Records a file for the next index. Not thread-safe.
+     */
+    void record(const IndexKey& key, const IndexedClassification& classification);
+
+    /**
+     * @brief Atomically replaces the index file with the recorded entries.
+     *
+     * @param file The index file.
+     * @param fingerprint The fingerprint of the current rule set.
+     * @param keepLoaded Also keep the loaded entries that were not recorded again; for
+     *        runs that only looked at some of the files.
+     * @throws std::filesystem::filesystem_error If the file cannot be written.
+     */
+    void save(const std::filesystem::path& file, uint64_t fingerprint, bool keepLoaded = false) const;
+
+    /**
+     * @brief Gets the number of entries of the loaded index.
+     */
+    size_t size() const { return entryCount; }
+
+    /**
+     * @brief The name of the temporary file a new index is written to.
+     */
+    static std::filesystem::path temporaryPath(const std::filesystem::path& file);
+
+private:
+    struct Header;
+    struct Entry;
+
+    static constexpr uint32_t kNoString = UINT32_MAX;
+
+    // The mapped index
+    MappedFile mappedFile;
+    const Entry* entries = nullptr;
+    size_t entryCount = 0;
+    const uint32_t* stringOffsets = nullptr;   ///< stringCount + 1 offsets into stringBytes.
+    size_t stringCount = 0;
+    const char* stringBytes = nullptr;
+
+    // The index being built
+    struct Record {
+        IndexKey key;
+        IndexedClassification classification;
+    };
+    std::vector<Record> records;
+
+    std::string_view string(uint32_t index) const;
+    void unmap();
+};
@@ -0,0 +1,114 @@
+#include "WatchQueue.h"
+#include <algorithm>
+#include <system_error>
+
+namespace fs = std::filesystem;
+using std::chrono::milliseconds;
+
+WatchQueue::WatchQueue(fs::path directory, size_t maxBatch, milliseconds maxDelay)
+    : directory(std::move(directory)),
+      maxBatch(std::max<size_t>(1, maxBatch)),
+      maxDelay(maxDelay),
+      quietPeriod(std::min(kQuietPeriod, maxDelay)) {}
+
+void WatchQueue::created(const std::string& name, Clock::time_point now) {
+    lastEvent = now;
+    auto [it, inserted] = files.try_emplace(name);
+    PendingFile& file = it->second;
+    if (!inserted && file.completed) {
+        // Replaced by a new file of the same name; wait for that one to be written
+        file.completed = false;
+        --completedCount;
+    }
+    file.size = 0;
+    file.mtime = 0;
+    file.stableSince = now;
+    if (files.size() - completedCount == 1) {
+        nextCreatedCheck = now + kCreatedCheckInterval;
+    }
+}
+
+void WatchQueue::completed(const std::string& name, Clock::time_point now) {
+    lastEvent = now;
+    PendingFile& file = files[name];
+    if (!file.completed) {
+        file.completed = true;
+        if (completedCount++ == 0) {
+            batchStarted = now;
+        }
+    }
+}
+
+std::vector<std::string> WatchQueue::takeBatch(Clock::time_point now) {
+    std::vector<std::string> batch;
+
+    const bool releaseCompleted = completedCount > 0 &&
+        (completedCount >= maxBatch || now - lastEvent >= quietPeriod || now - batchStarted >= maxDelay);
+    const bool checkCreated = files.size() > completedCount && now >= nextCreatedCheck;
+    if (!releaseCompleted && !checkCreated) {
+        return batch;
+    }
+    if (checkCreated) {
+        nextCreatedCheck = now + kCreatedCheckInterval;
+    }
+
+    for (auto it = files.begin(); it != files.end() && batch.size() < maxBatch;) {
+        PendingFile& file = it->second;
+        const bool release = file.completed ? releaseCompleted : checkCreated && isStable(it->first, file, now);
+        if (!release) {
+            ++it;
+            continue;
+        }
+        if (file.completed) {
+            --completedCount;
+        }
+        batch.push_back(it->first);
+        it = files.erase(it);
+    }
+
+    // Whatever is left over from a capped batch starts the clock for the next one
+    if (completedCount > 0 && releaseCompleted) {
+        batchStarted = now;
+    }
+    return batch;
+}
+
+milliseconds WatchQueue::timeUntilDue(Clock::time_point now) const {
+    auto remaining = [now](Clock::time_point due) {
+        return std::max(milliseconds(0), std::chrono::ceil<milliseconds>(due - now));
+    };
+
+    milliseconds wait = kCreatedCheckInterval * 60;  // Nothing pending: just wait for events
+    if (completedCount >= maxBatch) {
+        return milliseconds(0);
+    }
+    if (completedCount > 0) {
+        wait = std::min({wait, remaining(lastEvent + quietPeriod), remaining(batchStarted + maxDelay)});
+    }
+    if (files.size() > completedCount) {
+        wait = std::min(wait, remaining(nextCreatedCheck));
+    }
+    return wait;
+}
+
+bool WatchQueue::isStable(const std::string& name, PendingFile& file, Clock::time_point now) const {
+    std::error_code ec;
+    const fs::path path = directory / name;
+    const auto size = fs::file_size(path, ec);
+    if (ec) {
+        return true;  // Gone or not a regular file; the organizer will skip it
+    }
+    const auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return true;
+    }
+
+    const auto mtimeCount = static_cast<int64_t>(mtime.time_since_epoch().count());
+    if (size != file.size || mtimeCount != file.mtime) {
+        file.size = size;
+        file.mtime = mtimeCount;
+        file.stableSince = now;
+        return false;
+    }
+    return now - file.stableSince >= kCreatedSettleTime;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class WatchQueue
+ * @brief Turns a stream of file events into debounced batches of settled files.
+ *
+ * A file is settled once it has been closed after writing or moved in whole. A file
+ * that was only created, such as a hard link, settles once its size and modification
+ * time stay unchanged for kCreatedSettleTime.
+ *
+ * Settled files are released in batches:
+ *  - when no event has arrived for the quiet period, so a file rewritten a few times
+ *    in a row, or a small group of files copied together, is organized once;
+ *  - as soon as maxBatch files are settled, so a burst is cut into bounded plans;
+ *  - at the latest maxDelay after the first file of the batch settled, so a steady
+ *    trickle of events cannot postpone a batch indefinitely.
+ */
+class WatchQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// How long a file that was only created must stay unchanged.
+    static constexpr std::chrono::milliseconds kCreatedSettleTime{5000};
+
+    /// How often created-only files are checked.
+    static constexpr std::chrono::milliseconds kCreatedCheckInterval{1000};
+
+    /// The longest quiet period; shorter if maxDelay is shorter.
+    static constexpr std::chrono::milliseconds kQuietPeriod{250};
+
+    /**
+     * @param directory The watched directory, for checking created-only files.
+     * @param maxBatch The largest number of files released at once (at least 1).
+     * @param maxDelay The longest a settled file waits for its batch.
+     */
+    WatchQueue(std::filesystem::path directory, size_t maxBatch, std::chrono::milliseconds maxDelay);
+
+    /**
+     * @brief Notes that a file appeared.
+     */
+    void created(const std::string& name, Clock::time_point now);
+
+    /**
+     * @brief Notes that a file was written and closed, or moved in.
+     */
+    void completed(const std::string& name, Clock::time_point now);
+
+    /**
+     * @brief Releases the next batch if one is due.
+     *
+     * @return The names of up to maxBatch settled files; empty if no batch is due.
+     */
+    std::vector<std::string> takeBatch(Clock::time_point now);
+
+    /**
+     * @brief Gets how long the caller may sleep before takeBatch() could return a batch.
+     */
+    std::chrono::milliseconds timeUntilDue(Clock::time_point now) const;
+
+    /**
+     * @brief Gets the number of files not yet released.
+     */
+    size_t size() const { return files.size(); }
+
+private:
+    struct PendingFile {
+        bool completed = false;
+        uint64_t size = 0;                 ///< Created-only files: the size last observed.
+        int64_t mtime = 0;                 ///< Created-only files: the mtime last observed.
+        Clock::time_point stableSince;     ///< Created-only files: since when unchanged.
+    };
+
+    std::filesystem::path directory;
+    size_t maxBatch;
+    std::chrono::milliseconds maxDelay;
+    std::chrono::milliseconds quietPeriod;
+
+    std::unordered_map<std::string, PendingFile> files;
+    size_t completedCount = 0;
+    Clock::time_point lastEvent;
+    Clock::time_point batchStarted;        ///< When the oldest unreleased file completed.
+    Clock::time_point nextCreatedCheck;
+
+    /**
+     * @brief Checks whether a created-only file has stopped changing.
+     *
+     * @return True if it has been stable long enough, or no longer exists.
+     */
+    bool isStable(const std::string& name, PendingFile& file, Clock::time_point now) const;
+};
@@ -1,6 +1,12 @@
 #include <iostream>
+#include <optional>
 #include "core/FileOrganizer.h"
+#include "core/RenamePattern.h"
+#include "utils/AtomicFile.h"
 #include "utils/CommandLineParser.h" 
+#include "utils/Log.h"
+#include "utils/Stats.h"
+#include <sstream>
 
 /**
  * @brief The main entry point for the FileOrganizer application.
@@ -14,7 +20,7 @@
  *
  * @param argc The number of command-line arguments.
  * @param argv The array of command-line argument strings.
- * @return int Exit code. 0 for success, 1 for error.
+ * @return int Exit code. 0 for success, 1 for error (including failed actions).
  */
 int main(int argc, char* argv[]) {
     // Parse command-line arguments
@@ -26,22 +32,139 @@ int main(int argc, char* argv[]) {
         CommandLineParser::printUsage(argv[0]);
         return 1;
     }
+    if (args.watch && (args.rename || args.recursive)) {
+        std::cerr << "Error: --watch organizes the working directory itself; it cannot be "
+                     "combined with --rename or --recursive.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (args.stream && (args.rename || args.watch || args.dedupe != DedupeMode::OFF || !args.indexFile.empty())) {
+        std::cerr << "Error: --stream organizes files as they are found; it cannot be "
+                     "combined with --rename, --watch, --dedupe or --index.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (!args.savePlanFile.empty() && (args.watch || args.stream)) {
+        std::cerr << "Error: --save-plan needs a complete plan; it cannot be combined with "
+                     "--watch or --stream.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (!args.applyPlanFile.empty() &&
+        (args.rename || args.watch || args.stream || !args.savePlanFile.empty())) {
+        std::cerr << "Error: --apply-plan runs a saved plan; it cannot be combined with "
+                     "--rename, --watch, --stream or --save-plan.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (!args.journalFile.empty() && (args.watch || args.stream)) {
+        std::cerr << "Error: --journal records one plan; it cannot be combined with "
+                     "--watch or --stream.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (args.ioUring && (args.stream || !args.undoFile.empty())) {
+        std::cerr << "Error: --io-uring executes a complete plan; it cannot be combined with "
+                     "--stream or --undo.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if ((!args.resumeFile.empty() || !args.undoFile.empty()) &&
+        (!args.resumeFile.empty() + !args.undoFile.empty() + !args.applyPlanFile.empty() +
+         !args.savePlanFile.empty() + !args.journalFile.empty() + args.rename + args.watch + args.stream > 1)) {
+        std::cerr << "Error: --resume and --undo work on a journal alone; they cannot be combined "
+                     "with each other or with --rename, --watch, --stream, --save-plan, --apply-plan "
+                     "or --journal.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (!args.batchFile.empty() &&
+        (args.rename || args.watch || args.stream || args.ioUring || !args.indexFile.empty() ||
+         !args.savePlanFile.empty() || !args.applyPlanFile.empty() || !args.journalFile.empty() ||
+         !args.resumeFile.empty() || !args.undoFile.empty())) {
+        std::cerr << "Error: --batch organizes each listed directory on shared threads; it cannot be "
+                     "combined with --rename, --watch, --stream, --io-uring, --index, --save-plan, "
+                     "--apply-plan, --journal, --resume or --undo.\n";
+        CommandLineParser::printUsage(argv[0]);
+        return 1;
+    }
+    if (args.rename) {
+        try {
+            RenamePattern::compile(args.renamePattern);
+        } catch (const std::invalid_argument& e) {
+            std::cerr << "Error: Invalid rename pattern: " << e.what() << "\n";
+            CommandLineParser::printUsage(argv[0]);
+            return 1;
+        }
+    }
 
-    // Create the main organizer object
-    FileOrganizer organizer(args);
+    if (!args.statsFormat.empty()) {
+        Stats::enable();
+    }
+
+    // Create the main organizer object (this loads any rules files)
+    std::optional<FileOrganizer> organizer;
+    try {
+        organizer.emplace(args);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    // Per-action output goes through a background writer from here on
+    try {
+        Log::start(Log::Options{args.quiet, args.logFile});
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
 
     // Execute the requested action
+    bool success = true;
     try {
-        if (args.organize) {
-            organizer.organizeFiles();
+        if (!args.resumeFile.empty()) {
+            success = organizer->resumeJournal(args.resumeFile);
+        } else if (!args.undoFile.empty()) {
+            success = organizer->undoJournal(args.undoFile);
+        } else if (!args.batchFile.empty()) {
+            success = organizer->organizeBatch(args.batchFile);
+        } else if (!args.applyPlanFile.empty()) {
+            success = organizer->applyPlan(args.applyPlanFile);
+        } else if (args.watch) {
+            success = organizer->watchFiles();
+        } else if (args.stream) {
+            success = organizer->organizeStreaming();
+        } else if (args.organize) {
+            success = organizer->organizeFiles();
         } else if (args.rename) {
-            organizer.renameFiles(args.renamePattern);
+            success = organizer->renameFiles(args.renamePattern);
         }
     } catch (const std::exception& e) {
         // Catch any unexpected exceptions from the core logic
+        Log::stop();
         std::cerr << "An unexpected error occurred: " << e.what() << std::endl;
-        return 1;
+        success = false;
+    }
+
+    Log::stop();
+
+    // The report covers failed runs too; that is when it is most wanted
+    if (!args.statsFormat.empty()) {
+        if (args.statsFile.empty()) {
+            Stats::writeJson(std::cout);
+        } else {
+            std::ostringstream report;
+            Stats::writeJson(report);
+            const std::string text = report.str();
+            try {
+                AtomicFile::write(args.statsFile, std::vector<unsigned char>(text.begin(), text.end()));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Cannot write the statistics: " << e.what() << "\n";
+                success = false;
+            }
+        }
     }
 
-    return 0;
+    // Report failed actions to the caller (e.g. cron or a wrapper script)
+    return success ? 0 : 1;
 }
@@ -0,0 +1,52 @@
+#include "AtomicFile.h"
+#include <fstream>
+#include <system_error>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+void AtomicFile::write(const fs::path& file, const std::vector<unsigned char>& bytes) {
+    const fs::path temporary = temporaryPath(file);
+#ifdef __linux__
+    auto fail = [&](int error) {
+        ::unlink(temporary.c_str());
+        throw fs::filesystem_error("cannot write file", temporary, std::error_code(error, std::generic_category()));
+    };
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fail(errno);
+    }
+    for (size_t written = 0; written < bytes.size();) {
+        const ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            const int error = errno;
+            ::close(fd);
+            fail(error);
+        }
+        written += static_cast<size_t>(n);
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+        fail(errno);
+    }
+#else
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        if (!out) {
+            throw fs::filesystem_error("cannot write file", temporary,
+                                       std::make_error_code(std::errc::io_error));
+        }
+    }
+#endif
+    fs::rename(temporary, file);
+}
+
+fs::path AtomicFile::temporaryPath(const fs::path& file) {
+    return file.parent_path() / ("." + file.filename().string() + ".tmp");
+}
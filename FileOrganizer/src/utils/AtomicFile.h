@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+/**
+ * @class AtomicFile
+ * @brief Replaces a file in one step, so readers never see it half-written.
+ *
+ * The new contents are written to a temporary file next to the target, flushed to
+ * disk, and renamed over the target. A crash leaves either the old file or the new
+ * one, plus at worst a stray temporary file.
+ */
+class AtomicFile {
+public:
+    /**
+     * @brief Writes `bytes` as the new contents of `file`.
+     *
+     * @throws std::filesystem::filesystem_error If the file cannot be written; the
+     *         old file is then left untouched.
+     */
+    static void write(const std::filesystem::path& file, const std::vector<unsigned char>& bytes);
+
+    /**
+     * @brief The name of the temporary file the new contents are written to.
+     */
+    static std::filesystem::path temporaryPath(const std::filesystem::path& file);
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+/**
+ * @class BoundedQueue
+ * @brief A blocking multi-producer, multi-consumer queue with a fixed capacity.
+ *
+ * Connects the stages of a pipeline: a producer that gets ahead blocks in push()
+ * until a consumer catches up, so the memory held between two stages never
+ * exceeds `capacity` items no matter how much data flows through.
+ *
+ * When the producers are done, close() lets the consumers drain what is left;
+ * pop() then returns false. close() also unblocks producers, whose push() then
+ * fails, so a failing consumer can stop the stages upstream of it.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Adds an item, waiting while the queue is full.
+     *
+     * @return False if the queue was closed; the item is then discarded.
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest item, waiting while the queue is empty.
+     *
+     * @return False once the queue is closed and empty.
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Marks the end of the stream and wakes every waiting thread.
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    bool closed = false;
+};
@@ -19,6 +19,125 @@ CommandLineArgs CommandLineParser::parse(int argc, char* argv[]) {
             args.dryRun = true;
         } else if (arg == "--organize" || arg == "-o") {
             args.organize = true;
+        } else if (arg == "--jobs" || arg == "-j") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: " << arg << " requires a number.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.jobs = parseUnsigned(arg, arguments[++i], argv[0]);
+        } else if (arg == "--max-batch" || arg == "--max-delay") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: " << arg << " requires a number.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            const unsigned value = parseUnsigned(arg, arguments[++i], argv[0]);
+            if (arg == "--max-batch") {
+                args.maxBatch = value;
+            } else {
+                args.maxDelayMs = value;
+            }
+        } else if (arg == "--types") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --types requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.typesFile = arguments[++i];
+        } else if (arg == "--keywords") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --keywords requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.keywordsFile = arguments[++i];
+        } else if (arg == "--index") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --index requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.indexFile = arguments[++i];
+        } else if (arg == "--save-plan" || arg == "--apply-plan") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: " << arg << " requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            (arg == "--save-plan" ? args.savePlanFile : args.applyPlanFile) = arguments[++i];
+        } else if (arg == "--journal" || arg == "--resume" || arg == "--undo") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: " << arg << " requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            std::string& file = arg == "--journal" ? args.journalFile
+                              : arg == "--resume" ? args.resumeFile : args.undoFile;
+            file = arguments[++i];
+        } else if (arg == "--stats" || arg.rfind("--stats=", 0) == 0) {
+            if (arg == "--stats" && i + 1 >= arguments.size()) {
+                std::cerr << "Error: --stats requires a format.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.statsFormat = arg == "--stats" ? arguments[++i] : arg.substr(8);
+            if (args.statsFormat != "json") {
+                std::cerr << "Error: --stats expects \"json\".\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+        } else if (arg == "--stats-file") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --stats-file requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.statsFile = arguments[++i];
+            if (args.statsFormat.empty()) {
+                args.statsFormat = "json";
+            }
+        } else if (arg == "--batch") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --batch requires a file (\"-\" for the standard input).\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.batchFile = arguments[++i];
+        } else if (arg == "--log") {
+            if (i + 1 >= arguments.size()) {
+                std::cerr << "Error: --log requires a file.\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
+            args.logFile = arguments[++i];
+        } else if (arg == "--quiet" || arg == "-q") {
+            args.quiet = true;
+        } else if (arg == "--recursive" || arg == "-R") {
+            args.recursive = true;
+        } else if (arg == "--sniff") {
+            args.sniff = true;
+        } else if (arg == "--metadata-dates") {
+            args.metadataDates = true;
+        } else if (arg == "--by-mtime") {
+            args.byMtime = true;
+        } else if (arg == "--watch" || arg == "-w") {
+            args.watch = true;
+        } else if (arg == "--stream") {
+            args.stream = true;
+        } else if (arg == "--io-uring") {
+            args.ioUring = true;
+        } else if (arg == "--dedupe") {
+            const std::string mode = i + 1 < arguments.size() ? arguments[++i] : "";
+            if (mode == "delete") {
+                args.dedupe = DedupeMode::DELETE;
+            } else if (mode == "link") {
+                args.dedupe = DedupeMode::LINK;
+            } else {
+                std::cerr << "Error: --dedupe expects \"delete\" or \"link\".\n";
+                printUsage(argv[0]);
+                exit(1);
+            }
         } else if (arg == "--rename" || arg == "-r") {
             args.rename = true;
             // The next argument should be the pattern
@@ -42,19 +161,65 @@ void CommandLineParser::printUsage(const char* programName) {
     std::cout << "Options:\n";
     std::cout << "  --organize, -o        Organize files based on patterns (default action)\n";
     std::cout << "  --rename, -r PATTERN  Rename files based on pattern\n";
+    std::cout << "  --recursive, -R       Also process files in subdirectories (parallel scan)\n";
+    std::cout << "  --watch, -w           Keep running and organize new files as they arrive\n";
+    std::cout << "  --max-batch N         Watch mode: organize at most N new files per plan (default 10000)\n";
+    std::cout << "  --max-delay MS        Watch mode: organize a new file within MS milliseconds (default 2000)\n";
+    std::cout << "  --stream              Plan and execute while scanning, in constant memory\n";
+    std::cout << "  --jobs, -j N          Execute the plan on N threads (0 = all cores, default 1)\n";
+    std::cout << "  --io-uring            Execute the plan as batches of asynchronous io_uring requests (Linux)\n";
+    std::cout << "  --batch FILE          Organize every directory listed in FILE (\"-\" = stdin), sharing --jobs threads\n";
+    std::cout << "  --types FILE          Add extension categories (lines like \"RawPhotos: .cr2 .nef\")\n";
+    std::cout << "  --keywords FILE       Add keyword folders (lines like \"Clients/Acme: acme, acm-\")\n";
+    std::cout << "  --index FILE          Cache classifications in FILE; re-runs skip unchanged files\n";
+    std::cout << "  --sniff               Detect the type of files with unknown or generic (.txt, .dat) extensions from their content\n";
+    std::cout << "  --metadata-dates      Date photos and videos by their EXIF or MP4/MOV header when the name has none\n";
+    std::cout << "  --by-mtime            Sort files with no other date into YYYY/MM by their modification time\n";
+    std::cout << "  --dedupe MODE         Handle identical files: \"delete\" extra copies or \"link\" them\n";
+    std::cout << "  --save-plan FILE      Save the plan to FILE instead of executing it\n";
+    std::cout << "  --apply-plan FILE     Execute a plan saved with --save-plan, if nothing changed since\n";
+    std::cout << "  --journal FILE        Record the execution in FILE, so it can be resumed or undone\n";
+    std::cout << "  --resume FILE         Finish a run that was interrupted, from its journal\n";
+    std::cout << "  --undo FILE           Revert a run, from its journal\n";
+    std::cout << "  --stats=json          Report phase times, counters and action latencies as JSON\n";
+    std::cout << "  --stats-file FILE     Write the --stats report to FILE instead of the standard output\n";
+    std::cout << "  --quiet, -q           Show no per-action lines or progress, only errors and summaries\n";
+    std::cout << "  --log FILE            Append every action and error to FILE as JSON lines\n";
     std::cout << "  --dry-run, -n         Show what would be done without making changes\n";
     std::cout << "  --help, -h            Show this help message\n\n";
     std::cout << "Pattern placeholders for --rename:\n";
     std::cout << "  {name}      Original filename without extension\n";
     std::cout << "  {ext}       Original file extension\n";
     std::cout << "  {counter}   Incrementing number (optional padding: {counter:3})\n";
-    std::cout << "  {date}      Detected date from filename\n\n";
+    std::cout << "  {date}      Detected date from filename (YYYY-MM)\n\n";
     std::cout << "Examples:\n";
     std::cout << "  " << programName << " --organize\n";
     std::cout << "  " << programName << " --rename \"vacation-{counter:03}.{ext}\"\n";
     std::cout << "  " << programName << " --organize --dry-run\n";
+    std::cout << "  " << programName << " --organize --dedupe link\n";
+    std::cout << "  " << programName << " --watch --max-delay 500\n";
+    std::cout << "  " << programName << " --recursive --stream --jobs 4\n";
+    std::cout << "  " << programName << " --save-plan tonight.plan   (later: --apply-plan tonight.plan)\n";
+    std::cout << "  " << programName << " --recursive --journal run.journal   (then: --undo run.journal)\n";
+    std::cout << "  " << programName << " --batch inboxes.txt --jobs 0 --quiet\n";
 }
 
 bool CommandLineParser::isHelpArgument(const std::string& arg) {
     return arg == "--help" || arg == "-h";
 }
+
+unsigned CommandLineParser::parseUnsigned(const std::string& option, const std::string& value, const char* programName) {
+    size_t parsed = 0;
+    unsigned long number = 0;
+    try {
+        number = std::stoul(value, &parsed);
+    } catch (const std::exception&) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != value.size() || value[0] == '-' || number > 0xFFFFFFFFul) {
+        std::cerr << "Error: " << option << " expects a non-negative number, got \"" << value << "\".\n";
+        printUsage(programName);
+        exit(1);
+    }
+    return static_cast<unsigned>(number);
+}
@@ -3,6 +3,15 @@
 #include <string>
 #include <vector>
 
+/**
+ * @brief What --dedupe does with identical copies of a file.
+ */
+enum class DedupeMode {
+    OFF,      ///< Duplicates are organized like any other file.
+    DELETE,   ///< Keep the first copy, delete the others.
+    LINK      ///< Organize every copy, then make them hard links to the first one.
+};
+
 /**
  * @struct CommandLineArgs
  * @brief Holds the parsed command-line arguments.
@@ -14,7 +23,31 @@ struct CommandLineArgs {
     bool dryRun = false;          ///< True if --dry-run is specified.
     bool organize = false;        ///< True if --organize is specified.
     bool rename = false;          ///< True if --rename is specified.
+    bool recursive = false;       ///< True if --recursive is specified.
+    bool sniff = false;           ///< True if --sniff is specified.
+    bool metadataDates = false;   ///< True if --metadata-dates is specified.
+    bool byMtime = false;         ///< True if --by-mtime is specified.
+    bool watch = false;           ///< True if --watch is specified.
+    bool stream = false;          ///< True if --stream is specified.
+    bool ioUring = false;         ///< True if --io-uring is specified.
+    bool quiet = false;           ///< True if --quiet is specified.
+    unsigned maxBatch = 10000;    ///< The largest batch of new files in watch mode (--max-batch).
+    unsigned maxDelayMs = 2000;   ///< The longest a new file waits for its batch (--max-delay).
+    DedupeMode dedupe = DedupeMode::OFF; ///< The mode given with --dedupe.
+    unsigned jobs = 1;            ///< Executor threads from --jobs (0 = one per hardware thread).
     std::string renamePattern;    ///< The pattern string for renaming, if applicable.
+    std::string typesFile;        ///< Extra extension-to-category rules from --types.
+    std::string keywordsFile;     ///< Extra keyword-to-folder rules from --keywords.
+    std::string indexFile;        ///< The classification cache from --index.
+    std::string savePlanFile;     ///< Where --save-plan writes the plan instead of running it.
+    std::string applyPlanFile;    ///< The saved plan to run from --apply-plan.
+    std::string journalFile;      ///< Where --journal records the execution.
+    std::string resumeFile;       ///< The journal of an interrupted run, from --resume.
+    std::string undoFile;         ///< The journal of a run to revert, from --undo.
+    std::string batchFile;        ///< The list of roots from --batch ("-" for stdin).
+    std::string statsFormat;      ///< The report format from --stats ("json"), empty if none.
+    std::string statsFile;        ///< Where --stats-file writes the report instead of stdout.
+    std::string logFile;          ///< Where --log appends the per-action records as JSON lines.
 };
 
 /**
@@ -48,4 +81,13 @@ private:
      * @brief Checks if a given argument is a help flag.
      */
     static bool isHelpArgument(const std::string& arg);
+
+    /**
+     * @brief Parses the numeric value of an option, exiting with usage on bad input.
+     *
+     * @param option The option being parsed (for the error message).
+     * @param value The text to parse.
+     * @param programName The name of the executable, for the usage text.
+     */
+    static unsigned parseUnsigned(const std::string& option, const std::string& value, const char* programName);
 };
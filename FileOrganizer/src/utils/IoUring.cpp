@@ -0,0 +1,236 @@
+#include "IoUring.h"
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+} // namespace
+
+IoUring::~IoUring() {
+    close();
+}
+
+bool IoUring::open(unsigned entries) {
+    close();
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = ioUringSetup(entries, &params);
+    if (ringFd < 0) {
+        failure = std::string("io_uring_setup: ") + std::strerror(errno);
+        return false;
+    }
+
+    // The three regions shared with the kernel
+    sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping) {
+        sqMappingSize = cqMappingSize = std::max(sqMappingSize, cqMappingSize);
+    }
+    sqMapping = ::mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd, IORING_OFF_SQ_RING);
+    if (sqMapping == MAP_FAILED) {
+        sqMapping = nullptr;
+        failure = std::string("mmap: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    if (singleMapping) {
+        cqMapping = sqMapping;
+    } else {
+        cqMapping = ::mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ringFd, IORING_OFF_CQ_RING);
+        if (cqMapping == MAP_FAILED) {
+            cqMapping = nullptr;
+            failure = std::string("mmap: ") + std::strerror(errno);
+            close();
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqeMapping = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ringFd, IORING_OFF_SQES);
+    if (sqeMapping == MAP_FAILED) {
+        failure = std::string("mmap: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(sqeMapping);
+
+    auto* sq = static_cast<unsigned char*>(sqMapping);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ringEntries = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    localTail = submitted = *sqTail;
+
+    auto* cq = static_cast<unsigned char*>(cqMapping);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // The kernel may have io_uring but predate the path operations
+    constexpr unsigned kProbeOps = 256;
+    std::vector<unsigned char> probeBuffer(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op), 0);
+    auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+    if (ioUringRegister(ringFd, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+        failure = std::string("io_uring probe: ") + std::strerror(errno);
+        close();
+        return false;
+    }
+    for (unsigned op : {IORING_OP_MKDIRAT, IORING_OP_RENAMEAT, IORING_OP_STATX}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            failure = "the kernel's io_uring lacks mkdirat, renameat or statx";
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned IoUring::queued() const {
+    return localTail - submitted;
+}
+
+io_uring_sqe* IoUring::nextSqe() {
+    const unsigned index = localTail & sqMask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    ++localTail;
+    return sqe;
+}
+
+void IoUring::mkdirat(int dirFd, const char* path, unsigned mode, uint64_t tag, bool linkNext) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_MKDIRAT;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->len = mode;
+    sqe->user_data = tag;
+    if (linkNext) {
+        sqe->flags |= IOSQE_IO_HARDLINK;
+    }
+}
+
+void IoUring::renameat(int oldDirFd, const char* oldPath, int newDirFd, const char* newPath,
+                       unsigned flags, uint64_t tag) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_RENAMEAT;
+    sqe->fd = oldDirFd;
+    sqe->addr = reinterpret_cast<uint64_t>(oldPath);
+    sqe->len = static_cast<unsigned>(newDirFd);
+    sqe->addr2 = reinterpret_cast<uint64_t>(newPath);
+    sqe->rename_flags = flags;
+    sqe->user_data = tag;
+}
+
+void IoUring::statx(int dirFd, const char* path, int flags, unsigned mask, struct statx* out, uint64_t tag) {
+    io_uring_sqe* sqe = nextSqe();
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = dirFd;
+    sqe->addr = reinterpret_cast<uint64_t>(path);
+    sqe->len = mask;
+    sqe->off = reinterpret_cast<uint64_t>(out);
+    sqe->statx_flags = static_cast<uint32_t>(flags);
+    sqe->user_data = tag;
+}
+
+bool IoUring::submit(unsigned waitFor) {
+    const unsigned toSubmit = localTail - submitted;
+    __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+    submitted = localTail;
+    pending += toSubmit;
+
+    unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+    unsigned remaining = toSubmit;
+    while (remaining > 0 || waitFor > 0) {
+        const int result = ioUringEnter(ringFd, remaining, waitFor, flags);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failure = std::string("io_uring_enter: ") + std::strerror(errno);
+            pending -= remaining;
+            return false;
+        }
+        remaining -= std::min<unsigned>(remaining, static_cast<unsigned>(result));
+        if (remaining == 0) {
+            break;
+        }
+        if (result == 0) {
+            failure = "io_uring_enter: no request was accepted";
+            pending -= remaining;
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoUring::close() {
+    if (sqes) {
+        ::munmap(sqes, sqesSize);
+        sqes = nullptr;
+    }
+    if (cqMapping && cqMapping != sqMapping) {
+        ::munmap(cqMapping, cqMappingSize);
+    }
+    cqMapping = nullptr;
+    if (sqMapping) {
+        ::munmap(sqMapping, sqMappingSize);
+        sqMapping = nullptr;
+    }
+    if (ringFd >= 0) {
+        ::close(ringFd);
+        ringFd = -1;
+    }
+    pending = 0;
+    ringEntries = 0;
+}
+
+#else
+
+IoUring::~IoUring() = default;
+
+bool IoUring::open(unsigned) {
+    failure = "io_uring is only available on Linux";
+    return false;
+}
+
+unsigned IoUring::queued() const {
+    return 0;
+}
+
+void IoUring::mkdirat(int, const char*, unsigned, uint64_t, bool) {}
+
+void IoUring::renameat(int, const char*, int, const char*, unsigned, uint64_t) {}
+
+void IoUring::statx(int, const char*, int, unsigned, struct statx*, uint64_t) {}
+
+bool IoUring::submit(unsigned) {
+    return false;
+}
+
+void IoUring::close() {}
+
+#endif
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+/**
+ * @class IoUring
+ * @brief A minimal io_uring instance, driven with the raw system calls.
+ *
+ * Only what the executor needs is wrapped: queueing mkdirat, renameat and statx
+ * requests, submitting them in one system call, and reaping their completions.
+ * Each request carries a 64-bit tag that comes back with its result.
+ *
+ * open() fails on kernels without io_uring, where it is disabled, or where one of
+ * the operations is missing (they arrived in Linux 5.11 and 5.15), so callers can
+ * fall back to plain system calls. On other platforms it always fails.
+ *
+ * The caller keeps queued() + inFlight() within entries(), so the completion queue
+ * can never overflow, and keeps the path strings passed in valid until the request
+ * completes. Not thread-safe: one thread submits and reaps.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * @brief Sets up a ring with room for `entries` queued requests.
+     *
+     * @return True if the ring is usable; otherwise error() says why.
+     */
+    bool open(unsigned entries);
+
+    /**
+     * @brief Why open() or submit() failed.
+     */
+    const std::string& error() const { return failure; }
+
+    /**
+     * @brief The size of the submission queue.
+     */
+    unsigned entries() const { return ringEntries; }
+
+    /**
+     * @brief The number of requests queued since the last submit().
+     */
+    unsigned queued() const;
+
+    /**
+     * @brief The number of submitted requests whose completion was not reaped yet.
+     */
+    size_t inFlight() const { return pending; }
+
+    /**
+     * @brief Queues a mkdirat(dirFd, path, mode).
+     *
+     * @param linkNext Start the next queued request only after this one completes,
+     *        whatever its result (IOSQE_IO_HARDLINK).
+     */
+    void mkdirat(int dirFd, const char* path, unsigned mode, uint64_t tag, bool linkNext = false);
+
+    /**
+     * @brief Queues a renameat2(oldDirFd, oldPath, newDirFd, newPath, flags).
+     */
+    void renameat(int oldDirFd, const char* oldPath, int newDirFd, const char* newPath,
+                  unsigned flags, uint64_t tag);
+
+    /**
+     * @brief Queues a statx(dirFd, path, flags, mask, out).
+     */
+    void statx(int dirFd, const char* path, int flags, unsigned mask, struct statx* out, uint64_t tag);
+
+    /**
+     * @brief Submits the queued requests and waits for at least `waitFor` completions.
+     *
+     * @return False if the kernel rejected the submission. The requests it did not
+     *         accept are left out of inFlight(); those it accepted still complete.
+     */
+    bool submit(unsigned waitFor = 0);
+
+    /**
+     * @brief Reaps the available completions, calling `handler(tag, result)` for each.
+     *
+     * The result is what the system call would have returned, or -errno.
+     */
+    template <typename Handler>
+    size_t reap(Handler&& handler);
+
+private:
+#ifdef __linux__
+    int ringFd = -1;
+    void* sqMapping = nullptr;
+    size_t sqMappingSize = 0;
+    void* cqMapping = nullptr;
+    size_t cqMappingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    // Submission queue
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned localTail = 0;       ///< Tail including the requests not yet published.
+    unsigned submitted = 0;       ///< Tail as last published to the kernel.
+
+    // Completion queue
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    io_uring_sqe* nextSqe();
+#endif
+    unsigned ringEntries = 0;
+    size_t pending = 0;
+    std::string failure;
+
+    void close();
+};
+
+#ifdef __linux__
+
+template <typename Handler>
+size_t IoUring::reap(Handler&& handler) {
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    for (; head != tail; ++head, ++count) {
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        handler(static_cast<uint64_t>(cqe.user_data), cqe.res);
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    pending -= count;
+    return count;
+}
+
+#else
+
+template <typename Handler>
+size_t IoUring::reap(Handler&&) {
+    return 0;
+}
+
+#endif
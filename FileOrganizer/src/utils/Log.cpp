@@ -0,0 +1,426 @@
+#include "Log.h"
+#include "ProgressReporter.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kCapacity = 8192;                                  ///< Slots in the ring; a power of two.
+constexpr size_t kWriteChunk = 256 * 1024;                          ///< Buffered bytes that force a write.
+constexpr auto kWriteInterval = std::chrono::milliseconds(50);      ///< Longest a record waits in a buffer.
+constexpr auto kProgressInterval = std::chrono::milliseconds(100);  ///< Fastest progress redraw.
+constexpr auto kTick = std::chrono::milliseconds(10);               ///< Idle wait of the writer thread.
+
+struct Record {
+    Log::Level level = Log::INFO;
+    const char* event = "";
+    std::string message;
+    std::string source;
+    std::string destination;
+    std::chrono::system_clock::time_point time;
+};
+
+struct Slot {
+    std::atomic<size_t> sequence{0};
+    Record record;
+};
+
+/**
+ * @brief The latest progress, published by the executor and drawn by whoever draws.
+ */
+struct Progress {
+    std::atomic<int> current{0};
+    std::atomic<int> total{0};
+    std::atomic<bool> counting{false};   ///< Total unknown: `current` succeeded, `total` failed.
+    std::atomic<uint64_t> version{0};    ///< Bumped on every update.
+};
+
+struct State {
+    Log::Options options;
+    std::FILE* file = nullptr;
+    std::unique_ptr<Slot[]> slots;
+
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;      ///< Writer thread only.
+
+    std::mutex mutex;                       ///< Guards the fields below and the waits.
+    std::condition_variable wake;           ///< Wakes the writer thread.
+    std::condition_variable written;        ///< Wakes flush().
+    size_t writtenPos = 0;                  ///< Records up to here are out of the buffers.
+    size_t flushTarget = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    Progress progress;
+    std::mutex drawMutex;                   ///< Serializes ProgressReporter.
+    uint64_t drawnVersion = 0;              ///< Under drawMutex.
+    uint64_t finishedVersion = 0;           ///< Under drawMutex.
+    bool progressShown = false;             ///< Under drawMutex.
+    Clock::time_point lastDraw;             ///< Under drawMutex.
+
+    std::mutex syncMutex;                   ///< Serializes the synchronous writes.
+};
+
+// Never destroyed, so records logged during static destruction are still safe
+State& state() {
+    static State* instance = new State;
+    return *instance;
+}
+
+bool showsProgress() {
+    return !state().options.quiet;
+}
+
+// Under drawMutex
+void drawProgress(State& s) {
+    const Progress& p = s.progress;
+    s.drawnVersion = p.version.load(std::memory_order_acquire);
+    if (p.counting.load(std::memory_order_relaxed)) {
+        ProgressReporter::reportCount(p.current.load(std::memory_order_relaxed),
+                                      p.total.load(std::memory_order_relaxed));
+    } else {
+        ProgressReporter::report(p.current.load(std::memory_order_relaxed),
+                                 p.total.load(std::memory_order_relaxed));
+    }
+    s.progressShown = true;
+    s.lastDraw = Clock::now();
+}
+
+// Under drawMutex
+void redrawIfDue(State& s) {
+    const uint64_t version = s.progress.version.load(std::memory_order_acquire);
+    if (!showsProgress() || version == s.drawnVersion || version == s.finishedVersion ||
+        Clock::now() - s.lastDraw < kProgressInterval) {
+        return;
+    }
+    drawProgress(s);
+}
+
+void appendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+void appendJsonLine(std::string& out, const Record& record) {
+    const auto sinceEpoch = record.time.time_since_epoch();
+    const std::time_t seconds = static_cast<std::time_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count());
+    const int millis = static_cast<int>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch).count() % 1000);
+    char time[40];
+    const std::tm* utc = std::gmtime(&seconds);  // Only the writer thread formats
+    const size_t length = std::strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", utc);
+    std::snprintf(time + length, sizeof(time) - length, ".%03dZ", millis);
+
+    out += "{\"time\":\"";
+    out += time;
+    out += record.level == Log::ERROR ? "\",\"level\":\"error\",\"event\":\"" : "\",\"level\":\"info\",\"event\":\"";
+    out += record.event;
+    out += '"';
+    if (!record.source.empty()) {
+        out += ",\"source\":";
+        appendJsonString(out, record.source);
+    }
+    if (!record.destination.empty()) {
+        out += ",\"destination\":";
+        appendJsonString(out, record.destination);
+    }
+    out += ",\"message\":";
+    appendJsonString(out, record.message);
+    out += "}\n";
+}
+
+/**
+ * @brief The writer thread's buffers, written out in one call each.
+ */
+struct Buffers {
+    std::string out;
+    std::string err;
+    std::string file;
+    Clock::time_point lastWrite = Clock::now();
+
+    bool empty() const { return out.empty() && err.empty() && file.empty(); }
+    size_t size() const { return out.size() + err.size() + file.size(); }
+
+    void add(State& s, const Record& record) {
+        if (record.level == Log::ERROR) {
+            err += record.message;
+            err += '\n';
+        } else if (!s.options.quiet) {
+            out += record.message;
+            out += '\n';
+        }
+        if (s.file) {
+            appendJsonLine(file, record);
+        }
+    }
+
+    void write(State& s) {
+        if (!out.empty() || !err.empty()) {
+            std::lock_guard<std::mutex> lock(s.drawMutex);
+            const bool redraw = s.progressShown;
+            if (redraw) {
+                ProgressReporter::clear();
+                s.progressShown = false;
+            }
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+            std::fwrite(err.data(), 1, err.size(), stderr);
+            std::fflush(stderr);
+            if (redraw) {
+                drawProgress(s);
+            }
+        }
+        if (!file.empty()) {
+            std::fwrite(file.data(), 1, file.size(), s.file);
+            std::fflush(s.file);
+        }
+        out.clear();
+        err.clear();
+        file.clear();
+        lastWrite = Clock::now();
+    }
+};
+
+void writerLoop() {
+    State& s = state();
+    Buffers buffers;
+    while (true) {
+        // Drain what was published
+        while (true) {
+            Slot& slot = s.slots[s.dequeuePos & (kCapacity - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != s.dequeuePos + 1) {
+                break;
+            }
+            Record record = std::move(slot.record);
+            slot.sequence.store(s.dequeuePos + kCapacity, std::memory_order_release);
+            ++s.dequeuePos;
+            buffers.add(s, record);
+            if (buffers.size() >= kWriteChunk) {
+                buffers.write(s);
+            }
+        }
+
+        bool flushing;
+        bool stopping;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            flushing = s.flushTarget > s.writtenPos;
+            stopping = s.stopping;
+        }
+        if (!buffers.empty() && (flushing || stopping || Clock::now() - buffers.lastWrite >= kWriteInterval)) {
+            buffers.write(s);
+        }
+        {
+            std::lock_guard<std::mutex> lock(s.drawMutex);
+            redrawIfDue(s);
+        }
+
+        std::unique_lock<std::mutex> lock(s.mutex);
+        if (buffers.empty()) {
+            s.writtenPos = s.dequeuePos;
+            s.written.notify_all();
+        }
+        if (s.stopping && buffers.empty() && s.dequeuePos == s.enqueuePos.load(std::memory_order_acquire)) {
+            break;
+        }
+        s.wake.wait_for(lock, kTick, [&] { return s.stopping || s.flushTarget > s.writtenPos; });
+    }
+}
+
+void writeSynchronously(Record&& record) {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.syncMutex);
+    std::lock_guard<std::mutex> drawLock(s.drawMutex);
+    if (s.progressShown) {
+        ProgressReporter::clear();
+        s.progressShown = false;
+    }
+    if (record.level == Log::ERROR) {
+        std::cerr << record.message << "\n";
+    } else {
+        std::cout << record.message << "\n";
+    }
+}
+
+} // namespace
+
+std::atomic<bool> Log::running{false};
+
+void Log::start(const Options& options) {
+    State& s = state();
+    if (running.load()) {
+        return;
+    }
+    s.options = options;
+    if (!options.file.empty()) {
+        s.file = std::fopen(options.file.c_str(), "a");
+        if (!s.file) {
+            throw std::runtime_error("Cannot open log file " + options.file + ": " + std::strerror(errno));
+        }
+    }
+    s.slots.reset(new Slot[kCapacity]);
+    for (size_t i = 0; i < kCapacity; ++i) {
+        s.slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    s.enqueuePos.store(0, std::memory_order_relaxed);
+    s.dequeuePos = 0;
+    s.writtenPos = 0;
+    s.flushTarget = 0;
+    s.stopping = false;
+    s.writer = std::thread(writerLoop);
+    running.store(true, std::memory_order_release);
+}
+
+void Log::stop() {
+    State& s = state();
+    if (!running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.stopping = true;
+    }
+    s.wake.notify_all();
+    s.writer.join();
+    if (s.file) {
+        std::fclose(s.file);
+        s.file = nullptr;
+    }
+}
+
+bool Log::enabled(Level level) {
+    const State& s = state();
+    return level == ERROR || !s.options.quiet || s.file != nullptr;
+}
+
+void Log::write(Level level, const char* event, std::string message, std::string source, std::string destination) {
+    if (!enabled(level)) {
+        return;
+    }
+    Record record;
+    record.level = level;
+    record.event = event;
+    record.message = std::move(message);
+    record.source = std::move(source);
+    record.destination = std::move(destination);
+
+    State& s = state();
+    if (!running.load(std::memory_order_acquire)) {
+        writeSynchronously(std::move(record));
+        return;
+    }
+    if (s.file) {
+        record.time = std::chrono::system_clock::now();
+    }
+
+    // Claim a slot: one CAS, unless the ring is full
+    size_t position = s.enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    bool wokeWriter = false;
+    while (true) {
+        slot = &s.slots[position & (kCapacity - 1)];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if (difference == 0) {
+            if (s.enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Full: make sure the writer is not sleeping, then let it run
+            if (!wokeWriter) {
+                s.wake.notify_one();
+                wokeWriter = true;
+            }
+            std::this_thread::yield();
+            position = s.enqueuePos.load(std::memory_order_relaxed);
+        } else {
+            position = s.enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->record = std::move(record);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Log::flush() {
+    State& s = state();
+    if (!running.load(std::memory_order_acquire)) {
+        std::cout << std::flush;
+        return;
+    }
+    std::unique_lock<std::mutex> lock(s.mutex);
+    const size_t target = s.enqueuePos.load(std::memory_order_acquire);
+    s.flushTarget = std::max(s.flushTarget, target);
+    s.wake.notify_all();
+    s.written.wait(lock, [&] { return s.writtenPos >= target; });
+}
+
+void Log::progress(int current, int total) {
+    State& s = state();
+    s.progress.current.store(current, std::memory_order_relaxed);
+    s.progress.total.store(total, std::memory_order_relaxed);
+    s.progress.counting.store(false, std::memory_order_relaxed);
+    s.progress.version.fetch_add(1, std::memory_order_release);
+    if (!running.load(std::memory_order_acquire) && showsProgress()) {
+        std::lock_guard<std::mutex> lock(s.drawMutex);
+        redrawIfDue(s);
+    }
+}
+
+void Log::progressCount(int succeeded, int failed) {
+    State& s = state();
+    s.progress.current.store(succeeded, std::memory_order_relaxed);
+    s.progress.total.store(failed, std::memory_order_relaxed);
+    s.progress.counting.store(true, std::memory_order_relaxed);
+    s.progress.version.fetch_add(1, std::memory_order_release);
+    if (!running.load(std::memory_order_acquire) && showsProgress()) {
+        std::lock_guard<std::mutex> lock(s.drawMutex);
+        redrawIfDue(s);
+    }
+}
+
+void Log::finishProgress() {
+    flush();
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.drawMutex);
+    const uint64_t version = s.progress.version.load(std::memory_order_acquire);
+    if (version == s.finishedVersion) {
+        return;
+    }
+    s.finishedVersion = version;
+    if (!showsProgress()) {
+        return;
+    }
+    if (!s.progressShown || s.drawnVersion != version) {
+        drawProgress(s);
+    }
+    std::cout << "\n" << std::flush;
+    s.progressShown = false;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+/**
+ * @class Log
+ * @brief The per-action output: an asynchronous, buffered sink and a rate-limited
+ *        progress line.
+ *
+ * Threads hand their records to a lock-free, bounded ring of slots (a Vyukov MPSC
+ * queue): claiming a slot is one compare-and-swap, and the strings are moved in, not
+ * copied. A background thread drains the ring into large buffers and writes each
+ * with a single call, to the standard output (errors to the standard error) or, with
+ * a log file, as JSON lines. A producer only waits when the ring is full.
+ *
+ * Progress is only stored by the executor; the background thread redraws it with
+ * ProgressReporter at most every kProgressInterval, erasing it before writing
+ * records so the two never share a line.
+ *
+ * Anything printed directly to std::cout must come after a flush(), so that it
+ * appears after the records logged before it. Until start() (or after stop()),
+ * records are written synchronously, so the class also works in tools that never
+ * start it.
+ */
+class Log {
+public:
+    enum Level {
+        INFO,     ///< One line per action; hidden by --quiet unless a log file is set.
+        ERROR     ///< Always shown on the standard error, and written to the log file.
+    };
+
+    /**
+     * @brief Where the records go.
+     */
+    struct Options {
+        bool quiet = false;     ///< No per-action lines and no progress on the terminal.
+        std::string file;       ///< Append the records to this file as JSON lines.
+    };
+
+    /**
+     * @brief Starts the background thread.
+     *
+     * @throws std::runtime_error If the log file cannot be opened.
+     */
+    static void start(const Options& options);
+
+    /**
+     * @brief Writes everything still queued and stops the background thread.
+     */
+    static void stop();
+
+    /**
+     * @brief Checks whether records of a level are written anywhere.
+     *
+     * Lets callers skip formatting a record that would be thrown away.
+     */
+    static bool enabled(Level level);
+
+    /**
+     * @brief Queues a record.
+     *
+     * @param level The level of the record.
+     * @param event A short, constant name for the log file ("moved", "error", ...).
+     * @param message The line shown on the terminal, without the newline.
+     * @param source The file acted on, if any (log file only).
+     * @param destination Where it went, if anywhere (log file only).
+     */
+    static void write(Level level, const char* event, std::string message,
+                      std::string source = std::string(), std::string destination = std::string());
+
+    /**
+     * @brief Waits until every record queued so far has been written.
+     */
+    static void flush();
+
+    /**
+     * @brief Sets the progress of a run with a known number of steps.
+     */
+    static void progress(int current, int total);
+
+    /**
+     * @brief Sets the progress of a run whose total is not known (--stream).
+     */
+    static void progressCount(int succeeded, int failed);
+
+    /**
+     * @brief Writes the queued records, draws the final progress and ends its line.
+     *
+     * Does nothing if no progress was set since the last call.
+     */
+    static void finishProgress();
+
+private:
+    static std::atomic<bool> running;
+};
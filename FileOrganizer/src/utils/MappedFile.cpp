@@ -0,0 +1,63 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iterator>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const fs::path& file) {
+    close();
+
+#ifdef __linux__
+    const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* address = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    mapping = static_cast<const unsigned char*>(address);
+    mappingSize = static_cast<size_t>(st.st_size);
+#else
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    fallbackCopy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (fallbackCopy.empty()) {
+        return false;
+    }
+    mapping = fallbackCopy.data();
+    mappingSize = fallbackCopy.size();
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef __linux__
+    if (mapping) {
+        ::munmap(const_cast<unsigned char*>(mapping), mappingSize);
+    }
+#else
+    fallbackCopy.clear();
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
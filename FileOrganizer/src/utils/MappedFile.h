@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+/**
+ * @class MappedFile
+ * @brief A whole file mapped into memory read-only.
+ *
+ * Binary files written by the organizer (the scan index, saved plans) are used in
+ * place rather than parsed, so opening one costs a single mmap whatever its size.
+ * Where mmap is unavailable the file is read into a buffer instead.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Maps a file, replacing any file mapped before.
+     *
+     * @param file The file to map.
+     * @return False if the file cannot be opened or is empty.
+     */
+    bool open(const std::filesystem::path& file);
+
+    /**
+     * @brief Unmaps the file.
+     */
+    void close();
+
+    const unsigned char* data() const { return mapping; }
+    size_t size() const { return mappingSize; }
+
+private:
+    const unsigned char* mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<unsigned char> fallbackCopy;   ///< Holds the file where mmap is unavailable.
+};
@@ -1,14 +1,35 @@
 #include "ProgressReporter.h"
 #include <iostream>
-#include <iomanip>
+
+size_t ProgressReporter::shownLength = 0;
 
 void ProgressReporter::report(int current, int total, const std::string& message) {
     if (total <= 0) return;
 
     // Calculate percentage
-    int percentage = (current * 100) / total;
+    int percentage = static_cast<int>((static_cast<long long>(current) * 100) / total);
 
     // Print progress on a single line
-    std::cout << "\r" << message << ": " << current << "/" << total 
-              << " (" << percentage << "%)          " << std::flush;
+    draw(message + ": " + std::to_string(current) + "/" + std::to_string(total) +
+         " (" + std::to_string(percentage) + "%)");
+}
+
+void ProgressReporter::reportCount(int succeeded, int failed, const std::string& message) {
+    std::string line = message + ": " + std::to_string(succeeded) + " done";
+    if (failed > 0) {
+        line += ", " + std::to_string(failed) + " failed";
+    }
+    draw(line);
+}
+
+void ProgressReporter::clear() {
+    if (shownLength == 0) return;
+    std::cout << "\r" << std::string(shownLength, ' ') << "\r" << std::flush;
+    shownLength = 0;
+}
+
+void ProgressReporter::draw(const std::string& line) {
+    // Trailing spaces cover the rest of a longer line drawn before
+    std::cout << "\r" << line << "          " << std::flush;
+    shownLength = line.size() + 10;
 }
@@ -8,6 +8,8 @@
  *
  * This class provides a clean interface for displaying progress, abstracting
  * the console output logic from the core application components.
+ *
+ * Not thread-safe: one thread at a time draws the progress line.
  */
 class ProgressReporter {
 public:
@@ -21,4 +23,23 @@ public:
      * @param message An optional message to display alongside the progress bar.
      */
     static void report(int current, int total, const std::string& message = "Progress");
+
+    /**
+     * @brief Reports the progress of a task whose total is not known.
+     *
+     * @param succeeded The number of items completed.
+     * @param failed The number of items that failed; shown only if not 0.
+     * @param message An optional message to display alongside the count.
+     */
+    static void reportCount(int succeeded, int failed, const std::string& message = "Progress");
+
+    /**
+     * @brief Erases the progress line, so other output can start at its beginning.
+     */
+    static void clear();
+
+private:
+    static void draw(const std::string& line);
+
+    static size_t shownLength;   ///< The length of the line on screen, 0 if none.
 };
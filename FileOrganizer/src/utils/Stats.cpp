@@ -0,0 +1,268 @@
+#include "Stats.h"
+#include <algorithm>
+#include <array>
+#include <ctime>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const char* const kPhaseNames[Stats::kPhaseCount] = {
+    "scan", "classify", "sniff", "metadata", "dedupe", "plan", "execute", "undo",
+};
+
+const char* const kCounterNames[Stats::kCounterCount] = {
+    "files_scanned", "directories_scanned", "metadata_stats", "exists_probes", "directory_listings",
+    "conflicts_resolved", "directories_created", "renames", "exdev_fallbacks",
+    "links_created", "files_deleted", "errors",
+};
+
+const char* const kActionNames[Stats::kActionTypes] = {
+    "move", "rename", "create_dir", "hardlink", "delete_duplicate",
+};
+
+/**
+ * @brief Everything one thread records. Only the owning thread writes to it.
+ */
+struct Block {
+    std::atomic<uint64_t> counters[Stats::kCounterCount] = {};
+    std::atomic<uint64_t> phaseWallNs[Stats::kPhaseCount] = {};
+    std::atomic<uint64_t> phaseCpuNs[Stats::kPhaseCount] = {};
+    std::atomic<uint64_t> phaseCalls[Stats::kPhaseCount] = {};
+    std::atomic<uint64_t> buckets[Stats::kActionTypes][Stats::kBuckets] = {};
+    std::atomic<uint64_t> latencyNs[Stats::kActionTypes] = {};
+    std::atomic<uint64_t> latencyMaxNs[Stats::kActionTypes] = {};
+};
+
+/**
+ * @brief Plain sums of blocks, for the finished threads and for reports.
+ */
+struct Totals {
+    uint64_t counters[Stats::kCounterCount] = {};
+    uint64_t phaseWallNs[Stats::kPhaseCount] = {};
+    uint64_t phaseCpuNs[Stats::kPhaseCount] = {};
+    uint64_t phaseCalls[Stats::kPhaseCount] = {};
+    uint64_t buckets[Stats::kActionTypes][Stats::kBuckets] = {};
+    uint64_t latencyNs[Stats::kActionTypes] = {};
+    uint64_t latencyMaxNs[Stats::kActionTypes] = {};
+    size_t threads = 0;
+
+    void add(const Block& block) {
+        auto load = [](const std::atomic<uint64_t>& value) { return value.load(std::memory_order_relaxed); };
+        for (unsigned i = 0; i < Stats::kCounterCount; ++i) {
+            counters[i] += load(block.counters[i]);
+        }
+        for (unsigned i = 0; i < Stats::kPhaseCount; ++i) {
+            phaseWallNs[i] += load(block.phaseWallNs[i]);
+            phaseCpuNs[i] += load(block.phaseCpuNs[i]);
+            phaseCalls[i] += load(block.phaseCalls[i]);
+        }
+        for (unsigned type = 0; type < Stats::kActionTypes; ++type) {
+            for (unsigned b = 0; b < Stats::kBuckets; ++b) {
+                buckets[type][b] += load(block.buckets[type][b]);
+            }
+            latencyNs[type] += load(block.latencyNs[type]);
+            latencyMaxNs[type] = std::max(latencyMaxNs[type], load(block.latencyMaxNs[type]));
+        }
+        ++threads;
+    }
+};
+
+/**
+ * @brief The blocks of the running threads and the totals of the finished ones.
+ *
+ * Never destroyed, so that threads ending during static destruction can still
+ * unregister.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<const Block*> live;
+    Totals retired;
+};
+
+Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+/**
+ * @brief Registers a thread's block on its first use and folds it in when it ends.
+ */
+struct ThreadBlock {
+    Block block;
+
+    ThreadBlock() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.push_back(&block);
+    }
+
+    ~ThreadBlock() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.retired.add(block);
+        r.live.erase(std::find(r.live.begin(), r.live.end(), &block));
+    }
+};
+
+Block& threadBlock() {
+    thread_local ThreadBlock instance;
+    return instance.block;
+}
+
+// The owner is the only writer, so a plain load and store is enough
+void bump(std::atomic<uint64_t>& slot, uint64_t n) {
+    slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+uint64_t processCpuNs() {
+#ifdef __linux__
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+#else
+    return static_cast<uint64_t>(std::clock()) * (1000000000ULL / CLOCKS_PER_SEC);
+#endif
+}
+
+unsigned bucketOf(uint64_t ns) {
+    unsigned bucket = 0;
+    while (ns > 0 && bucket + 1 < Stats::kBuckets) {
+        ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/**
+ * @brief The latency below which a share `p` of the recorded actions fall, in ns.
+ */
+uint64_t percentile(const uint64_t (&buckets)[Stats::kBuckets], uint64_t count, uint64_t maxNs, double p) {
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(count) + 0.5));
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < Stats::kBuckets; ++b) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return std::min(uint64_t(1) << b, maxNs);
+        }
+    }
+    return maxNs;
+}
+
+} // namespace
+
+std::atomic<bool> Stats::active{false};
+
+void Stats::enable() {
+    active.store(true, std::memory_order_relaxed);
+}
+
+void Stats::addToThread(Counter counter, uint64_t n) {
+    bump(threadBlock().counters[counter], n);
+}
+
+void Stats::recordLatency(unsigned actionType, std::chrono::nanoseconds latency) {
+    if (!enabled() || actionType >= kActionTypes) {
+        return;
+    }
+    const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(0, latency.count()));
+    Block& block = threadBlock();
+    bump(block.buckets[actionType][bucketOf(ns)], 1);
+    bump(block.latencyNs[actionType], ns);
+    if (ns > block.latencyMaxNs[actionType].load(std::memory_order_relaxed)) {
+        block.latencyMaxNs[actionType].store(ns, std::memory_order_relaxed);
+    }
+}
+
+Stats::PhaseTimer::PhaseTimer(Phase phase) : phase(phase), running(enabled()) {
+    if (running) {
+        wallStart = std::chrono::steady_clock::now();
+        cpuStart = processCpuNs();
+    }
+}
+
+void Stats::PhaseTimer::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    const auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - wallStart);
+    Block& block = threadBlock();
+    bump(block.phaseWallNs[phase], static_cast<uint64_t>(wall.count()));
+    bump(block.phaseCpuNs[phase], processCpuNs() - cpuStart);
+    bump(block.phaseCalls[phase], 1);
+}
+
+Stats::ActionTimer::ActionTimer(unsigned actionType) : actionType(actionType), running(enabled()) {
+    if (running) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+Stats::ActionTimer::~ActionTimer() {
+    if (running) {
+        recordLatency(actionType, std::chrono::steady_clock::now() - start);
+    }
+}
+
+void Stats::writeJson(std::ostream& out) {
+    Totals totals;
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        totals = r.retired;
+        for (const Block* block : r.live) {
+            totals.add(*block);
+        }
+    }
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << std::fixed << std::setprecision(6);
+    out << "{\n  \"phases\": {";
+    for (unsigned i = 0; i < kPhaseCount; ++i) {
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << kPhaseNames[i] << "\": {\"wall_s\": "
+            << totals.phaseWallNs[i] / 1e9 << ", \"cpu_s\": " << totals.phaseCpuNs[i] / 1e9
+            << ", \"calls\": " << totals.phaseCalls[i] << "}";
+    }
+    out << "\n  },\n  \"counters\": {";
+    for (unsigned i = 0; i < kCounterCount; ++i) {
+        out << (i == 0 ? "\n" : ",\n") << "    \"" << kCounterNames[i] << "\": " << totals.counters[i];
+    }
+    out << std::setprecision(3) << "\n  },\n  \"actions\": {";
+    for (unsigned type = 0; type < kActionTypes; ++type) {
+        uint64_t count = 0;
+        for (uint64_t n : totals.buckets[type]) {
+            count += n;
+        }
+        const uint64_t maxNs = totals.latencyMaxNs[type];
+        out << (type == 0 ? "\n" : ",\n") << "    \"" << kActionNames[type] << "\": {\"count\": " << count
+            << ", \"total_s\": " << std::setprecision(6) << totals.latencyNs[type] / 1e9 << std::setprecision(3)
+            << ", \"mean_us\": " << (count > 0 ? totals.latencyNs[type] / 1e3 / count : 0.0)
+            << ", \"p50_us\": " << percentile(totals.buckets[type], count, maxNs, 0.50) / 1e3
+            << ", \"p90_us\": " << percentile(totals.buckets[type], count, maxNs, 0.90) / 1e3
+            << ", \"p99_us\": " << percentile(totals.buckets[type], count, maxNs, 0.99) / 1e3
+            << ", \"max_us\": " << maxNs / 1e3 << ", \"histogram\": [";
+        bool first = true;
+        for (unsigned b = 0; b < kBuckets; ++b) {
+            if (totals.buckets[type][b] == 0) {
+                continue;
+            }
+            // The last bucket has no upper bound
+            out << (first ? "" : ", ") << "{\"le_us\": ";
+            if (b + 1 < kBuckets) {
+                out << (uint64_t(1) << b) / 1e3;
+            } else {
+                out << "null";
+            }
+            out << ", \"count\": " << totals.buckets[type][b] << "}";
+            first = false;
+        }
+        out << "]}";
+    }
+    out << "\n  },\n  \"threads\": " << totals.threads << "\n}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @class Stats
+ * @brief Low-overhead run statistics: phase timers, counters and action latencies.
+ *
+ * Recording is off until enable() is called; until then every call returns after
+ * one relaxed atomic load, and the timers do not read the clock.
+ *
+ * Each thread records into its own block, registered on the thread's first use, so
+ * the hot paths of the worker pools never share a cache line or take a lock. A block
+ * is owned by its thread: the owner updates its slots with relaxed loads and stores
+ * (no read-modify-write), and the report reads them with relaxed loads. When a
+ * thread ends, its block is folded into the totals of the finished threads.
+ *
+ * Phase times are the wall and process CPU time spent between a PhaseTimer's
+ * construction and destruction, so the CPU time of a phase includes the worker
+ * threads it keeps busy. In --stream runs the phases overlap, and so do their times.
+ *
+ * Latencies go into a histogram per action type with power-of-two buckets, from
+ * which the percentiles are estimated (each is the upper bound of its bucket).
+ */
+class Stats {
+public:
+    enum Phase {
+        SCAN,             ///< Listing the files.
+        CLASSIFY,         ///< Matching keywords and extensions, with the --index lookups, SNIFF and METADATA.
+        SNIFF,            ///< Reading the content of files with unknown extensions.
+        METADATA,         ///< Reading dates from photo and video headers.
+        DEDUPE,           ///< Finding identical files.
+        PLAN,             ///< Choosing destinations and resolving conflicts.
+        EXECUTE,          ///< Running the plan.
+        UNDO,             ///< Reverting a journal.
+        kPhaseCount
+    };
+
+    enum Counter {
+        FILES_SCANNED,        ///< Files found by a scan.
+        DIRECTORIES_SCANNED,  ///< Directories listed by a scan.
+        METADATA_STATS,       ///< Files stat'ed for their metadata after a scan (see FileMetadata).
+        EXISTS_PROBES,        ///< Checks whether a destination is taken (stat-like calls).
+        DIRECTORY_LISTINGS,   ///< Destination directories listed for conflict resolution.
+        CONFLICTS_RESOLVED,   ///< Destinations given a "(N)" suffix.
+        DIRECTORIES_CREATED,  ///< Directories created by the executor.
+        RENAMES,              ///< Files moved or renamed with a rename call.
+        EXDEV_FALLBACKS,      ///< Moves across filesystems, done as copy and delete.
+        LINKS_CREATED,        ///< Duplicates replaced with hard links.
+        FILES_DELETED,        ///< Duplicates deleted.
+        ERRORS,               ///< Actions that failed.
+        kCounterCount
+    };
+
+    /// One histogram per Action::Type, in the same order.
+    static constexpr unsigned kActionTypes = 5;
+
+    /// Bucket i holds latencies below 2^i ns; the last one everything from 2^38 ns (~4.6 min).
+    static constexpr unsigned kBuckets = 40;
+
+    /**
+     * @brief Starts recording. Meant to be called once, before any work starts.
+     */
+    static void enable();
+
+    /**
+     * @brief Checks whether recording is on.
+     */
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Adds `n` to a counter of the calling thread.
+     */
+    static void add(Counter counter, uint64_t n = 1) {
+        if (enabled()) {
+            addToThread(counter, n);
+        }
+    }
+
+    /**
+     * @brief Records the latency of one action.
+     *
+     * @param actionType The Action::Type of the action.
+     * @param latency How long it took.
+     */
+    static void recordLatency(unsigned actionType, std::chrono::nanoseconds latency);
+
+    /**
+     * @class PhaseTimer
+     * @brief Times a phase from construction to destruction, or to stop().
+     */
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase);
+        ~PhaseTimer() { stop(); }
+
+        /**
+         * @brief Ends the phase early; later calls do nothing.
+         */
+        void stop();
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    private:
+        Phase phase;
+        bool running;
+        std::chrono::steady_clock::time_point wallStart;
+        uint64_t cpuStart = 0;
+    };
+
+    /**
+     * @class ActionTimer
+     * @brief Records the latency of an action from construction to destruction.
+     */
+    class ActionTimer {
+    public:
+        explicit ActionTimer(unsigned actionType);
+        ~ActionTimer();
+
+        ActionTimer(const ActionTimer&) = delete;
+        ActionTimer& operator=(const ActionTimer&) = delete;
+
+    private:
+        unsigned actionType;
+        bool running;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    /**
+     * @brief Writes everything recorded so far as one JSON object.
+     *
+     * Safe to call while other threads are still recording; their latest updates
+     * may be missing.
+     */
+    static void writeJson(std::ostream& out);
+
+private:
+    static std::atomic<bool> active;
+
+    static void addToThread(Counter counter, uint64_t n);
+};
@@ -0,0 +1,138 @@
+#include "WorkStealingPool.h"
+
+namespace {
+// Identifies the pool and worker slot of the current thread, if it is a worker.
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local int currentIndex = -1;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) {
+    const unsigned count = resolveThreadCount(threadCount);
+    workers.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    threads.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        allDone.wait(lock, [this] { return pending.load() == 0; });
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task) {
+    const int self = workerIndex();
+    const unsigned target = self >= 0
+        ? static_cast<unsigned>(self)
+        : nextWorker.fetch_add(1, std::memory_order_relaxed) % size();
+
+    pending.fetch_add(1);
+    {
+        // Counted under the deque's lock, the same lock takeTask() holds to uncount it,
+        // so a thief can never decrement `queued` before this increment
+        std::lock_guard<std::mutex> lock(workers[target]->mutex);
+        workers[target]->tasks.push_back(std::move(task));
+        queued.fetch_add(1);
+    }
+
+    // Taking the state lock orders this notification after any sleeper's predicate check
+    std::lock_guard<std::mutex> lock(stateMutex);
+    workAvailable.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pending.load() == 0; });
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+int WorkStealingPool::workerIndex() const {
+    return currentPool == this ? currentIndex : -1;
+}
+
+unsigned WorkStealingPool::resolveThreadCount(unsigned requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void WorkStealingPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentIndex = static_cast<int>(index);
+
+    while (true) {
+        Task task;
+        if (takeTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool WorkStealingPool::takeTask(unsigned index, Task& task) {
+    // Own deque first, newest task first
+    {
+        Worker& own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Then steal the oldest task from the other workers
+    const unsigned count = size();
+    for (unsigned offset = 1; offset < count; ++offset) {
+        Worker& victim = *workers[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::runTask(Task& task) {
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!firstError) {
+            firstError = std::current_exception();
+        }
+    }
+    // Release captured state before the task counts as finished
+    task = nullptr;
+
+    if (pending.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        allDone.notify_all();
+    }
+}
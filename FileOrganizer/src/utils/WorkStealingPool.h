@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkStealingPool
+ * @brief A fixed-size thread pool where each worker owns a task deque.
+ *
+ * A worker pops tasks from the back of its own deque (newest first, which keeps
+ * recursive work depth-first and cache-friendly) and, when its deque is empty,
+ * steals from the front of the other workers' deques (oldest first, which tends
+ * to hand out the largest remaining pieces of work).
+ *
+ * Tasks may submit further tasks; those land on the submitting worker's own deque.
+ * wait() blocks until every submitted task, including the ones spawned by other
+ * tasks, has finished. If a task throws, the first exception is rethrown by wait().
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @brief Starts the worker threads.
+     *
+     * @param threadCount The number of workers. 0 means one per hardware thread.
+     */
+    explicit WorkStealingPool(unsigned threadCount = 0);
+
+    /**
+     * @brief Waits for outstanding tasks and joins the workers.
+     */
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * @brief Queues a task.
+     *
+     * Called from a worker, the task goes on that worker's deque. Called from any
+     * other thread, the tasks are spread round-robin over the workers.
+     */
+    void submit(Task task);
+
+    /**
+     * @brief Blocks until all submitted tasks have completed.
+     *
+     * Must not be called from inside a task of this pool.
+     */
+    void wait();
+
+    /**
+     * @brief Gets the number of worker threads.
+     */
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    /**
+     * @brief Gets the index of the calling worker thread of this pool.
+     *
+     * Useful for indexing per-thread buffers without locking.
+     *
+     * @return The worker index in [0, size()), or -1 if called from another thread.
+     */
+    int workerIndex() const;
+
+    /**
+     * @brief Resolves a user-supplied thread count.
+     *
+     * @param requested The requested count; 0 means "one per hardware thread".
+     * @return The effective count, always at least 1.
+     */
+    static unsigned resolveThreadCount(unsigned requested);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::atomic<size_t> pending{0};     ///< Submitted tasks that have not finished yet.
+    std::atomic<size_t> queued{0};      ///< Tasks sitting in a deque, not yet picked up.
+    std::atomic<unsigned> nextWorker{0};
+    bool stopping = false;
+    std::exception_ptr firstError;
+
+    void workerLoop(unsigned index);
+    bool takeTask(unsigned index, Task& task);
+    void runTask(Task& task);
+};
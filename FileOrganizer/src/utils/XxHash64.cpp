@@ -0,0 +1,127 @@
+#include "XxHash64.h"
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// The reference hash is defined on little-endian words
+uint64_t read64(const unsigned char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) value = (value << 8) | p[i];
+    return value;
+}
+
+uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= round(0, accumulator);
+    return hash * kPrime1 + kPrime4;
+}
+
+} // namespace
+
+XxHash64::XxHash64(uint64_t seed) : seed(seed) {
+    accumulators[0] = seed + kPrime1 + kPrime2;
+    accumulators[1] = seed + kPrime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - kPrime1;
+}
+
+void XxHash64::update(const void* data, size_t length) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    totalLength += length;
+
+    // Complete a partially filled stripe first
+    if (buffered > 0) {
+        const size_t take = length < 32 - buffered ? length : 32 - buffered;
+        std::memcpy(buffer + buffered, p, take);
+        buffered += take;
+        p += take;
+        length -= take;
+        if (buffered < 32) {
+            return;
+        }
+        for (int i = 0; i < 4; ++i) {
+            accumulators[i] = round(accumulators[i], read64(buffer + 8 * i));
+        }
+        buffered = 0;
+    }
+
+    while (length >= 32) {
+        accumulators[0] = round(accumulators[0], read64(p));
+        accumulators[1] = round(accumulators[1], read64(p + 8));
+        accumulators[2] = round(accumulators[2], read64(p + 16));
+        accumulators[3] = round(accumulators[3], read64(p + 24));
+        p += 32;
+        length -= 32;
+    }
+
+    std::memcpy(buffer, p, length);
+    buffered = length;
+}
+
+uint64_t XxHash64::digest() const {
+    uint64_t hash;
+    if (totalLength >= 32) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) +
+               rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        for (uint64_t accumulator : accumulators) {
+            hash = mergeRound(hash, accumulator);
+        }
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += totalLength;
+
+    const unsigned char* p = buffer;
+    size_t remaining = buffered;
+    while (remaining >= 8) {
+        hash ^= round(0, read64(p));
+        hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        hash ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        hash ^= *p * kPrime5;
+        hash = rotateLeft(hash, 11) * kPrime1;
+        ++p;
+        --remaining;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t XxHash64::hash(const void* data, size_t length, uint64_t seed) {
+    XxHash64 state(seed);
+    state.update(data, length);
+    return state.digest();
+}
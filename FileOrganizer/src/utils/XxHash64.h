@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class XxHash64
+ * @brief A streaming implementation of the 64-bit xxHash function (XXH64).
+ *
+ * XXH64 hashes at several GB/s per core, so hashing file content is limited by
+ * the disk rather than the CPU. Data can be fed in pieces of any size; the digest
+ * matches the reference implementation for the same seed and bytes.
+ *
+ * This is a non-cryptographic hash: it is fine for finding identical files among
+ * one's own, not for defending against deliberately crafted collisions.
+ */
+class XxHash64 {
+public:
+    explicit XxHash64(uint64_t seed = 0);
+
+    /**
+     * @brief Feeds more bytes into the hash.
+     */
+    void update(const void* data, size_t length);
+
+    /**
+     * @brief Gets the hash of all bytes fed so far. Does not modify the state.
+     */
+    uint64_t digest() const;
+
+    /**
+     * @brief Hashes one buffer in a single call.
+     */
+    static uint64_t hash(const void* data, size_t length, uint64_t seed = 0);
+
+private:
+    uint64_t accumulators[4];
+    uint64_t seed;
+    uint64_t totalLength = 0;
+    unsigned char buffer[32];   ///< Bytes waiting for a full 32-byte stripe.
+    size_t buffered = 0;
+};
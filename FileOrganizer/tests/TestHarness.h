@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/**
+ * @file TestHarness.h
+ * @brief A minimal harness for the tests: no framework, one executable per test file.
+ *
+ * TEST(name) defines and registers a test case; CHECK and CHECK_EQ record a failure
+ * and let the case go on, so one run reports every broken expectation. Each test
+ * file ends with `int main() { return runTests(); }`, which runs the cases in
+ * definition order and exits non-zero if any check failed.
+ */
+
+namespace test {
+
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> registered;
+    return registered;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool registerCase(const char* name, void (*run)()) {
+    cases().push_back(Case{name, run});
+    return true;
+}
+
+inline void fail(const char* file, int line, const std::string& message) {
+    ++failures();
+    std::cerr << file << ":" << line << ": check failed: " << message << "\n";
+}
+
+/**
+ * @class ScratchDirectory
+ * @brief A fresh, empty directory under the system's temporary directory, removed
+ *        with everything in it when the object goes away.
+ */
+class ScratchDirectory {
+public:
+    ScratchDirectory() {
+        static unsigned counter = 0;
+        const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        root = std::filesystem::temp_directory_path() /
+               ("fileorganizer-test-" + std::to_string(stamp) + "-" + std::to_string(counter++));
+        std::filesystem::create_directories(root);
+    }
+
+    ~ScratchDirectory() {
+        std::error_code ignored;
+        std::filesystem::remove_all(root, ignored);
+    }
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    const std::filesystem::path& path() const { return root; }
+
+    /**
+     * @brief Writes a file below the directory, creating its parents.
+     */
+    std::filesystem::path write(const std::filesystem::path& relative, const std::string& content) const {
+        const std::filesystem::path file = root / relative;
+        std::filesystem::create_directories(file.parent_path());
+        std::ofstream(file, std::ios::binary) << content;
+        return file;
+    }
+
+private:
+    std::filesystem::path root;
+};
+
+/**
+ * @brief Reads a whole file; empty if it cannot be read.
+ */
+inline std::string readFile(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+} // namespace test
+
+#define TEST(name)                                                                     \
+    static void name();                                                                \
+    static const bool name##Registered = test::registerCase(#name, name);              \
+    static void name()
+
+#define CHECK(condition)                                                               \
+    do {                                                                               \
+        if (!(condition)) test::fail(__FILE__, __LINE__, #condition);                  \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                     \
+    do {                                                                               \
+        const auto& checkActual = (actual);                                            \
+        const auto& checkExpected = (expected);                                        \
+        if (!(checkActual == checkExpected)) {                                         \
+            std::ostringstream checkMessage;                                           \
+            checkMessage << #actual " == " #expected " (got \"" << checkActual         \
+                         << "\", expected \"" << checkExpected << "\")";               \
+            test::fail(__FILE__, __LINE__, checkMessage.str());                        \
+        }                                                                              \
+    } while (0)
+
+/**
+ * @brief Runs every registered case; the exit status of the test executable.
+ */
+inline int runTests() {
+    for (const test::Case& testCase : test::cases()) {
+        const int before = test::failures();
+        try {
+            testCase.run();
+        } catch (const std::exception& e) {
+            test::fail(testCase.name, 0, std::string("unexpected exception: ") + e.what());
+        }
+        std::cout << (test::failures() == before ? "PASS " : "FAIL ") << testCase.name << "\n";
+    }
+    return test::failures() == 0 ? 0 : 1;
+}
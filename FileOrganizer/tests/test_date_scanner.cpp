@@ -0,0 +1,229 @@
+#include "TestHarness.h"
+#include "core/DateScanner.h"
+#include <cctype>
+#include <iomanip>
+#include <random>
+#include <regex>
+
+namespace {
+
+// Written apart from DateScanner::isValidDate, so that one is checked as well
+bool realDate(int year, int month, int day) {
+    if (month < 1 || month > 12 || day < 1) return false;
+    const bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    const int days = month == 2 ? (leap ? 29 : 28) : 30 + (month + month / 8) % 2;
+    return day <= days;
+}
+
+struct OriginalMatch {
+    std::string date;   ///< What the original returned.
+    bool real = false;  ///< Whether the date it matched exists, read from whole numbers.
+};
+
+// The std::regex implementation DateScanner replaced, as it was, also telling
+// whether its match is a real date
+OriginalMatch originalDetectDatePattern(const std::string& filename) {
+    std::regex datePattern1(R"((\d{4})[-_](\d{1,2})[-_](\d{1,2}))");
+    std::regex datePattern2(R"((\d{1,2})[-_](\d{1,2})[-_](\d{4}))");
+    std::regex datePattern3(R"((\d{4})(\d{2})(\d{2}))");
+
+    auto formatDate = [](const std::string& year, const std::string& month, const std::string& day) {
+        std::ostringstream oss;
+        oss << year << "/" << std::setw(2) << std::setfill('0') << month;
+        return OriginalMatch{oss.str(), realDate(std::stoi(year), std::stoi(month), std::stoi(day))};
+    };
+
+    std::smatch match;
+    if (std::regex_search(filename, match, datePattern1)) {
+        return formatDate(match[1].str(), match[2].str(), match[3].str());
+    }
+    if (std::regex_search(filename, match, datePattern2)) {
+        OriginalMatch result = formatDate(match[3].str(), match[2].str(), match[1].str());
+        // A day cut from a longer number ("9" of "29-02-2023") is no day at all
+        const auto start = match.position(0);
+        result.real = result.real && (start == 0 || !std::isdigit(static_cast<unsigned char>(filename[start - 1])));
+        return result;
+    }
+    if (std::regex_search(filename, match, datePattern3)) {
+        return formatDate(match[1].str(), match[2].str(), match[3].str());
+    }
+    return OriginalMatch();
+}
+
+/**
+ * One way a format can match, with the capture groups of its year, month and day.
+ * The alternatives of a format are listed in the order the regex engine tries them:
+ * two digits before one, the first group first.
+ */
+struct Alternative {
+    std::regex pattern;
+    int year;
+    int month;
+    int day;
+};
+
+struct Format {
+    std::vector<Alternative> alternatives;
+    bool startsNumber = false;  ///< The match must not follow a digit.
+};
+
+std::vector<Format> formats() {
+    std::vector<Format> result(3);
+    // A one-digit day must end the number, so an invalid two-digit day is never cut short
+    for (const char* month : {"2", "1"}) {
+        for (const char* day : {R"((\d{2}))", R"((\d)(?!\d))"}) {
+            result[0].alternatives.push_back(
+                {std::regex(std::string(R"((\d{4})[-_](\d{)") + month + R"(})[-_])" + day), 1, 2, 3});
+        }
+    }
+    for (const char* day : {"2", "1"}) {
+        for (const char* month : {"2", "1"}) {
+            result[1].alternatives.push_back({std::regex(std::string(R"((\d{)") + day + R"(})[-_](\d{)" + month +
+                                                         R"(})[-_](\d{4}))"),
+                                              3, 2, 1});
+        }
+    }
+    result[1].startsNumber = true;
+    result[2].alternatives.push_back({std::regex(R"((\d{4})(\d{2})(\d{2}))"), 1, 2, 3});
+    return result;
+}
+
+/**
+ * The original patterns and precedence, with the change DateScanner makes: a match
+ * that is not a real date, read from whole numbers, is rejected, and the search goes
+ * on as if the pattern had not matched there (next alternative, then next position).
+ */
+std::string referenceDate(const std::string& filename) {
+    static const std::vector<Format> kFormats = formats();
+    for (const Format& format : kFormats) {
+        for (size_t start = 0; start < filename.size(); ++start) {
+            if (format.startsNumber && start > 0 && std::isdigit(static_cast<unsigned char>(filename[start - 1]))) {
+                continue;
+            }
+            for (const Alternative& alternative : format.alternatives) {
+                std::smatch match;
+                if (!std::regex_search(filename.begin() + start, filename.end(), match, alternative.pattern,
+                                       std::regex_constants::match_continuous)) {
+                    continue;
+                }
+                const int month = std::stoi(match[alternative.month].str());
+                if (realDate(std::stoi(match[alternative.year].str()), month, std::stoi(match[alternative.day].str()))) {
+                    std::ostringstream oss;
+                    oss << match[alternative.year].str() << "/" << std::setw(2) << std::setfill('0') << month;
+                    return oss.str();
+                }
+            }
+        }
+    }
+    return "";
+}
+
+/**
+ * Filenames made of dates in every format, valid or not (month 0 and 13, day 0, 31
+ * and 32, February 29), bare digit runs, separators and letters.
+ */
+std::vector<std::string> generateCorpus(size_t count) {
+    std::mt19937 random(20240229);
+    auto pick = [&random](int low, int high) { return std::uniform_int_distribution<int>(low, high)(random); };
+    auto number = [&pick](int value, int width) {
+        std::ostringstream oss;
+        oss << std::setw(width) << std::setfill('0') << value;
+        return oss.str();
+    };
+    auto separator = [&pick] { return pick(0, 1) ? std::string("-") : std::string("_"); };
+    auto year = [&pick, &number] {
+        static const int kYears[] = {1900, 1999, 2000, 2023, 2024, 2100};
+        return number(pick(0, 3) ? kYears[pick(0, 5)] : pick(0, 9999), 4);
+    };
+    auto month = [&pick, &number] { return number(pick(0, 13), pick(0, 2) ? 2 : 1); };
+    auto day = [&pick, &number] {
+        static const int kDays[] = {0, 1, 9, 28, 29, 30, 31, 32};
+        return number(pick(0, 1) ? kDays[pick(0, 7)] : pick(1, 31), pick(0, 2) ? 2 : 1);
+    };
+
+    std::vector<std::string> corpus;
+    corpus.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string name;
+        const int pieces = pick(1, 4);
+        for (int piece = 0; piece < pieces; ++piece) {
+            switch (pick(0, 6)) {
+                case 0: name += year() + separator() + month() + separator() + day(); break;
+                case 1: name += day() + separator() + month() + separator() + year(); break;
+                case 2: name += year() + number(pick(0, 13), 2) + number(pick(0, 32), 2); break;
+                case 3: name += std::to_string(pick(0, 99999)); break;
+                case 4: name += separator(); break;
+                case 5: name += "IMG"; break;
+                default: name += " v" + std::to_string(pick(1, 9)) + "."; break;
+            }
+        }
+        corpus.push_back(std::move(name));
+    }
+    return corpus;
+}
+
+} // namespace
+
+TEST(knownNames) {
+    CHECK_EQ(DateScanner::scan("2024-05-17 report"), "2024/05");
+    CHECK_EQ(DateScanner::scan("scan_17_5_2024"), "2024/05");
+    CHECK_EQ(DateScanner::scan("IMG20240517_1200"), "2024/05");
+    CHECK_EQ(DateScanner::scan("v2023-13-01_2023-01-05"), "2023/01");
+    CHECK_EQ(DateScanner::scan("20230229"), "");
+    CHECK_EQ(DateScanner::scan("20240229"), "2024/02");
+    CHECK_EQ(DateScanner::scan("19000229 20000229"), "2000/02");
+    CHECK_EQ(DateScanner::scan("2023-02-29"), "");
+    CHECK_EQ(DateScanner::scan("2023-02-30 report"), "");
+    CHECK_EQ(DateScanner::scan("2023-02-45"), "");
+    CHECK_EQ(DateScanner::scan("2024-02-29"), "2024/02");
+    CHECK_EQ(DateScanner::scan("2024-02-3 notes"), "2024/02");
+    CHECK_EQ(DateScanner::scan("29-02-2023"), "");
+    CHECK_EQ(DateScanner::scan("29-02-2024"), "2024/02");
+    CHECK_EQ(DateScanner::scan("00-01-2024"), "");
+    CHECK_EQ(DateScanner::scan("31-04-2024 then 30-04-2024"), "2024/04");
+    CHECK_EQ(DateScanner::scan("20241301"), "");
+    CHECK_EQ(DateScanner::scan("no date here"), "");
+}
+
+TEST(isValidDate) {
+    for (int year : {1900, 2000, 2023, 2024}) {
+        for (int month = 0; month <= 13; ++month) {
+            for (int day = 0; day <= 32; ++day) {
+                if (DateScanner::isValidDate(year, month, day) != realDate(year, month, day)) {
+                    test::fail(__FILE__, __LINE__, "isValidDate(" + std::to_string(year) + ", " +
+                               std::to_string(month) + ", " + std::to_string(day) + ")");
+                }
+            }
+        }
+    }
+}
+
+// Wherever the original patterns found a real date, the scanner finds the same one
+TEST(agreesWithOriginalOnRealDates) {
+    size_t compared = 0;
+    for (const std::string& name : generateCorpus(5000)) {
+        const OriginalMatch original = originalDetectDatePattern(name);
+        if (!original.real) {
+            continue;
+        }
+        ++compared;
+        CHECK_EQ(DateScanner::scan(name), original.date);
+    }
+    CHECK(compared > 500);
+}
+
+// Every name, including those where the original matched an invalid date
+TEST(agreesWithValidatingReference) {
+    size_t rejected = 0;
+    for (const std::string& name : generateCorpus(5000)) {
+        const std::string expected = referenceDate(name);
+        const OriginalMatch original = originalDetectDatePattern(name);
+        rejected += !original.date.empty() && !original.real;
+        CHECK_EQ(DateScanner::scan(name), expected);
+    }
+    CHECK(rejected > 100);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,114 @@
+#include "TestHarness.h"
+#include "core/DuplicateFinder.h"
+#include "core/Organizer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Content long enough that its middle is hashed by neither edge of the edge stage
+std::string largeContent() {
+    std::string content(3 * DuplicateFinder::kEdgeBytes + 100, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>('a' + i % 26);
+    }
+    return content;
+}
+
+std::string withByteChanged(std::string content, size_t position) {
+    content[position] = content[position] == '#' ? '$' : '#';
+    return content;
+}
+
+std::vector<FileInfo> filesAt(const std::vector<fs::path>& paths) {
+    std::vector<FileInfo> files(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        files[i].path = paths[i];
+    }
+    return files;
+}
+
+} // namespace
+
+// Same size and same edges: only the full content (and the byte comparison) tells them apart
+TEST(differOnlyInTheMiddle) {
+    test::ScratchDirectory scratch;
+    const std::string content = largeContent();
+    const std::vector<FileInfo> files = filesAt({
+        scratch.write("a.bin", content),
+        scratch.write("b.bin", withByteChanged(content, content.size() / 2)),
+        scratch.write("c.bin", content),
+    });
+
+    const DuplicateReport report = DuplicateFinder::find(files, 2);
+    CHECK_EQ(report.groups.size(), 1u);
+    if (report.groups.size() == 1) {
+        CHECK_EQ(report.groups[0].canonical, 0u);
+        CHECK_EQ(report.groups[0].duplicates.size(), 1u);
+        CHECK_EQ(report.groups[0].duplicates.front(), 2u);
+        CHECK_EQ(report.groups[0].size, content.size());
+    }
+}
+
+TEST(noGroupWithoutIdenticalCopy) {
+    test::ScratchDirectory scratch;
+    const std::string content = largeContent();
+    const std::vector<FileInfo> files = filesAt({
+        scratch.write("a.bin", content),
+        scratch.write("b.bin", withByteChanged(content, content.size() / 2)),
+        scratch.write("c.bin", withByteChanged(content, content.size() / 2 + 1)),
+    });
+
+    CHECK(DuplicateFinder::find(files, 2).groups.empty());
+}
+
+// A difference in the last byte of a file longer than one read
+TEST(identicalComparesEveryByte) {
+    test::ScratchDirectory scratch;
+    std::string content(DuplicateFinder::kReadBytes + 7, 'x');
+    const fs::path first = scratch.write("first.bin", content);
+    const fs::path copy = scratch.write("copy.bin", content);
+    const fs::path changed = scratch.write("changed.bin", withByteChanged(content, content.size() - 1));
+
+    CHECK(DuplicateFinder::identical(first, copy, content.size()));
+    CHECK(!DuplicateFinder::identical(first, changed, content.size()));
+    CHECK(!DuplicateFinder::identical(first, scratch.path() / "missing.bin", content.size()));
+}
+
+// A duplicate edited after planning, keeping its size, must survive the execution
+TEST(editedDuplicateIsNotDeleted) {
+    test::ScratchDirectory scratch;
+    const std::string content = largeContent();
+    scratch.write("first.bin", content);
+    scratch.write("second.bin", content);
+
+    OrganizerOptions options;
+    options.dedupe = DedupeMode::DELETE;
+    const Organizer organizer(options);
+
+    size_t errors = 0;
+    ExecutionCallbacks callbacks;
+    callbacks.error = [&errors](const Action*, const std::string&) { ++errors; };
+    const Plan plan = organizer.plan(scratch.path(), callbacks);
+
+    fs::path duplicate;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        if (plan.type(i) == Action::DELETE_DUPLICATE) {
+            duplicate = plan.action(i).source;
+        }
+    }
+    CHECK(!duplicate.empty());
+    if (duplicate.empty()) {
+        return;
+    }
+    const std::string edited = withByteChanged(content, content.size() / 2);
+    std::ofstream(duplicate, std::ios::binary | std::ios::trunc) << edited;
+
+    organizer.execute(plan, callbacks);
+    CHECK_EQ(errors, 1u);
+    CHECK_EQ(test::readFile(duplicate), edited);
+}
+
+int main() {
+    return runTests();
+}
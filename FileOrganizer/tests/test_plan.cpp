@@ -0,0 +1,64 @@
+#include "TestHarness.h"
+#include "core/Plan.h"
+#include <memory>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::unique_ptr<Plan> samplePlan() {
+    auto plan = std::make_unique<Plan>();
+    plan->addAction(Action(Action::CREATE_DIR, "", "/data/Documents"));
+    plan->addAction(Action(Action::MOVE, "/data/report.pdf", "/data/Documents/report.pdf"));
+    plan->addAction(Action(Action::RENAME, "/data/IMG_1.jpg", "/data/2024-05-01_IMG_1.jpg"));
+    plan->addAction(Action(Action::DELETE_DUPLICATE, "/data/copy.pdf", "/data/Documents/report.pdf"));
+    return plan;
+}
+
+void checkSample(const Plan& plan) {
+    CHECK_EQ(plan.size(), 4u);
+    if (plan.size() != 4) {
+        return;
+    }
+    CHECK_EQ(plan.action(0).destination, fs::path("/data/Documents"));
+    CHECK_EQ(plan.action(1).source, fs::path("/data/report.pdf"));
+    CHECK_EQ(plan.action(1).destination, fs::path("/data/Documents/report.pdf"));
+    CHECK_EQ(plan.action(2).destination, fs::path("/data/2024-05-01_IMG_1.jpg"));
+    CHECK(plan.action(3).type == Action::DELETE_DUPLICATE);
+    CHECK_EQ(plan.action(3).source, fs::path("/data/copy.pdf"));
+    CHECK_EQ(plan.count(Action::MOVE), 1u);
+}
+
+} // namespace
+
+TEST(actionsRoundTrip) {
+    checkSample(*samplePlan());
+}
+
+// The copies must not refer to anything the original owns
+TEST(copyOutlivesOriginal) {
+    auto original = samplePlan();
+    const Plan copy(*original);
+    Plan assigned;
+    assigned = *original;
+    original.reset();
+
+    checkSample(copy);
+    checkSample(assigned);
+}
+
+// A copy interns new directories on its own
+TEST(copyGrowsIndependently) {
+    auto original = samplePlan();
+    Plan copy(*original);
+    copy.addAction(Action(Action::MOVE, "/other/a.txt", "/other/Documents/a.txt"));
+    original.reset();
+
+    CHECK_EQ(copy.size(), 5u);
+    CHECK_EQ(copy.action(4).destination, fs::path("/other/Documents/a.txt"));
+    CHECK_EQ(copy.action(1).destination, fs::path("/data/Documents/report.pdf"));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,79 @@
+#include "TestHarness.h"
+#include "core/FileScanner.h"
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Collects what is written to std::cerr while it lives.
+ */
+class CapturedErrors {
+public:
+    CapturedErrors() : previous(std::cerr.rdbuf(captured.rdbuf())) {}
+    ~CapturedErrors() { std::cerr.rdbuf(previous); }
+
+    std::string text() const { return captured.str(); }
+
+private:
+    std::ostringstream captured;
+    std::streambuf* previous;
+};
+
+struct ErrorLog {
+    std::vector<fs::path> directories;
+    std::vector<std::error_code> errors;
+
+    FileScanner::ErrorHandler handler() {
+        return [this](const fs::path& directory, const std::error_code& error) {
+            directories.push_back(directory);
+            errors.push_back(error);
+        };
+    }
+};
+
+} // namespace
+
+// With a handler, a missing root reaches it and nothing is printed
+TEST(missingRootGoesToHandler) {
+    test::ScratchDirectory scratch;
+    const fs::path missing = scratch.path() / "missing";
+    ErrorLog log;
+    size_t found = 0;
+    auto count = [&found](FileInfo&&) { return ++found > 0; };
+    std::string printed;
+    {
+        // The checks print on std::cerr too, so they wait until it is restored
+        CapturedErrors errors;
+        found += FileScanner::scanDirectory(missing, log.handler()).size();
+        found += FileScanner::scanRecursive(missing, 1, log.handler()).size();
+        FileScanner::streamFiles(missing, false, count, log.handler());
+        FileScanner::streamFiles(missing, true, count, log.handler());
+        printed = errors.text();
+    }
+
+    CHECK_EQ(log.directories.size(), 4u);
+    for (size_t i = 0; i < log.directories.size(); ++i) {
+        CHECK_EQ(log.directories[i], missing);
+        CHECK(log.errors[i] == std::errc::not_a_directory);
+    }
+    CHECK_EQ(found, 0u);
+    CHECK_EQ(printed, "");
+}
+
+// Without one, the command line still sees the error
+TEST(missingRootPrintedWithoutHandler) {
+    test::ScratchDirectory scratch;
+    std::string printed;
+    {
+        CapturedErrors errors;
+        FileScanner::scanDirectory(scratch.path() / "missing");
+        printed = errors.text();
+    }
+    CHECK(printed.find("does not exist") != std::string::npos);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,60 @@
+#include "TestHarness.h"
+#include "core/FileTypeClassifier.h"
+#include "core/Organizer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A PNG signature and the start of its IHDR chunk
+const std::string kPngHeader("\x89PNG\r\n\x1a\n\0\0\0\rIHDR", 16);
+
+fs::path destinationOf(const Plan& plan, const fs::path& source) {
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const Action action = plan.action(i);
+        if (action.source == source) {
+            return action.destination;
+        }
+    }
+    return fs::path();
+}
+
+} // namespace
+
+TEST(untrustedExtensions) {
+    CHECK(FileTypeClassifier::isUntrusted(".txt"));
+    CHECK(FileTypeClassifier::isUntrusted(".DAT"));
+    CHECK(FileTypeClassifier::isUntrusted(".crdownload"));
+    CHECK(!FileTypeClassifier::isUntrusted(".png"));
+    CHECK(!FileTypeClassifier::isUntrusted(".pdf"));
+    CHECK(!FileTypeClassifier::isUntrusted(""));
+}
+
+// An image saved as .txt or .dat is filed by its content, real text by its extension
+TEST(contentOverridesUntrustedExtension) {
+    test::ScratchDirectory scratch;
+    const fs::path mislabelled = scratch.write("picture.txt", kPngHeader);
+    const fs::path generic = scratch.write("picture.dat", kPngHeader);
+    const fs::path notes = scratch.write("notes.txt", "Just some notes.\n");
+
+    OrganizerOptions options;
+    options.sniff = true;
+    const Plan plan = Organizer(options).plan(scratch.path());
+
+    CHECK_EQ(destinationOf(plan, mislabelled), scratch.path() / "Images" / "picture.txt");
+    CHECK_EQ(destinationOf(plan, generic), scratch.path() / "Images" / "picture.dat");
+    CHECK_EQ(destinationOf(plan, notes), scratch.path() / "Documents" / "notes.txt");
+}
+
+// Without --sniff the extension decides
+TEST(extensionDecidesWithoutSniffing) {
+    test::ScratchDirectory scratch;
+    const fs::path mislabelled = scratch.write("picture.txt", kPngHeader);
+
+    const Plan plan = Organizer(OrganizerOptions()).plan(scratch.path());
+    CHECK_EQ(destinationOf(plan, mislabelled), scratch.path() / "Documents" / "picture.txt");
+}
+
+int main() {
+    return runTests();
+}
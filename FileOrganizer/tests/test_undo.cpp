@@ -0,0 +1,57 @@
+#include "TestHarness.h"
+#include "core/FileOperator.h"
+#include "core/Journal.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Runs a plan that moves `file` into `directory`, of which `missingLevels` levels
+ * do not exist yet, journaled, then undoes it.
+ */
+void runAndUndo(const test::ScratchDirectory& scratch, const fs::path& file, const fs::path& directory,
+                unsigned missingLevels) {
+    Plan plan;
+    plan.addAction(Action(Action::CREATE_DIR, "", directory));
+    plan.addAction(Action(Action::MOVE, file, directory / file.filename()));
+
+    {
+        Journal journal;
+        journal.create(scratch.path() / "run.journal", plan);
+        CHECK(FileOperator::executePlan(journal.plan(), 1, &journal));
+        CHECK_EQ(test::readFile(directory / file.filename()), "photo");
+    }
+
+    Journal reopened;
+    reopened.open(scratch.path() / "run.journal");
+    CHECK_EQ(reopened.missingLevels(0), missingLevels);
+    CHECK(FileOperator::undoJournal(reopened));
+    CHECK_EQ(test::readFile(file), "photo");
+}
+
+} // namespace
+
+// An empty directory that was there before the run survives its undo
+TEST(undoKeepsPreexistingEmptyParent) {
+    test::ScratchDirectory scratch;
+    const fs::path file = scratch.write("IMG_1.jpg", "photo");
+    fs::create_directory(scratch.path() / "2024");
+
+    runAndUndo(scratch, file, scratch.path() / "2024" / "05", 1);
+    CHECK(!fs::exists(scratch.path() / "2024" / "05"));
+    CHECK(fs::is_directory(scratch.path() / "2024"));
+}
+
+// Every level the run created goes
+TEST(undoRemovesCreatedParents) {
+    test::ScratchDirectory scratch;
+    const fs::path file = scratch.write("IMG_1.jpg", "photo");
+
+    runAndUndo(scratch, file, scratch.path() / "2024" / "05", 2);
+    CHECK(!fs::exists(scratch.path() / "2024"));
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,79 @@
+#include "TestHarness.h"
+#include "core/Organizer.h"
+#include "utils/IoUring.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Organizes `root` with the io_uring engine (threads where the ring is unavailable)
+size_t organizeWithUring(const fs::path& root) {
+    OrganizerOptions options;
+    options.engine = ExecutionEngine::IO_URING;
+    const Organizer organizer(options);
+
+    size_t errors = 0;
+    ExecutionCallbacks callbacks;
+    callbacks.error = [&errors](const Action*, const std::string& message) {
+        ++errors;
+        std::cerr << "error: " << message << "\n";
+    };
+    const Plan plan = organizer.plan(root, callbacks);
+    organizer.execute(plan, callbacks);
+    return errors;
+}
+
+} // namespace
+
+// The chain for 2024/05 starts with a mkdirat of 2024, which already exists and fails
+// with EEXIST; that must neither cancel the rest of the chain nor fail the moves
+TEST(existingParentWithMissingChild) {
+    test::ScratchDirectory scratch;
+    scratch.write("2024/kept.txt", "already there");
+    scratch.write("2024-05-01 first.txt", "1");
+    scratch.write("2024-05-02 second.txt", "2");
+    scratch.write("2024-05-03 third.txt", "3");
+
+    CHECK_EQ(organizeWithUring(scratch.path()), 0u);
+    CHECK(fs::is_directory(scratch.path() / "2024/05"));
+    CHECK_EQ(test::readFile(scratch.path() / "2024/05/2024-05-01 first.txt"), "1");
+    CHECK_EQ(test::readFile(scratch.path() / "2024/05/2024-05-02 second.txt"), "2");
+    CHECK_EQ(test::readFile(scratch.path() / "2024/05/2024-05-03 third.txt"), "3");
+    CHECK_EQ(test::readFile(scratch.path() / "2024/kept.txt"), "already there");
+    CHECK(!fs::exists(scratch.path() / "2024-05-01 first.txt"));
+}
+
+// Both the directory and its parent exist already: every link of the chain fails with EEXIST
+TEST(existingDirectoryAndParent) {
+    test::ScratchDirectory scratch;
+    fs::create_directories(scratch.path() / "2023/11");
+    scratch.write("2023-11-20 a.txt", "a");
+    scratch.write("2023-11-21 b.txt", "b");
+
+    CHECK_EQ(organizeWithUring(scratch.path()), 0u);
+    CHECK_EQ(test::readFile(scratch.path() / "2023/11/2023-11-20 a.txt"), "a");
+    CHECK_EQ(test::readFile(scratch.path() / "2023/11/2023-11-21 b.txt"), "b");
+}
+
+// Two missing directories under one existing parent, the second chained before the
+// first completes
+TEST(siblingsUnderExistingParent) {
+    test::ScratchDirectory scratch;
+    fs::create_directories(scratch.path() / "2022");
+    scratch.write("2022-01-05 a.txt", "a");
+    scratch.write("2022-02-05 b.txt", "b");
+    scratch.write("2022-02-06 c.txt", "c");
+
+    CHECK_EQ(organizeWithUring(scratch.path()), 0u);
+    CHECK_EQ(test::readFile(scratch.path() / "2022/01/2022-01-05 a.txt"), "a");
+    CHECK_EQ(test::readFile(scratch.path() / "2022/02/2022-02-05 b.txt"), "b");
+    CHECK_EQ(test::readFile(scratch.path() / "2022/02/2022-02-06 c.txt"), "c");
+}
+
+int main() {
+    IoUring ring;
+    if (!ring.open(8)) {
+        std::cout << "io_uring unavailable (" << ring.error() << "); the engine falls back to threads\n";
+    }
+    return runTests();
+}
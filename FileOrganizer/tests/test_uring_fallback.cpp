@@ -0,0 +1,86 @@
+#include "TestHarness.h"
+#include "core/FileOperator.h"
+#include "utils/IoUring.h"
+
+#include <cstddef>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool ringAvailable = false;
+
+/**
+ * Makes every io_uring_enter that waits for completions fail with EIO from now on,
+ * for the whole process. Submissions that do not wait still go through, so a run
+ * gets some requests accepted before its ring fails.
+ */
+bool failWaitingSubmits() {
+    constexpr unsigned kWaitForLow = offsetof(struct seccomp_data, args) + 2 * sizeof(uint64_t)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        + sizeof(uint32_t)
+#endif
+        ;
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_enter, 0, 3),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, kWaitForLow),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | (EIO & SECCOMP_RET_DATA)),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog program = {static_cast<unsigned short>(sizeof(filter) / sizeof(filter[0])), filter};
+    return ::prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 &&
+           ::prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+
+} // namespace
+
+// More renames than one submit batch: the first batches are accepted, then the ring
+// fails, and the blocking path must finish every rename the ring did not
+TEST(failedRingFinishesOnBlockingPath) {
+    test::ScratchDirectory scratch;
+    constexpr size_t kFiles = 600;
+    Plan plan;
+    for (size_t i = 0; i < kFiles; ++i) {
+        const fs::path file = scratch.write("file" + std::to_string(i) + ".txt", std::to_string(i));
+        plan.addAction(Action(Action::RENAME, file, scratch.path() / ("renamed" + std::to_string(i) + ".txt")));
+    }
+
+    std::vector<std::string> errors;
+    ExecutionCallbacks callbacks;
+    callbacks.error = [&errors](const Action* action, const std::string& message) {
+        errors.push_back(action ? action->source.string() + ": " + message : message);
+    };
+    const bool ok = FileOperator::executePlan(plan, 1, nullptr, ExecutionEngine::IO_URING, &callbacks);
+
+    CHECK(ok);
+    if (ringAvailable) {
+        // Only the ring's own failure is reported, not one per action
+        CHECK_EQ(errors.size(), 1u);
+        CHECK(!errors.empty() && errors.front().find("blocking") != std::string::npos);
+    }
+    size_t renamed = 0;
+    for (size_t i = 0; i < kFiles; ++i) {
+        const fs::path file = scratch.path() / ("renamed" + std::to_string(i) + ".txt");
+        renamed += test::readFile(file) == std::to_string(i);
+    }
+    CHECK_EQ(renamed, kFiles);
+    CHECK(!fs::exists(scratch.path() / "file0.txt"));
+}
+
+int main() {
+    IoUring ring;
+    ringAvailable = ring.open(8);
+    if (!ringAvailable) {
+        std::cout << "io_uring unavailable (" << ring.error() << "); the engine falls back to threads\n";
+    } else if (!failWaitingSubmits()) {
+        std::cout << "cannot install a seccomp filter; the ring does not fail\n";
+        ringAvailable = false;
+    }
+    return runTests();
+}